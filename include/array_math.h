@@ -0,0 +1,52 @@
+#ifndef ARRAY_MATH_H
+#define ARRAY_MATH_H
+
+#include "lexer.h"
+#include "satan_value.h"
+#include <cstdint>
+#include <vector>
+
+// Element-wise arithmetic on arrays of numbers: + - * / % and < <= > >=
+// apply to each pair of elements of two equally long arrays, or to each
+// element and a number on the other side. Arithmetic yields an array of
+// numbers, comparisons an array of booleans.
+//
+// A chain such as `a * b + c` runs as one FusedPlan: the arrays are walked
+// once, a block at a time, and each operator works on block-sized buffers
+// instead of building a whole intermediate array. On x86-64 the block
+// kernels use AVX2 when the CPU has it (SATAN_ARRAY_KERNEL=scalar turns
+// that off, for benchmarking).
+
+// The most operands one plan takes
+constexpr uint32_t MAX_FUSED_OPERANDS = 16;
+
+// One step of a plan in postfix order: take the next operand, or apply an
+// operator to the two values before it
+struct FusedStep {
+    bool operand;
+    TokenType op;
+};
+
+struct FusedPlan {
+    std::vector<FusedStep> steps;
+    uint32_t operands = 0;
+};
+
+// Arithmetic operators that may appear anywhere in a chain
+bool isElementwiseArithmetic(TokenType op);
+// Those plus the comparisons, which may only end a chain
+bool isElementwise(TokenType op);
+
+// l op r where at least one side is an array and the other an array or
+// number. Throws if the arrays differ in length or hold anything but numbers.
+SatanValue elementwise(TokenType op, const SatanValue& l, const SatanValue& r);
+
+// Runs `plan` over its operands (plan.operands of them, in order). If they
+// are arrays and numbers the chain is fused as described above; otherwise
+// each operator goes through binaryOp in turn, as if it were not fused.
+SatanValue evaluateFused(const FusedPlan& plan, const SatanValue* operands);
+
+// The same when every operand is a number
+SatanValue evaluateNumbers(const FusedPlan& plan, const double* operands);
+
+#endif
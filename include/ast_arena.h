@@ -0,0 +1,65 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator that owns every AST node of one compilation unit: a parsed
+// file, REPL line or streamed top-level statement. Nodes are placed one after
+// another in allocation order and the whole unit goes away at once when the
+// last reference to it is dropped. A function declared in the unit keeps it
+// alive through FunctionObject::body (see FunDecl::execute).
+class AstArena : public std::enable_shared_from_this<AstArena> {
+public:
+    AstArena() = default;
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+    ~AstArena();
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* node = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            cleanups.push_back({[](void* p) { static_cast<T*>(p)->~T(); }, node});
+        }
+        return node;
+    }
+
+    // Copies text that nodes built after parsing (such as folded constants)
+    // need to view, so it lives exactly as long as they do
+    std::string_view copyText(std::string_view text) {
+        char* p = static_cast<char*>(allocate(text.size(), 1));
+        std::memcpy(p, text.data(), text.size());
+        return std::string_view(p, text.size());
+    }
+
+    size_t bytesUsed() const { return used; }
+
+private:
+    static constexpr size_t FIRST_CHUNK = 4 * 1024;
+    static constexpr size_t MAX_CHUNK = 1024 * 1024;
+
+    // Nodes still own vectors and strings, so their destructors run (newest
+    // first) before the chunks are released
+    struct Cleanup {
+        void (*destroy)(void*);
+        void* node;
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> chunks;
+    std::vector<Cleanup> cleanups;
+    std::byte* cursor = nullptr;
+    std::byte* limit = nullptr;
+    size_t nextChunk = FIRST_CHUNK;
+    size_t used = 0;
+
+    void* allocate(size_t size, size_t align);
+};
+
+#endif
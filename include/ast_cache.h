@@ -0,0 +1,68 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include "parser.h"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Parsed scripts are cached in a __satancache__ directory next to each
+// source file, one entry per file. An entry is only used if it was written
+// by the same interpreter version for the same source text (length and a
+// 64-bit hash) and its body still matches the size and hash stored in its
+// header; otherwise the file is parsed again and the entry replaced.
+// Set SATAN_NO_CACHE=1 to neither read nor write entries.
+
+// True when SATAN_NO_CACHE is set; DataFrame pipelines honor it too
+bool cacheDisabled();
+
+// Program for the script at `path`, from the cache when possible.
+// nullopt if the file can't be opened; parse errors throw as usual.
+std::optional<Program> loadProgram(const std::string& path);
+
+// Bump whenever a node gains, loses or reorders a serialized field
+constexpr uint32_t AST_CACHE_FORMAT = 4;
+
+enum class AstTag : uint8_t {
+    NONE,   // a null child
+    LITERAL, VARIABLE, BINARY, CALL, LOGICAL, UNARY, ARRAY, MEMBER_ACCESS,
+    METHOD_CALL, INDEX, ASSIGN, NAMED_ARG, DICT, INDEX_ASSIGN, MEMBER_ASSIGN,
+    VAR_DECL, ASSEMBLE, PRINT, IF, BLOCK, EXPR_STMT, SUMMON, FUN_DECL,
+    RETURN, WHILE, FOR, BREAK, CONTINUE, TRY_CATCH, IMPORT, FOR_IN,
+    ASSERT, TEST,
+};
+
+// Serializes a tree in preorder: each node is its tag followed by its
+// fields. Text (lexemes, paths, messages) goes into a table of distinct
+// strings and is referred to by index, so a loaded entry can point tokens
+// straight into the mapped file. Counts, indexes and token lines (as the
+// change from the previous token) are varints.
+class AstWriter {
+public:
+    void tag(AstTag t) { tree.push_back(static_cast<char>(t)); }
+    void expr(const Expr* e);
+    void stmt(const Stmt* s);
+    void exprs(const std::vector<Expr*>& list);
+    void stmts(const std::vector<Stmt*>& list);
+    void token(const Token& t);
+    void text(std::string_view s);
+    void count(size_t n);
+    void flag(bool b) { tree.push_back(b ? 1 : 0); }
+    void op(TokenType t) { tree.push_back(static_cast<char>(t)); }
+
+    // The complete entry: header, string table, then the tree
+    std::string finish(uint64_t sourceSize, uint64_t sourceHash) const;
+
+private:
+    std::string tree;
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, uint32_t> stringIds;
+    std::vector<uint32_t> identifierIds;   // string id by symbol, to skip hashing names
+    int lastLine = 0;
+
+    uint32_t addString(std::string_view s);
+};
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "satan_value.h"
+#include "runtime.h"
+#include "array_math.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Instruction set of the stack VM. Code is a flat array of 32-bit words:
+// an opcode followed by its operands (listed next to each opcode).
+enum class OpCode : uint32_t {
+    CONSTANT,        // k          push constants[k]
+    NIL, TRUE, FALSE,
+    POP,
+    GET_LOCAL,       // slot
+    SET_LOCAL,       // slot       assign, value stays on the stack
+    DEFINE_LOCAL,    // slot       pop into slot
+    GET_UPVALUE,     // index
+    SET_UPVALUE,     // index
+    GET_GLOBAL,      // global id
+    SET_GLOBAL,      // global id
+    DEFINE_GLOBAL,   // global id  pop into global
+    UPDATE_LOCAL,    // slot, op   compound assignment: slot op= top, result replaces top
+    UPDATE_UPVALUE,  // index, op
+    UPDATE_GLOBAL,   // global id, op
+
+    ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULO,
+    GREATER, GREATER_EQUAL, LESS, LESS_EQUAL, EQUAL, NOT_EQUAL,
+    NEGATE, NOT, TO_BOOL,
+    FUSED,           // site, skip  if the operands of fusedSites[site] are numbers and arrays,
+                     //             push the chain's value and jump to skip; else run the plain code
+
+    JUMP,            // target
+    JUMP_IF_FALSE,   // target     pops the condition
+    JUMP_IF_TRUE,    // target     pops the condition
+    LOOP_GUARD,      // slot, name  count iterations, throw names[name] past the limit
+
+    CALL,            // argc
+    INVOKE,          // symbol, argc, cache  built-in method call
+    GET_MEMBER,      // symbol
+    GET_INDEX,
+    SET_INDEX,       // op         object, index, value -> value stored (see setIndex)
+    SET_MEMBER,      // symbol, op  object, value -> value stored
+    BUILD_ARRAY,     // count
+    BUILD_DICT,      // pair count
+    CLOSURE,         // function index
+    CLOSE_UPVALUES,  // slot       close captured locals at or above slot
+    RETURN,
+
+    PRINT,
+    ITER_PREP,       // slot       pop iterable into slot, cursor into slot + 1
+    ITER_NEXT,       // slot, var slot  store the next element and skip the JUMP that
+                     //                 follows; when exhausted, fall through to it
+    TRY_BEGIN,       // handler target, first slot of the try block
+    TRY_END,
+    ASSERT,          // name       message
+    TEST_BEGIN,      // name
+    TEST_PASS,
+    TEST_FAIL,       // pops the error message
+    IMPORT,          // name       file path
+    FAIL             // name       throw a runtime error
+};
+
+// Where a closure finds a captured variable when it is created:
+// a local slot of the enclosing frame, or one of the enclosing closure's upvalues.
+struct UpvalueDesc {
+    bool isLocal;
+    uint32_t index;
+};
+
+// Inline cache of one INVOKE: the built-in handler it last ran and the
+// receiver type that handler was found for
+struct MethodCache {
+    ValueType type = ValueType::NIL;
+    MethodHandler handler = nullptr;
+};
+
+// Where FUSED reads an operand of its chain without running any code
+struct FusedOperand {
+    enum Kind : uint8_t { VALUE, LOCAL, UPVALUE, GLOBAL } kind;
+    uint32_t index;     // slot, upvalue index or global id
+    SatanValue value;   // a literal operand
+};
+
+// A chain of element-wise operators (see array_math.h) and its operands
+struct FusedSite {
+    FusedPlan plan;
+    std::vector<FusedOperand> operands;
+};
+
+// A compiled function body (or a whole script)
+struct FunctionProto {
+    std::string name;
+    uint32_t arity = 0;
+    uint32_t numSlots = 0;   // parameters, locals and hidden loop state
+    std::vector<uint32_t> code;
+    std::vector<SatanValue> constants;
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<FunctionProto>> functions;
+    std::vector<UpvalueDesc> upvalues;
+    std::vector<FusedSite> fusedSites;
+    mutable std::vector<MethodCache> methodCaches;   // filled in by the VM as it runs
+};
+
+// A captured variable. While open it aliases a VM stack slot; once the
+// slot's scope ends the value moves into `closed`.
+struct Upvalue {
+    size_t slot;
+    bool open = true;
+    SatanValue closed;
+};
+
+// Globals are addressed by id; ids are assigned at compile time and stay
+// stable for the lifetime of the interpreter, so REPL lines share them.
+struct GlobalTable {
+    std::unordered_map<Symbol, uint32_t> ids;
+    std::vector<Symbol> names;
+    std::vector<SatanValue> values;
+    std::vector<char> defined;
+
+    uint32_t intern(Symbol name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(names.size());
+        ids.emplace(name, id);
+        names.push_back(name);
+        values.emplace_back();
+        defined.push_back(0);
+        return id;
+    }
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "bytecode.h"
+#include "parser.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Translates a parsed program into bytecode for the VM. Each AST node emits
+// its own code through Expr::compile / Stmt::compile using the helpers below.
+//
+// Variables are resolved lexically: names declared at the top level of a
+// script are globals, everything else lives in a numbered frame slot, and
+// functions capture the enclosing locals they reference as upvalues.
+class Compiler {
+public:
+    explicit Compiler(GlobalTable& globals);
+
+    std::shared_ptr<FunctionProto> compileScript(const std::vector<Stmt*>& statements);
+
+    // Emission
+    void emit(OpCode op);
+    void emit(OpCode op, uint32_t a);
+    void emit(OpCode op, uint32_t a, uint32_t b);
+    void emit(OpCode op, uint32_t a, uint32_t b, uint32_t c);
+    size_t emitJump(OpCode op);             // returns the operand to patch
+    void patchJump(size_t operand);         // point it at the current position
+    void patchJump(size_t operand, size_t target);
+    size_t position() const;
+    uint32_t addConstant(SatanValue value);
+    uint32_t addName(std::string_view name);
+    uint32_t addMethodCache();
+    uint32_t addFusedSite(const FusedChain& chain);
+
+    // Scopes and variables
+    void beginScope();
+    void endScope();
+    uint32_t declareLocal(Symbol name);
+    uint32_t reserveSlot();                                  // hidden slot, freed with the scope
+    void defineVariable(Symbol name);                       // pops the initial value
+    void loadVariable(Symbol name);
+    FusedOperand variableOperand(Symbol name);              // where loadVariable would read it
+    void storeVariable(Symbol name);                        // keeps the value on the stack
+    void updateVariable(Symbol name, TokenType op);         // name op= value, keeping the result
+    void compileFunction(const FunDecl& decl);
+
+    // Loops and control flow
+    void beginLoop();
+    void setContinueTarget(size_t target);                  // for jumps emitted from now on
+    void endLoop(size_t continueTarget);
+    void emitBreak();
+    void emitContinue();
+    void emitReturn(bool hasValue);
+    size_t beginTry();                                      // returns the handler operand to patch
+    void endTry();
+
+private:
+    struct Local {
+        Symbol name;             // NO_SYMBOL for hidden slots
+        int depth;
+        uint32_t slot;
+        bool captured;
+    };
+
+    struct Loop {
+        uint32_t bodySlot;       // first slot declared inside the loop
+        int tryDepth;
+        bool continueKnown;
+        size_t continueTarget;
+        std::vector<size_t> breakJumps;
+        std::vector<size_t> continueJumps;
+    };
+
+    struct FunctionState {
+        FunctionState* enclosing;
+        std::shared_ptr<FunctionProto> proto;
+        bool isScript;
+        std::vector<Local> locals{};
+        int scopeDepth = 0;
+        uint32_t nextSlot = 0;
+        int tryDepth = 0;
+        std::vector<Loop> loops{};
+    };
+
+    GlobalTable& globals;
+    FunctionState* state = nullptr;
+
+    int resolveLocal(FunctionState* fs, Symbol name);
+    int resolveUpvalue(FunctionState* fs, Symbol name);
+    uint32_t addUpvalue(FunctionState* fs, bool isLocal, uint32_t index);
+    bool isGlobalScope() const;
+    void leaveLoopScopes(const Loop& loop);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef DATAFRAME_H
+#define DATAFRAME_H
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+// One column of a natively loaded CSV. Numeric columns live in a single
+// contiguous double buffer (NaN marks a missing value); anything else is
+// kept as text, where an empty string marks a missing value.
+struct DataColumn {
+    std::string name;
+    bool numeric = true;
+    bool integral = true;   // whole numbers written without '.'/exponent and never missing
+    std::vector<double> values;
+    std::vector<std::string> text;
+};
+
+// Columnar table produced by the native CSV reader. Answers the cheap
+// DataFrame queries (head, shape, columns, describe) without Python.
+class DataFrame {
+public:
+    // mmap the file and parse it on all cores; throws std::runtime_error on I/O errors
+    static std::shared_ptr<DataFrame> readCSV(const std::string& path);
+
+    size_t rowCount() const { return rows; }
+    size_t columnCount() const { return columns.size(); }
+    const std::vector<DataColumn>& getColumns() const { return columns; }
+
+    // Python-style list of column names: ['a', 'b']
+    std::string formatColumnList() const;
+
+    // pandas-style table of the first n rows
+    std::string formatHead(size_t n) const;
+
+    // count/mean/std/min/quartiles/max of the numeric columns
+    std::string formatDescribe() const;
+
+    // Heap memory held by the parsed columns
+    size_t memoryBytes() const;
+
+private:
+    size_t rows = 0;
+    std::vector<DataColumn> columns;
+};
+
+// Parsed CSVs, reused while a file's size and mtime are unchanged. Keeps at
+// most `capacity` bytes of parsed data and drops the least recently used
+// frames first; a frame bigger than that is returned but not kept. Owned by
+// the PythonBridge, so frames live no longer than the interpreter.
+class DataFrameCache {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = size_t(256) << 20;
+
+    explicit DataFrameCache(size_t capacity = DEFAULT_CAPACITY) : capacity(capacity) {}
+
+    // Throws std::runtime_error like DataFrame::readCSV
+    std::shared_ptr<DataFrame> open(const std::string& path);
+
+private:
+    struct Entry {
+        std::string key;   // canonical path
+        uintmax_t size;
+        std::filesystem::file_time_type mtime;
+        std::shared_ptr<DataFrame> frame;
+        size_t bytes;
+    };
+
+    size_t capacity;
+    size_t used = 0;
+    std::list<Entry> entries;   // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> byKey;
+
+    void evict(std::list<Entry>::iterator it);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef ENVIRONMENT_H
 #define ENVIRONMENT_H
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 #include <memory>
@@ -8,61 +9,221 @@
 #include <stdexcept>
 #include "satan_value.h"
 
-class Environment {
+// Slot storage for scopes that live on the C++ stack. Those scopes end in
+// LIFO order, so their slots are carved off the top of a chunked stack and
+// handed back on exit; chunks are kept, so steady-state calls, blocks and
+// loop iterations allocate nothing.
+class FrameStack {
+public:
+    static constexpr size_t CHUNK_SLOTS = 1024;
+
+    SatanValue* push(size_t count) {
+        if (chunks.empty()) chunks.push_back(Chunk(std::max(count, CHUNK_SLOTS)));
+        while (chunks[current].top + count > chunks[current].size) {
+            if (++current == chunks.size()) chunks.push_back(Chunk(std::max(count, CHUNK_SLOTS)));
+        }
+        Chunk& chunk = chunks[current];
+        SatanValue* base = chunk.data.get() + chunk.top;
+        chunk.top += count;
+        return base;
+    }
+
+    void pop(SatanValue* base, size_t count) {
+        for (size_t i = 0; i < count; i++) base[i] = SatanValue();
+        chunks[current].top -= count;
+        while (current > 0 && chunks[current].top == 0) current--;
+    }
+
 private:
-    std::unordered_map<std::string, SatanValue> values;
+    struct Chunk {
+        std::unique_ptr<SatanValue[]> data;
+        size_t size;
+        size_t top = 0;
+        explicit Chunk(size_t n) : data(new SatanValue[n]), size(n) {}
+    };
+
+    std::vector<Chunk> chunks;
+    size_t current = 0;
+};
+
+// A runtime scope. Locals the resolver numbered live in `slots` and are
+// addressed by (depth, slot); globals, builtins and names defined by imported
+// code live in `values` and are looked up by symbol along the parent chain.
+class Environment : public std::enable_shared_from_this<Environment> {
+private:
+    std::unique_ptr<std::unordered_map<Symbol, SatanValue>> values;   // created on first define
+    SatanValue* slots = nullptr;
+    size_t numSlots = 0;
+    std::unique_ptr<SatanValue[]> ownedSlots;   // heap-allocated scopes don't use the frame stack
     Environment* parent;
+    std::shared_ptr<Environment> parentOwner;   // set when the parent is heap-allocated
+    bool suspected = false;                     // queued for the next cycle collection
+
+    static FrameStack& frameStack() {
+        static FrameStack stack;
+        return stack;
+    }
+
+    struct Owned {};
+
+    static void addSuspect(Environment* env);
+
+    // Moves the slots out; they are dropped with `dropped`, since the last
+    // function to go may take this scope with it
+    void moveSlots(std::vector<SatanValue>& dropped) {
+        for (size_t i = 0; i < numSlots; i++) dropped.push_back(std::move(slots[i]));
+    }
 
 public:
     Environment() : parent(nullptr) {}
-    explicit Environment(Environment* parentEnv) : parent(parentEnv) {}
+    // A scope on the C++ stack; its slots come from the frame stack
+    explicit Environment(Environment* parentEnv, size_t slotCount = 0)
+        : numSlots(slotCount), parent(parentEnv) {
+        if (numSlots) slots = frameStack().push(numSlots);
+    }
+    Environment(Owned, Environment* parentEnv, size_t slotCount)
+        : numSlots(slotCount), parent(parentEnv) {
+        if (numSlots) {
+            ownedSlots.reset(new SatanValue[numSlots]);
+            slots = ownedSlots.get();
+        }
+    }
+    ~Environment() {
+        if (slots && !ownedSlots) frameStack().pop(slots, numSlots);
+    }
+    Environment(const Environment&) = delete;
+    Environment& operator=(const Environment&) = delete;
 
-    void define(const std::string& name, SatanValue value) {
-        values[name] = std::move(value);
+    // Scopes a closure can capture are heap-allocated and keep their parent alive
+    static std::shared_ptr<Environment> makeShared(std::shared_ptr<Environment> parentEnv, size_t slotCount) {
+        auto env = std::make_shared<Environment>(Owned{}, parentEnv.get(), slotCount);
+        env->parentOwner = std::move(parentEnv);
+        return env;
     }
 
-    // Legacy overload for doubles
-    void define(const std::string& name, double value) {
-        values[name] = SatanValue(value);
+    // Handle for closures; non-owning when this scope is not heap-allocated
+    std::shared_ptr<Environment> share() {
+        if (auto self = weak_from_this().lock()) return self;
+        return std::shared_ptr<Environment>(std::shared_ptr<Environment>(), this);
     }
 
-    void assign(const std::string& name, SatanValue value) {
-        auto it = values.find(name);
-        if (it != values.end()) { it->second = std::move(value); return; }
+    // Ends a heap-allocated scope. Functions declared in it point back at
+    // it, so if anything still holds it, it may turn into garbage that only
+    // its own functions keep alive.
+    static void release(std::shared_ptr<Environment>& env) {
+        if (env.use_count() > 1) suspect(env.get());
+        env.reset();
+    }
+
+    // Queues a heap scope that may have become unreachable except through its
+    // own functions; suspects are collected in batches (environment.cpp)
+    static void suspect(Environment* env) {
+        if (!env->suspected) addSuspect(env);
+    }
+
+    // Frees the suspected scopes that nothing outside them can reach, along
+    // with any such scopes reachable from them
+    static void collectCycles();
+
+    // What this scope holds that can point back at it: the arrays, objects
+    // and functions in its slots, and a heap-allocated parent
+    template <typename OnValue, typename OnScope>
+    void forEachReference(OnValue&& onValue, OnScope&& onScope) const {
+        for (size_t i = 0; i < numSlots; i++) {
+            const SatanValue& v = slots[i];
+            if (v.isArray() || v.isObject() || v.isFunction()) onValue(v);
+        }
+        if (parentOwner.use_count() > 0) onScope(parentOwner.get());
+    }
+
+    // Drops every binding, breaking the cycles a long-lived scope forms with
+    // the functions declared in it
+    void clear() {
+        auto droppedValues = std::move(values);
+        std::vector<SatanValue> dropped;
+        moveSlots(dropped);
+    }
+
+    SatanValue& slot(uint32_t index) { return slots[index]; }
+
+    const SatanValue& getAt(int depth, uint32_t index) const {
+        const Environment* env = this;
+        while (depth-- > 0) env = env->parent;
+        return env->slots[index];
+    }
+
+    SatanValue& slotAt(int depth, uint32_t index) {
+        Environment* env = this;
+        while (depth-- > 0) env = env->parent;
+        return env->slots[index];
+    }
+
+    void assignAt(int depth, uint32_t index, SatanValue value) {
+        Environment* env = this;
+        while (depth-- > 0) env = env->parent;
+        env->slots[index] = std::move(value);
+    }
+
+    void define(Symbol name, SatanValue value) {
+        if (!values) values = std::make_unique<std::unordered_map<Symbol, SatanValue>>();
+        (*values)[name] = std::move(value);
+    }
+
+    void assign(Symbol name, SatanValue value) {
+        if (values) {
+            auto it = values->find(name);
+            if (it != values->end()) { it->second = std::move(value); return; }
+        }
         if (parent) { parent->assign(name, std::move(value)); return; }
-        throw std::runtime_error("Undefined variable: " + name);
+        throw std::runtime_error("Undefined variable: " + symbolName(name));
     }
 
-    SatanValue get(const std::string& name) const {
-        auto it = values.find(name);
-        if (it != values.end()) return it->second;
+    const SatanValue& get(Symbol name) const {
+        if (values) {
+            auto it = values->find(name);
+            if (it != values->end()) return it->second;
+        }
         if (parent) return parent->get(name);
-        throw std::runtime_error("Undefined variable: " + name);
+        throw std::runtime_error("Undefined variable: " + symbolName(name));
+    }
+
+    bool exists(Symbol name) const {
+        if (values && values->find(name) != values->end()) return true;
+        if (parent) return parent->exists(name);
+        return false;
+    }
+
+    // By-name forms for builtin registration and other code without a symbol at hand
+    void define(std::string_view name, SatanValue value) { define(intern(name), std::move(value)); }
+    void assign(std::string_view name, SatanValue value) { assign(intern(name), std::move(value)); }
+    const SatanValue& get(std::string_view name) const { return get(intern(name)); }
+    bool exists(std::string_view name) const {
+        Symbol symbol;
+        return lookupSymbol(name, symbol) && exists(symbol);
+    }
+
+    // Legacy overload for doubles
+    void define(std::string_view name, double value) {
+        define(name, SatanValue(value));
     }
 
     // Legacy compatibility
-    double getNumber(const std::string& name) const {
+    double getNumber(std::string_view name) const {
         SatanValue val = get(name);
         if (val.isNumber()) return val.number;
         if (val.isBoolean()) return val.boolean ? 1.0 : 0.0;
-        throw std::runtime_error("Undefined variable or not a number: " + name);
+        throw std::runtime_error("Undefined variable or not a number: " + std::string(name));
     }
 
-    void defineFunction(const std::string& name, const FunctionObject& func) {
+    void defineFunction(Symbol name, const FunctionObject& func) {
         define(name, SatanValue::makeFunction(func));
     }
 
-    FunctionObject getFunction(const std::string& name) const {
+    FunctionObject getFunction(std::string_view name) const {
         SatanValue val = get(name);
-        if (val.isFunction() && val.function) return *val.function;
-        if (val.isNativeFn()) throw std::runtime_error("Cannot get native function as FunctionObject: " + name);
-        throw std::runtime_error("Undefined function: " + name);
-    }
-
-    bool exists(const std::string& name) const {
-        if (values.find(name) != values.end()) return true;
-        if (parent) return parent->exists(name);
-        return false;
+        if (val.isFunction() && val.function()) return *val.function();
+        if (val.isNativeFn()) throw std::runtime_error("Cannot get native function as FunctionObject: " + std::string(name));
+        throw std::runtime_error("Undefined function: " + std::string(name));
     }
 };
 
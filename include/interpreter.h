@@ -4,26 +4,35 @@
 #include "parser.h"
 #include "environment.h"
 #include "python_bridge.h"
+#include "vm.h"
+#include "module_registry.h"
+#include "optimizer.h"
 #include <memory>
 #include <vector>
 #include <stdexcept>
 
-class ReturnException : public std::runtime_error {
-public:
-    SatanValue value;
-    explicit ReturnException(SatanValue val)
-        : std::runtime_error("Function returned"), value(std::move(val)) {}
-};
-
 class Interpreter {
 public:
     Interpreter();
+    ~Interpreter();
 
-    void interpret(const std::vector<std::unique_ptr<Stmt>>& statements);
+    // Returns false if execution stopped on an error. The program is
+    // optimized in place first unless the level is 0.
+    bool interpret(Program& program);
     void registerBuiltins();
 
+    // Run on the original AST walker instead of the bytecode VM (for differential testing)
+    void setTreeWalk(bool enabled) { treeWalk = enabled; }
+
+    // 0 runs the tree exactly as parsed; applies to imported modules too
+    void setOptimizationLevel(int level) {
+        optimizationLevel = level;
+        modules.setOptimizationLevel(level);
+    }
+
     Environment& getEnv() { return env; }
     PythonBridge& getBridge() { return bridge; }
+    ModuleRegistry& getModules() { return modules; }
 
     // Static access for ML evaluations
     static Interpreter* current;
@@ -31,9 +40,13 @@ public:
 private:
     Environment env;
     PythonBridge bridge;
+    ModuleRegistry modules;
+    VM vm;
+    bool treeWalk = false;
+    int optimizationLevel = DEFAULT_OPTIMIZATION_LEVEL;
 
-    void execute(const Stmt* stmt);
-    void executeBlock(const std::vector<std::unique_ptr<Stmt>>& statements, Environment& newEnv);
+    bool execute(const Stmt* stmt);   // false once control escapes the top level
+    ExecStatus executeBlock(const std::vector<Stmt*>& statements, Environment& newEnv);
     SatanValue evaluate(const Expr* expr);
 };
 
@@ -1,10 +1,12 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <deque>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
+#include "symbol.h"
 
 enum class TokenType {
     // Single-character tokens
@@ -21,6 +23,8 @@ enum class TokenType {
     LESS_EQUAL, GREATER_EQUAL,
     ARROW,      // =>
     PIPE_ARROW, // |>
+    PLUS_EQUAL, MINUS_EQUAL,
+    STAR_EQUAL, SLASH_EQUAL, PERCENT_EQUAL,
 
     // Literals
     IDENTIFIER, STRING, NUMBER,
@@ -45,29 +49,66 @@ enum class TokenType {
     ERROR
 };
 
+// Tokens view into a retained source buffer (see retainSource), so copying
+// one never copies text. NUMBER tokens also carry their decoded value and
+// IDENTIFIER tokens their interned name.
 struct Token {
     TokenType type;
-    std::string lexeme;
+    std::string_view lexeme;
     int line;
+    union {
+        double number;
+        Symbol symbol;
+    };
 
-    Token(TokenType t, std::string lex, int ln);
+    Token(TokenType t, std::string_view lex, int ln, double num = 0)
+        : type(t), lexeme(lex), line(ln), number(num) {}
 };
 
+// Keeps a source text alive for the rest of the program and returns a view of
+// it. Tokens and the AST built from them point into these buffers.
+std::string_view retainSource(std::string source);
+
+// Memory-maps a source file and keeps the mapping for the rest of the program,
+// like retainSource but without copying. Throws if the file can't be opened.
+std::string_view loadSource(const std::string& path);
+
 class Lexer {
 public:
-    static constexpr size_t MAX_SOURCE_SIZE = 10 * 1024 * 1024;
-
     explicit Lexer(std::string src);
+    // Lexes a file straight out of its mapping (see loadSource)
+    static Lexer fromFile(const std::string& path);
+    // Lexes text already kept alive by retainSource or loadSource
+    static Lexer fromRetained(std::string_view source);
+
     std::vector<Token> scanTokens();
 
+    // Incremental scanning: appends at least `count` tokens to `sink`, or all
+    // that remain followed by EOF_TOKEN. Lets the parser hold only a window
+    // of tokens instead of the whole file.
+    void scanInto(std::deque<Token>& sink, size_t count);
+    bool done() const { return finished; }
+    size_t sourceSize() const { return source.size(); }
+
 private:
-    std::string source;
-    std::vector<Token> tokens;
+    struct Retained {};
+    Lexer(Retained, std::string_view retained);
+
+    std::string_view source;
+    std::deque<Token>* out = nullptr;   // where scanInto is appending
     size_t start;
     size_t current;
     int line;
+    bool finished = false;
 
-    std::unordered_map<std::string, TokenType> keywords;
+    // Names seen recently, so the usual handful of locals skip the global
+    // symbol table; a collision just overwrites the slot
+    struct CachedName {
+        std::string_view name;
+        Symbol symbol = NO_SYMBOL;
+    };
+    static constexpr size_t NAME_CACHE_SIZE = 256;
+    CachedName nameCache[NAME_CACHE_SIZE];
 
     bool isAtEnd() const;
     void scanToken();
@@ -80,6 +121,8 @@ private:
     void number();
     void identifier();
     void multiLineComment();
+    void whitespace();
+    Symbol internName(std::string_view name);
 };
 
 #endif
@@ -0,0 +1,60 @@
+#ifndef LEXER_SCAN_H
+#define LEXER_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ASCII character classes, independent of the C locale
+enum CharClass : uint8_t {
+    CHAR_DIGIT = 1,
+    CHAR_ALPHA = 2,    // letters and '_'
+    CHAR_SPACE = 4,    // ' ', \t, \r, \n
+};
+
+struct CharClassTable {
+    uint8_t bits[256] = {};
+    constexpr CharClassTable() {
+        for (int c = '0'; c <= '9'; c++) bits[c] = CHAR_DIGIT;
+        for (int c = 'a'; c <= 'z'; c++) bits[c] = CHAR_ALPHA;
+        for (int c = 'A'; c <= 'Z'; c++) bits[c] = CHAR_ALPHA;
+        bits['_'] = CHAR_ALPHA;
+        bits[' '] = bits['\t'] = bits['\r'] = bits['\n'] = CHAR_SPACE;
+    }
+};
+
+inline constexpr CharClassTable CHAR_CLASSES{};
+
+inline bool charIs(char c, uint8_t classes) {
+    return CHAR_CLASSES.bits[static_cast<unsigned char>(c)] & classes;
+}
+
+// Bulk byte scans for the lexer. None of them read at or past `end`.
+// Plain loops: at the lengths the lexer sees (a name, a run of indentation,
+// one line) hand-written SSE2/AVX2 versions measured no faster.
+
+// First c, or end
+inline const char* scanFindByte(const char* p, const char* end, char c) {
+    const void* hit = std::memchr(p, c, static_cast<size_t>(end - p));
+    return hit ? static_cast<const char*>(hit) : end;
+}
+
+// First byte not [A-Za-z0-9_]
+inline const char* scanIdentifierEnd(const char* p, const char* end) {
+    while (p < end && charIs(*p, CHAR_ALPHA | CHAR_DIGIT)) p++;
+    return p;
+}
+
+// First byte not ' ', \t, \r, \n
+inline const char* scanWhitespaceEnd(const char* p, const char* end) {
+    while (p < end && charIs(*p, CHAR_SPACE)) p++;
+    return p;
+}
+
+inline size_t scanCountByte(const char* p, const char* end, char c) {
+    size_t n = 0;
+    for (; p < end; p++) n += (*p == c);
+    return n;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only view of a whole file: mmap on POSIX, a heap copy elsewhere.
+// `kind` names the file in error messages ("CSV file", "source file", ...).
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path, const std::string& kind = "file");
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return mapped; }
+    size_t size() const { return length; }
+    std::string_view view() const { return std::string_view(mapped ? mapped : "", length); }
+
+private:
+    const char* mapped = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::string copy;
+#endif
+};
+
+#endif
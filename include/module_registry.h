@@ -0,0 +1,53 @@
+#ifndef MODULE_REGISTRY_H
+#define MODULE_REGISTRY_H
+
+#include "parser.h"
+#include "optimizer.h"
+#include "symbol.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Modules an interpreter has imported, by canonical path. A module's body
+// runs once; importing it again only binds what it defined.
+class ModuleRegistry {
+public:
+    struct Module {
+        std::string path;     // canonical
+        Program program;      // kept so its functions and bytecode stay valid
+        // Tree-walker only: the scope the body ran in, a child of the globals
+        // that its functions capture, and the top-level definitions as they
+        // stood when the body finished. VM modules define globals, so they
+        // need neither.
+        std::shared_ptr<Environment> scope;
+        std::vector<std::pair<Symbol, SatanValue>> exports;
+    };
+
+    ModuleRegistry() = default;
+    ModuleRegistry(const ModuleRegistry&) = delete;
+    ModuleRegistry& operator=(const ModuleRegistry&) = delete;
+    ~ModuleRegistry();
+
+    // The module already imported as `path`, or nullptr. Paths are
+    // remembered as written, so a repeated import is a single lookup.
+    Module* find(const std::string& path);
+
+    // Loads and registers `path` before its body runs, so a module that is
+    // imported again while it is still running is not started twice.
+    // Throws if the file can't be opened.
+    Module& load(const std::string& path);
+
+    // Modules loaded from now on are optimized at this level (see Optimizer)
+    void setOptimizationLevel(int level) { optimizationLevel = level; }
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<Module>> modules;   // by canonical path
+    std::unordered_map<std::string, Module*> byImportPath;
+    int optimizationLevel = DEFAULT_OPTIMIZATION_LEVEL;
+
+    static std::string canonicalPath(const std::string& path);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "parser.h"
+#include "ast_arena.h"
+#include <vector>
+
+// -O1: what `satan` does unless told -O0
+constexpr int DEFAULT_OPTIMIZATION_LEVEL = 1;
+
+// Rewrites a parsed unit before it is resolved or compiled, so both engines
+// run the simpler tree. Each node optimizes itself through Expr::optimize /
+// Stmt::optimize:
+//   - operators whose operands are literals become the literal they compute,
+//     unless that would throw (division by zero is still reported at runtime)
+//   - `if`/`while` on a literal condition keep only the branch that can run
+//   - statements after a return, break or continue in the same block go
+//     away, as do expression statements that are just a literal
+// New nodes are allocated in the unit's own arena.
+class Optimizer {
+public:
+    explicit Optimizer(AstArena& arena) : arena(arena) {}
+
+    void optimize(std::vector<Stmt*>& statements) { stmts(statements); }
+
+    Expr* expr(Expr* e) { return e ? e->optimize(*this) : nullptr; }
+    Stmt* stmt(Stmt* s) { return s ? s->optimize(*this) : nullptr; }
+    // Like stmt, but a dropped body becomes an empty block rather than null
+    Stmt* branch(Stmt* s);
+    void exprs(std::vector<Expr*>& list);
+    void stmts(std::vector<Stmt*>& list);
+
+    // A literal holding `value`, or nullptr if it has no literal form
+    LiteralExpr* literal(const SatanValue& value, int line);
+
+private:
+    AstArena& arena;
+};
+
+#endif
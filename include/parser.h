@@ -5,20 +5,39 @@
 #include "lexer.h"
 #include "environment.h"
 #include "satan_value.h"
+#include "ast_arena.h"
+#include "runtime.h"
+#include "array_math.h"
 #include <memory>
 #include <vector>
 #include <optional>
 
 constexpr int MAX_PARSE_DEPTH = 256;
+constexpr int MAX_LOOP_ITERATIONS = 1000000;
 
-class BreakSignal : public std::exception {
-public:
-    const char* what() const noexcept override { return "break"; }
+class Compiler;
+class Resolver;
+class AstWriter;
+class Optimizer;
+
+// How control leaves a statement. Anything but NORMAL propagates up to the
+// enclosing loop (BREAK/CONTINUE) or function call (RETURN, carrying the value).
+struct ExecStatus {
+    enum Kind { NORMAL, RETURN, BREAK, CONTINUE };
+    Kind kind;
+    SatanValue value;
+
+    ExecStatus() : kind(NORMAL) {}
+    explicit ExecStatus(Kind k) : kind(k) {}
+    ExecStatus(Kind k, SatanValue v) : kind(k), value(v) {}
+    bool isNormal() const { return kind == NORMAL; }
 };
 
-class ContinueSignal : public std::exception {
-public:
-    const char* what() const noexcept override { return "continue"; }
+// Filled in by the resolver for nodes that open a runtime scope: how many
+// local slots it needs, and whether a function declared inside can keep it alive.
+struct ScopeInfo {
+    uint32_t numSlots = 0;
+    bool captured = false;
 };
 
 // =================== Expressions ===================
@@ -27,256 +46,445 @@ public:
     virtual ~Expr() = default;
     virtual void print() const = 0;
     virtual SatanValue evaluate(Environment& env) const = 0;
+    virtual void compile(Compiler& compiler) const = 0;
+    virtual void resolve(Resolver& resolver) = 0;
+    virtual void write(AstWriter& out) const = 0;   // see ast_cache.h
+    virtual Expr* optimize(Optimizer& opt) = 0;    // this node or its replacement
 };
 
 class LiteralExpr : public Expr {
 public:
     Token value;
-    explicit LiteralExpr(Token val) : value(std::move(val)) {}
+    SatanValue constant;   // decoded once when parsed
+    explicit LiteralExpr(Token val);
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 class VariableExpr : public Expr {
 public:
     Token name;
+    int depth = -1;        // set by the resolver; -1 looks the name up
+    uint32_t slot = 0;
     explicit VariableExpr(Token n) : name(std::move(n)) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
+};
+
+// A chain of element-wise operators run as one FusedPlan (see array_math.h)
+struct FusedChain {
+    FusedPlan plan;
+    std::vector<const Expr*> operands;
 };
 
 class BinaryExpr : public Expr {
 public:
-    std::unique_ptr<Expr> left;
+    // How the tree-walker computes this node. It starts out as quicken(),
+    // which picks a specialization from the operand types it sees.
+    using Evaluator = SatanValue (*)(const BinaryExpr&, Environment&);
+
+    Expr* left;
     Token op;
-    std::unique_ptr<Expr> right;
-    BinaryExpr(std::unique_ptr<Expr> l, Token o, std::unique_ptr<Expr> r)
-        : left(std::move(l)), op(std::move(o)), right(std::move(r)) {}
+    Expr* right;
+    mutable Evaluator evaluator;
+    mutable std::unique_ptr<FusedChain> fused;   // the tree-walker's, once arrays turn up
+    BinaryExpr(Expr* l, Token o, Expr* r)
+        : left(l), op(std::move(o)), right(r), evaluator(&BinaryExpr::quicken) {}
+
+    // Fills `chain` if this node heads at least two element-wise operators
+    // whose operands are all literals or variables. Reading those has no
+    // effects, so the operands may be evaluated before any operator runs.
+    bool fuse(FusedChain& chain) const;
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
+
+private:
+    static SatanValue quicken(const BinaryExpr& e, Environment& env);
 };
 
 class CallExpr : public Expr {
 public:
-    std::unique_ptr<Expr> callee;
-    std::vector<std::unique_ptr<Expr>> arguments;
-    CallExpr(std::unique_ptr<Expr> c, std::vector<std::unique_ptr<Expr>> args)
-        : callee(std::move(c)), arguments(std::move(args)) {}
+    Expr* callee;
+    std::vector<Expr*> arguments;
+    CallExpr(Expr* c, std::vector<Expr*> args)
+        : callee(c), arguments(std::move(args)) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 class LogicalExpr : public Expr {
 public:
-    std::unique_ptr<Expr> left;
+    Expr* left;
     Token op;
-    std::unique_ptr<Expr> right;
-    LogicalExpr(std::unique_ptr<Expr> l, Token o, std::unique_ptr<Expr> r)
-        : left(std::move(l)), op(std::move(o)), right(std::move(r)) {}
+    Expr* right;
+    LogicalExpr(Expr* l, Token o, Expr* r)
+        : left(l), op(std::move(o)), right(r) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 class UnaryExpr : public Expr {
 public:
     Token op;
-    std::unique_ptr<Expr> right;
-    UnaryExpr(Token o, std::unique_ptr<Expr> r)
-        : op(std::move(o)), right(std::move(r)) {}
+    Expr* right;
+    UnaryExpr(Token o, Expr* r)
+        : op(std::move(o)), right(r) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 // NEW: Array literal [1, 2, 3]
 class ArrayExpr : public Expr {
 public:
-    std::vector<std::unique_ptr<Expr>> elements;
-    explicit ArrayExpr(std::vector<std::unique_ptr<Expr>> elems)
+    std::vector<Expr*> elements;
+    explicit ArrayExpr(std::vector<Expr*> elems)
         : elements(std::move(elems)) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 // NEW: Member access: obj.property
 class MemberAccessExpr : public Expr {
 public:
-    std::unique_ptr<Expr> object;
+    Expr* object;
     Token member;
-    MemberAccessExpr(std::unique_ptr<Expr> obj, Token m)
-        : object(std::move(obj)), member(std::move(m)) {}
+    MemberAccessExpr(Expr* obj, Token m)
+        : object(obj), member(std::move(m)) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 // NEW: Method call: obj.method(args)
 class MethodCallExpr : public Expr {
 public:
-    std::unique_ptr<Expr> object;
+    Expr* object;
     Token method;
-    std::vector<std::unique_ptr<Expr>> arguments;
-    MethodCallExpr(std::unique_ptr<Expr> obj, Token m, std::vector<std::unique_ptr<Expr>> args)
-        : object(std::move(obj)), method(std::move(m)), arguments(std::move(args)) {}
+    std::vector<Expr*> arguments;
+    // Inline cache: the built-in handler this call site last ran and the
+    // receiver type it was found for (see findMethod)
+    mutable ValueType cachedType = ValueType::NIL;
+    mutable MethodHandler cachedHandler = nullptr;
+    // Argument vector reused from call to call so a hot site doesn't
+    // allocate; a call that re-enters the site while it is in use (through
+    // an argument or a callback) gets a vector of its own
+    mutable std::vector<SatanValue> argBuffer;
+    mutable bool argBufferBusy = false;
+    MethodCallExpr(Expr* obj, Token m, std::vector<Expr*> args)
+        : object(obj), method(std::move(m)), arguments(std::move(args)) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 // NEW: Index access: arr[0]
 class IndexExpr : public Expr {
 public:
-    std::unique_ptr<Expr> object;
-    std::unique_ptr<Expr> index;
-    IndexExpr(std::unique_ptr<Expr> obj, std::unique_ptr<Expr> idx)
-        : object(std::move(obj)), index(std::move(idx)) {}
+    Expr* object;
+    Expr* index;
+    IndexExpr(Expr* obj, Expr* idx)
+        : object(obj), index(idx) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 // NEW: Assignment: x = value
+// Assignments store into their target with `op`: EQUAL for `=`, otherwise
+// the operator of a compound assignment (PLUS for `+=`). The right side is
+// evaluated before the target's current value is read.
 class AssignExpr : public Expr {
 public:
     Token name;
-    std::unique_ptr<Expr> value;
-    AssignExpr(Token n, std::unique_ptr<Expr> v)
-        : name(std::move(n)), value(std::move(v)) {}
+    Expr* value;
+    TokenType op;
+    int depth = -1;
+    uint32_t slot = 0;
+    AssignExpr(Token n, Expr* v, TokenType o = TokenType::EQUAL)
+        : name(std::move(n)), value(v), op(o) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
+};
+
+// arr[i] = v and dict["key"] = v, changing the array or dictionary in place
+class IndexAssignExpr : public Expr {
+public:
+    Expr* object;
+    Expr* index;
+    Expr* value;
+    TokenType op;
+    IndexAssignExpr(Expr* obj, Expr* idx, Expr* v, TokenType o)
+        : object(obj), index(idx), value(v), op(o) {}
+    void print() const override;
+    SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
+};
+
+// obj.field = v
+class MemberAssignExpr : public Expr {
+public:
+    Expr* object;
+    Token member;
+    Expr* value;
+    TokenType op;
+    MemberAssignExpr(Expr* obj, Token m, Expr* v, TokenType o)
+        : object(obj), member(std::move(m)), value(v), op(o) {}
+    void print() const override;
+    SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 // NEW: Named argument: key=value (for function calls)
 class NamedArgExpr : public Expr {
 public:
     Token name;
-    std::unique_ptr<Expr> value;
-    NamedArgExpr(Token n, std::unique_ptr<Expr> v)
-        : name(std::move(n)), value(std::move(v)) {}
+    Expr* value;
+    NamedArgExpr(Token n, Expr* v)
+        : name(std::move(n)), value(v) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
 };
 
 // =================== Statements ===================
 class Stmt {
 public:
     virtual ~Stmt() = default;
-    virtual void execute(Environment& env) const = 0;
+    virtual ExecStatus execute(Environment& env) const = 0;
+    virtual void compile(Compiler& compiler) const = 0;
+    virtual void resolve(Resolver& resolver) = 0;
+    virtual void write(AstWriter& out) const = 0;   // see ast_cache.h
+    virtual Stmt* optimize(Optimizer& opt) = 0;    // nullptr if it can be dropped
 };
 
 class VarDecl : public Stmt {
 public:
     Token name;
-    std::unique_ptr<Expr> initializer;
-    VarDecl(Token n, std::unique_ptr<Expr> init)
-        : name(std::move(n)), initializer(std::move(init)) {}
-    void execute(Environment& env) const override;
+    Expr* initializer;
+    int slot = -1;         // -1: defined by name (globals, imported code)
+    VarDecl(Token n, Expr* init)
+        : name(std::move(n)), initializer(init) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class AssembleStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> expr;
-    explicit AssembleStmt(std::unique_ptr<Expr> e) : expr(std::move(e)) {}
-    void execute(Environment& env) const override;
+    Expr* expr;
+    explicit AssembleStmt(Expr* e) : expr(e) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class PrintStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> expr;
-    explicit PrintStmt(std::unique_ptr<Expr> e) : expr(std::move(e)) {}
-    void execute(Environment& env) const override;
+    Expr* expr;
+    explicit PrintStmt(Expr* e) : expr(e) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class IfStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> condition;
-    std::unique_ptr<Stmt> thenBranch;
-    std::unique_ptr<Stmt> elseBranch;
-    IfStmt(std::unique_ptr<Expr> cond, std::unique_ptr<Stmt> thenB, std::unique_ptr<Stmt> elseB)
-        : condition(std::move(cond)), thenBranch(std::move(thenB)), elseBranch(std::move(elseB)) {}
-    void execute(Environment& env) const override;
+    Expr* condition;
+    Stmt* thenBranch;
+    Stmt* elseBranch;
+    IfStmt(Expr* cond, Stmt* thenB, Stmt* elseB)
+        : condition(cond), thenBranch(thenB), elseBranch(elseB) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class BlockStmt : public Stmt {
 public:
-    std::vector<std::unique_ptr<Stmt>> statements;
-    explicit BlockStmt(std::vector<std::unique_ptr<Stmt>> stmts)
+    std::vector<Stmt*> statements;
+    ScopeInfo scope;       // for a function body: the whole call frame
+    explicit BlockStmt(std::vector<Stmt*> stmts)
         : statements(std::move(stmts)) {}
-    void execute(Environment& env) const override;
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class ExprStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> expr;
-    explicit ExprStmt(std::unique_ptr<Expr> e) : expr(std::move(e)) {}
-    void execute(Environment& env) const override;
+    Expr* expr;
+    explicit ExprStmt(Expr* e) : expr(e) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class SummonStmt : public Stmt {
 public:
-    explicit SummonStmt(std::unique_ptr<Expr> msg) : message(std::move(msg)) {}
-    void execute(Environment& env) const override;
+    explicit SummonStmt(Expr* msg) : message(msg) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 private:
-    std::unique_ptr<Expr> message;
+    Expr* message;
 };
 
 class FunDecl : public Stmt {
 public:
     Token name;
     std::vector<Token> params;
-    std::shared_ptr<BlockStmt> body;
-    FunDecl(Token n, std::vector<Token> p, std::shared_ptr<BlockStmt> b)
-        : name(std::move(n)), params(std::move(p)), body(std::move(b)) {}
-    void execute(Environment& env) const override;
+    BlockStmt* body;
+    AstArena* unit;        // the arena holding `body`, kept alive by each FunctionObject
+    int slot = -1;
+    FunDecl(Token n, std::vector<Token> p, BlockStmt* b, AstArena* u)
+        : name(std::move(n)), params(std::move(p)), body(b), unit(u) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class ReturnStmt : public Stmt {
 public:
     Token keyword;
-    std::unique_ptr<Expr> value;
-    ReturnStmt(Token k, std::unique_ptr<Expr> v)
-        : keyword(std::move(k)), value(std::move(v)) {}
-    void execute(Environment& env) const override;
+    Expr* value;
+    ReturnStmt(Token k, Expr* v)
+        : keyword(std::move(k)), value(v) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class WhileStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> condition;
-    std::unique_ptr<Stmt> body;
-    WhileStmt(std::unique_ptr<Expr> cond, std::unique_ptr<Stmt> b)
-        : condition(std::move(cond)), body(std::move(b)) {}
-    void execute(Environment& env) const override;
+    Expr* condition;
+    Stmt* body;
+    WhileStmt(Expr* cond, Stmt* b)
+        : condition(cond), body(b) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class ForStmt : public Stmt {
 public:
-    std::unique_ptr<Stmt> initializer;
-    std::unique_ptr<Expr> condition;
-    std::unique_ptr<Expr> increment;
-    std::unique_ptr<Stmt> body;
-    ForStmt(std::unique_ptr<Stmt> init, std::unique_ptr<Expr> cond,
-            std::unique_ptr<Expr> inc, std::unique_ptr<Stmt> b)
-        : initializer(std::move(init)), condition(std::move(cond)),
-          increment(std::move(inc)), body(std::move(b)) {}
-    void execute(Environment& env) const override;
+    Stmt* initializer;
+    Expr* condition;
+    Expr* increment;
+    Stmt* body;
+    ForStmt(Stmt* init, Expr* cond,
+            Expr* inc, Stmt* b)
+        : initializer(init), condition(cond),
+          increment(inc), body(b) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class BreakStmt : public Stmt {
 public:
-    void execute(Environment& env) const override;
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 class ContinueStmt : public Stmt {
 public:
-    void execute(Environment& env) const override;
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 // Phase 1: try/catch
 class TryCatchStmt : public Stmt {
 public:
-    std::unique_ptr<Stmt> tryBlock;
-    std::unique_ptr<Stmt> catchBlock;
+    Stmt* tryBlock;
+    Stmt* catchBlock;
     Token catchVar; // optional error variable name
     bool hasCatchVar;
-    TryCatchStmt(std::unique_ptr<Stmt> t, std::unique_ptr<Stmt> c, Token cv, bool hcv)
-        : tryBlock(std::move(t)), catchBlock(std::move(c)), catchVar(std::move(cv)), hasCatchVar(hcv) {}
-    void execute(Environment& env) const override;
+    ScopeInfo catchScope;  // the error variable is slot 0
+    TryCatchStmt(Stmt* t, Stmt* c, Token cv, bool hcv)
+        : tryBlock(t), catchBlock(c), catchVar(std::move(cv)), hasCatchVar(hcv) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 // Phase 1: import
@@ -284,60 +492,105 @@ class ImportStmt : public Stmt {
 public:
     std::string filepath;
     explicit ImportStmt(std::string path) : filepath(std::move(path)) {}
-    void execute(Environment& env) const override;
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 // Phase 1: for..in
 class ForInStmt : public Stmt {
 public:
     Token varName;
-    std::unique_ptr<Expr> iterable;
-    std::unique_ptr<Stmt> body;
-    ForInStmt(Token v, std::unique_ptr<Expr> iter, std::unique_ptr<Stmt> b)
-        : varName(std::move(v)), iterable(std::move(iter)), body(std::move(b)) {}
-    void execute(Environment& env) const override;
+    Expr* iterable;
+    Stmt* body;
+    ScopeInfo scope;       // the loop variable is slot 0
+    ForInStmt(Token v, Expr* iter, Stmt* b)
+        : varName(v), iterable(iter), body(b) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 // Phase 1: assert
 class AssertStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> condition;
+    Expr* condition;
     std::string message;
-    AssertStmt(std::unique_ptr<Expr> cond, std::string msg)
-        : condition(std::move(cond)), message(std::move(msg)) {}
-    void execute(Environment& env) const override;
+    AssertStmt(Expr* cond, std::string msg)
+        : condition(cond), message(msg) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 // Phase 1: test blocks
 class TestStmt : public Stmt {
 public:
     std::string name;
-    std::unique_ptr<Stmt> body;
-    TestStmt(std::string n, std::unique_ptr<Stmt> b)
-        : name(std::move(n)), body(std::move(b)) {}
-    void execute(Environment& env) const override;
+    Stmt* body;
+    TestStmt(std::string n, Stmt* b)
+        : name(std::move(n)), body(b) {}
+    ExecStatus execute(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Stmt* optimize(Optimizer& opt) override;
 };
 
 // Phase 1: dictionary expression {key: value}
 class DictExpr : public Expr {
 public:
-    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr>>> entries;
-    explicit DictExpr(std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr>>> e)
+    std::vector<std::pair<Expr*, Expr*>> entries;
+    explicit DictExpr(std::vector<std::pair<Expr*, Expr*>> e)
         : entries(std::move(e)) {}
     void print() const override;
     SatanValue evaluate(Environment& env) const override;
+    void compile(Compiler& compiler) const override;
+    void resolve(Resolver& resolver) override;
+    void write(AstWriter& out) const override;
+    Expr* optimize(Optimizer& opt) override;
+};
+
+// A parsed compilation unit. Every node lives in `arena`, so the statements
+// stay valid only while the Program, or a function declared in it, is alive.
+struct Program {
+    std::shared_ptr<AstArena> arena;
+    std::vector<Stmt*> statements;
+    bool empty() const { return statements.empty(); }
 };
 
 // =================== Parser ===================
 class Parser {
 public:
     explicit Parser(const std::vector<Token>& tokens);
-    std::vector<std::unique_ptr<Stmt>> parse();
+    // Pulls tokens from the lexer as it goes instead of lexing the whole file first
+    explicit Parser(Lexer& lexer);
+    Program parse();
+    // Next top-level statement as a unit of its own, empty at end of input.
+    // Tokens and nodes of earlier statements are dropped, so a file can be
+    // parsed and run piecewise.
+    Program parseNext();
 
 private:
-    const std::vector<Token>& tokens;
+    static constexpr size_t TOKEN_BATCH = 4096;
+
+    mutable std::deque<Token> tokens;   // window of the token stream; refilled from `lexer`
+    Lexer* lexer = nullptr;
     int current;
     int depth = 0;
+    std::shared_ptr<AstArena> arena;    // unit being parsed
+
+    template <typename T, typename... Args>
+    T* node(Args&&... args) { return arena->make<T>(std::forward<Args>(args)...); }
+
+    Program beginUnit();
+    Stmt* nextDeclaration();
 
     struct DepthGuard {
         int& depth;
@@ -349,49 +602,46 @@ private:
     };
 
     // Statements
-    std::unique_ptr<Stmt> declaration();
-    std::unique_ptr<Stmt> varDeclaration();
-    std::unique_ptr<Stmt> funDeclaration();
-    std::unique_ptr<Stmt> statement();
-    std::unique_ptr<Stmt> printStatement();
-    std::unique_ptr<Stmt> assembleStatement();
-    std::unique_ptr<Stmt> ifStatement();
-    std::unique_ptr<Stmt> whileStatement();
-    std::unique_ptr<Stmt> forStatement();
-    std::unique_ptr<Stmt> summonStatement();
-    std::unique_ptr<Stmt> returnStatement();
-    std::unique_ptr<Stmt> breakStatement();
-    std::unique_ptr<Stmt> continueStatement();
-    std::unique_ptr<Stmt> parseBlock();
-    std::unique_ptr<Stmt> expressionStatement();
+    Stmt* declaration();
+    Stmt* varDeclaration();
+    Stmt* funDeclaration();
+    Stmt* statement();
+    Stmt* printStatement();
+    Stmt* assembleStatement();
+    Stmt* ifStatement();
+    Stmt* whileStatement();
+    Stmt* forStatement();
+    Stmt* summonStatement();
+    Stmt* returnStatement();
+    Stmt* breakStatement();
+    Stmt* continueStatement();
+    BlockStmt* parseBlock();
+    Stmt* expressionStatement();
 
     // Expressions
-    std::unique_ptr<Expr> expression();
-    std::unique_ptr<Expr> assignment();
-    std::unique_ptr<Expr> logical();
-    std::unique_ptr<Expr> equality();
-    std::unique_ptr<Expr> comparison();
-    std::unique_ptr<Expr> term();
-    std::unique_ptr<Expr> factor();
-    std::unique_ptr<Expr> unary();
-    std::unique_ptr<Expr> call();
-    std::unique_ptr<Expr> primary();
+    Expr* expression();
+    Expr* assignment();
+    Expr* binary(int minPrecedence);   // infix operators binding at least this tightly
+    Expr* unary();
+    Expr* call();
+    Expr* primary();
 
     // Helpers
-    Token advance();
+    const Token& advance();
     bool match(std::initializer_list<TokenType> types);
     bool check(TokenType type) const;
-    Token peek() const;
-    Token peekNext() const;
-    Token consume(TokenType type, const std::string& message);
+    const Token& peek() const;
+    const Token& peekNext() const;
+    const Token& tokenAt(int index) const;
+    const Token& consume(TokenType type, const std::string& message);
     bool isAtEnd() const;
 
     // Phase 1 parsers
-    std::unique_ptr<Stmt> tryCatchStatement();
-    std::unique_ptr<Stmt> importStatement();
-    std::unique_ptr<Stmt> forInOrForStatement();
-    std::unique_ptr<Stmt> assertStatement();
-    std::unique_ptr<Stmt> testStatement();
+    Stmt* tryCatchStatement();
+    Stmt* importStatement();
+    Stmt* forInOrForStatement();
+    Stmt* assertStatement();
+    Stmt* testStatement();
 };
 
 #endif
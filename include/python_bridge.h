@@ -10,11 +10,14 @@
 #include <iostream>
 #include <algorithm>
 #include "satan_value.h"
+#include "dataframe.h"
 
 class PythonBridge {
 public:
     PythonBridge();
     ~PythonBridge();
+    PythonBridge(const PythonBridge&) = delete;
+    PythonBridge& operator=(const PythonBridge&) = delete;
 
     // Initialize session directory
     void initSession();
@@ -37,9 +40,25 @@ public:
     // Execute accumulated session script and return output
     std::string flushAndExecute();
 
+    // CSVs parsed natively for the cheap DataFrame queries
+    DataFrameCache& frames() { return frameCache; }
+
+    // True while a persistent worker holds the Python globals between calls
+    bool hasWorker() const { return workerPid > 0; }
+
+    // Terminate the persistent worker (it is restarted lazily on next use)
+    void stopWorker();
+
     // Parse return value from Python output
     SatanValue parseResult(const std::string& output);
 
+    // The __SATAN_RESULT__ value printed as a JSON list of numbers and
+    // strings, as an array; an empty array if there is none
+    SatanValue parseListResult(const std::string& output);
+
+    // Output without its __SATAN_RESULT__ line, for echoing to the user
+    std::string withoutResult(const std::string& output);
+
     // Get session directory
     std::string getSessionDir() const { return sessionDir; }
 
@@ -48,6 +67,13 @@ public:
 
     // Python code generators for ML operations
     std::string genLoadCSV(const std::string& pyVar, const std::string& filepath);
+
+    // Code that makes pyVar hold the CSV at filepath with the comma-separated
+    // preprocessing steps applied, or "" when the worker already holds that
+    // exact file version (same size and mtime) and pipeline. Results with
+    // steps are also kept in __satancache__ next to the CSV across runs.
+    std::string genUseFrame(const std::string& pyVar, const std::string& filepath,
+                            const std::string& steps = "");
     std::string genCreateModel(const std::string& pyVar, const std::string& modelType,
                                const std::vector<std::pair<std::string, std::string>>& kwargs = {});
     std::string genFitModel(const std::string& modelVar, const std::string& dataVar,
@@ -88,11 +114,12 @@ public:
     std::string genROCCurve(const std::string& modelVar, const std::string& plotPath);
     std::string genLearningCurve(const std::string& modelVar, const std::string& plotPath);
 
-    // Feature 4: Data Preprocessing
-    std::string genFillMissing(const std::string& dataVar, const std::string& src);
-    std::string genDropNulls(const std::string& dataVar, const std::string& src);
-    std::string genEncodeText(const std::string& dataVar, const std::string& src);
-    std::string genNormalize(const std::string& dataVar, const std::string& src);
+    // Feature 4: Data Preprocessing (each step transforms _df in place)
+    std::string genFillMissing();
+    std::string genDropNulls();
+    std::string genEncodeText();
+    std::string genNormalize();
+    std::string genPreprocessStep(const std::string& step);
 
     // Feature 5: Model Save / Load
     std::string genSaveModel(const std::string& modelVar, const std::string& filepath);
@@ -101,19 +128,64 @@ public:
     // Feature 6: AutoML
     std::string genAutoML(const std::string& dataVar, const std::string& winnerVar);
 
+    // Frames staged by genUseFrame/genLoadCSV are only committed by the
+    // executeImmediate that runs their code. Hold one of these from
+    // generating that code to running it: if anything in between throws,
+    // the staged frames are dropped instead of being committed by a later run.
+    class FrameStage {
+    public:
+        explicit FrameStage(PythonBridge& bridge) : bridge(bridge) {}
+        ~FrameStage() { bridge.pendingFrames.clear(); }
+        FrameStage(const FrameStage&) = delete;
+        FrameStage& operator=(const FrameStage&) = delete;
+    private:
+        PythonBridge& bridge;
+    };
+
 
 private:
     std::string sessionDir;
     std::string plotDir;
+    DataFrameCache frameCache;
     std::string sessionScript;
     int varCounter;
     int plotCounter;
     bool pythonChecked;
     bool pythonAvailable;
 
+    // Persistent worker process: requests and replies are framed over two pipes
+    int workerPid;
+    int workerIn;    // our write end, the worker's fd 3
+    int workerOut;   // our read end, the worker's fd 4
+    bool workerPrimed;
+    bool workerDisabled;
+
+    // DataFrames resident in the worker, keyed by Python variable. Loads are
+    // staged in pendingFrames and only committed once their script succeeds.
+    struct ResidentFrame {
+        std::string source;
+        uintmax_t size;
+        long long mtime;
+        std::string steps;
+    };
+    std::unordered_map<std::string, ResidentFrame> residentFrames;
+    std::vector<std::pair<std::string, ResidentFrame>> pendingFrames;
+
+    // Fill in size/mtime for filepath; false if the file cannot be stat'ed
+    bool statFrame(const std::string& filepath, ResidentFrame& frame);
+
     // Helper to write and execute a Python file
     std::string writeTempAndRun(const std::string& script);
 
+    // Start the worker if needed; false when it cannot run on this platform
+    bool startWorker();
+
+    // Send one code frame to the worker and return its captured stdout
+    std::string runInWorker(const std::string& code);
+
+    // Get the Python source of the worker's request loop
+    std::string getWorkerSource();
+
     // Helper to read a file
     std::string readFile(const std::string& path);
 
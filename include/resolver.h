@@ -0,0 +1,35 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "parser.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Runs between parsing and tree-walking execution. Each node resolves itself
+// through Expr::resolve / Stmt::resolve, giving every local variable reference
+// a (depth, slot) pair that mirrors the scopes the interpreter creates at runtime.
+//
+// Names declared at the top level of a script are not in any scope; they,
+// builtins and code pulled in by `import` are still looked up by name.
+class Resolver {
+public:
+    void resolve(const std::vector<Stmt*>& statements);
+
+    void beginScope();
+    ScopeInfo endScope();
+    int declare(Symbol name);               // new slot in the innermost scope, -1 at top level
+    void resolveName(Symbol name, int& depth, uint32_t& slot) const;
+    void captureScopes();                   // a function declared here may outlive the open scopes
+
+private:
+    struct Scope {
+        std::unordered_map<Symbol, uint32_t> names;
+        uint32_t numSlots = 0;
+        bool captured = false;
+    };
+
+    std::vector<Scope> scopes;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include "lexer.h"
+#include "satan_value.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Value semantics shared by the tree-walking interpreter and the bytecode VM,
+// so both execution engines agree on every operator and built-in method.
+
+// Runs a user-defined function value with already evaluated arguments.
+// Each engine supplies its own; native functions never go through it.
+using FunctionInvoker = std::function<SatanValue(const SatanValue& fn, std::vector<SatanValue> args)>;
+
+// Arithmetic, comparison and equality operators. Arithmetic and ordering
+// apply element-wise when an array meets an array or number (array_math.h).
+SatanValue binaryOp(TokenType op, const SatanValue& l, const SatanValue& r);
+
+// obj.name, including ML object properties and .length
+SatanValue getMember(const SatanValue& obj, Symbol name);
+
+// obj[idx] on arrays, strings and dictionaries
+SatanValue getIndex(const SatanValue& obj, const SatanValue& idx);
+
+// target op= value for the arithmetic operator of a compound assignment.
+// Numbers are updated in place; anything else goes through binaryOp.
+void compoundAssign(TokenType op, SatanValue& target, const SatanValue& value);
+
+// obj[idx] = value on arrays and dictionaries, or obj[idx] op= value unless
+// op is EQUAL. The container is changed in place, so every reference to it
+// sees the update. Returns the value now stored.
+SatanValue setIndex(const SatanValue& obj, const SatanValue& idx, TokenType op, const SatanValue& value);
+
+// obj.name = value (or op=) on objects, likewise
+SatanValue setMember(const SatanValue& obj, Symbol name, TokenType op, const SatanValue& value);
+
+// A built-in method for one receiver type, e.g. push on arrays
+using MethodHandler = SatanValue (*)(const SatanValue& obj, std::vector<SatanValue>& args,
+                                     const FunctionInvoker& invoke);
+
+// The built-in `method` for receivers of `type` called with `argc` arguments,
+// or nullptr if there is none. The answer depends only on the arguments, so
+// a call site may cache it (see MethodCallExpr).
+MethodHandler findMethod(ValueType type, Symbol method, size_t argc);
+
+// Built-in array/string/dict methods, then the ML object handler
+SatanValue callMethod(const SatanValue& obj, Symbol method,
+                      std::vector<SatanValue>& args, const FunctionInvoker& invoke);
+
+#endif
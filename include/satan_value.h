@@ -1,7 +1,9 @@
 #ifndef SATAN_VALUE_H
 #define SATAN_VALUE_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <memory>
@@ -10,70 +12,219 @@
 #include <cmath>
 #include <iostream>
 #include <stdexcept>
+#include "symbol.h"
 
 // Forward declarations
 class BlockStmt;
 class Environment;
+struct FunctionProto;
+struct Upvalue;
 
-enum class ValueType {
+enum class ValueType : uint8_t {
     NIL, NUMBER, STRING, BOOLEAN, ARRAY, OBJECT, NATIVE_FN, FUNCTION
 };
 
 struct FunctionObject {
-    std::vector<std::string> params;
-    std::shared_ptr<BlockStmt> body;
+    std::vector<Symbol> params;
+    std::shared_ptr<BlockStmt> body;                 // tree-walking interpreter
+    std::shared_ptr<Environment> closure;            // tree-walker: the scope it was declared in
+    std::shared_ptr<const FunctionProto> proto;      // bytecode VM
+    std::vector<std::shared_ptr<Upvalue>> upvalues;  // variables captured by a VM closure
+    bool inOwnScope = false;                         // stored in a slot of `closure`, which it keeps alive
 };
 
+// Called when an inOwnScope function is down to one holder, which may be
+// its scope: queues the scope for cycle collection (environment.cpp)
+void suspectClosureScope(const FunctionObject& fn);
+
 class SatanValue;
 using NativeFn = std::function<SatanValue(std::vector<SatanValue>)>;
 
+// Lets string-keyed maps be searched with a std::string_view without building a key
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); }
+};
+
+template <typename V>
+using StringMap = std::unordered_map<std::string, V, StringHash, std::equal_to<>>;
+
+// Object and dictionary properties. Names the program mentions are
+// interned symbols, but a key computed at runtime (d[str(i)]) that no
+// identifier uses is kept as a string, so it goes away with its object
+// instead of staying in the process-wide symbol table. Each key is stored
+// once: under its symbol if the name was interned when it was added, else
+// under its text, where a lookup by symbol still finds it should the name
+// be interned later.
+class ObjectMap {
+public:
+    inline SatanValue* find(Symbol name);
+    inline SatanValue* find(std::string_view name);
+    const SatanValue* find(Symbol name) const { return const_cast<ObjectMap*>(this)->find(name); }
+    const SatanValue* find(std::string_view name) const { return const_cast<ObjectMap*>(this)->find(name); }
+
+    // The entry for `name`, added as nil if missing; `added` says whether it was
+    inline SatanValue& emplace(Symbol name, bool& added);
+    inline SatanValue& emplace(std::string_view name, bool& added);
+    inline void erase(Symbol name);
+    inline void erase(std::string_view name);
+
+    size_t size() const { return symbols.size() + texts.size(); }
+
+    // Calls f(const std::string& name, const SatanValue& value) on each entry
+    template <typename F>
+    void forEach(F&& f) const;
+
+private:
+    std::unordered_map<Symbol, SatanValue> symbols;
+    StringMap<SatanValue> texts;
+
+    inline SatanValue* findText(std::string_view name);
+};
+
+// The numbers range() yields: count of them, from start, step apart
+struct NumberRange {
+    double start = 0;
+    double step = 1;
+    size_t count = 0;
+
+    double at(size_t i) const { return start + static_cast<double>(i) * step; }
+};
+
+// Array elements. While every element is a number they are stored packed
+// as doubles, half the size of SatanValues and readable without a type
+// check; the first store of anything else unpacks the array for good.
+// An empty array starts out packed.
+//
+// An array made by range() holds no elements at all, only its NumberRange,
+// until something changes it or needs the elements in memory (values(),
+// packedNumbers()); then it is materialized as a packed array.
+class SatanArray {
+public:
+    SatanArray() = default;
+    explicit SatanArray(std::vector<SatanValue> items);
+    explicit SatanArray(std::vector<double> numbers) : numbers(std::move(numbers)) {}
+    explicit SatanArray(NumberRange range) : lazy(true), lazyRange(range) {}
+
+    size_t size() const { return lazy ? lazyRange.count : packed ? numbers.size() : elements.size(); }
+    bool empty() const { return size() == 0; }
+    // Packed in memory; false for an unmaterialized range
+    bool isPacked() const { return packed && !lazy; }
+    bool isRange() const { return lazy; }
+    // Only meaningful while isRange()
+    const NumberRange& range() const { return lazyRange; }
+
+    inline SatanValue get(size_t i) const;
+    inline void set(size_t i, SatanValue value);
+    inline void push(SatanValue value);
+    inline SatanValue pop();   // the array must not be empty
+    void reserve(size_t n) { packed ? numbers.reserve(n) : elements.reserve(n); }
+
+    // The packed buffer, materializing a range first; only meaningful while
+    // isPacked() or isRange()
+    std::vector<double>& packedNumbers() { materialize(); return numbers; }
+    const std::vector<double>& packedNumbers() const { return numbers; }
+
+    // The elements as values, unpacking the array first if needed. Use it
+    // for stores and other rare paths; reads should go through get or forEach.
+    std::vector<SatanValue>& values();
+
+    // Calls f(const SatanValue&) on each element in order
+    template <typename F>
+    void forEach(F&& f) const;
+
+private:
+    std::vector<SatanValue> elements;
+    std::vector<double> numbers;
+    bool packed = true;
+    bool lazy = false;
+    NumberRange lazyRange;
+
+    inline void materialize();
+};
+
+// Strings, arrays, objects and functions live in a refcounted heap cell
+// shared by every copy of the value. The interpreter is single-threaded,
+// so the count is not atomic.
+struct HeapCell {
+    uint32_t refs = 1;
+};
+
+template <typename T>
+struct Boxed : HeapCell {
+    T value;
+    template <typename... Args>
+    explicit Boxed(Args&&... args) : value(std::forward<Args>(args)...) {}
+};
+
+// A value is 16 bytes: a type tag plus either an immediate (number, bool)
+// or a pointer to its heap cell.
 class SatanValue {
 public:
     ValueType type;
-    double number;
-    std::string str;
-    bool boolean;
-    std::shared_ptr<std::vector<SatanValue>> array;
-    std::shared_ptr<std::unordered_map<std::string, SatanValue>> object;
-    std::shared_ptr<NativeFn> nativeFn;
-    std::shared_ptr<FunctionObject> function;
+    union {
+        double number;
+        bool boolean;
+        HeapCell* cell;
+    };
 
     // Default: nil
-    SatanValue() : type(ValueType::NIL), number(0), boolean(false) {}
+    SatanValue() : type(ValueType::NIL), number(0) {}
     // Number
-    explicit SatanValue(double n) : type(ValueType::NUMBER), number(n), boolean(false) {}
+    explicit SatanValue(double n) : type(ValueType::NUMBER), number(n) {}
     // String
-    explicit SatanValue(const std::string& s) : type(ValueType::STRING), number(0), str(s), boolean(false) {}
+    explicit SatanValue(const std::string& s) : type(ValueType::STRING), cell(new Boxed<std::string>(s)) {}
+    explicit SatanValue(std::string&& s) : type(ValueType::STRING), cell(new Boxed<std::string>(std::move(s))) {}
     // Bool
-    explicit SatanValue(bool b) : type(ValueType::BOOLEAN), number(0), boolean(b) {}
+    explicit SatanValue(bool b) : type(ValueType::BOOLEAN), number(0) { boolean = b; }
+
+    SatanValue(const SatanValue& other) : type(other.type), number(other.number) {
+        if (isHeap()) cell->refs++;
+    }
+    SatanValue(SatanValue&& other) noexcept : type(other.type), number(other.number) {
+        other.type = ValueType::NIL;
+    }
+    SatanValue& operator=(const SatanValue& other) {
+        if (other.isHeap()) other.cell->refs++;
+        release();
+        type = other.type;
+        number = other.number;
+        return *this;
+    }
+    SatanValue& operator=(SatanValue&& other) noexcept {
+        if (this != &other) {
+            release();
+            type = other.type;
+            number = other.number;
+            other.type = ValueType::NIL;
+        }
+        return *this;
+    }
+    ~SatanValue() { release(); }
 
     // Factory methods
+    // Packed when every element is a number
     static SatanValue makeArray(std::vector<SatanValue> elements) {
-        SatanValue v;
-        v.type = ValueType::ARRAY;
-        v.array = std::make_shared<std::vector<SatanValue>>(std::move(elements));
-        return v;
+        return SatanValue(ValueType::ARRAY, new Boxed<SatanArray>(std::move(elements)));
+    }
+    static SatanValue makeArray(std::vector<double> numbers) {
+        return SatanValue(ValueType::ARRAY, new Boxed<SatanArray>(std::move(numbers)));
+    }
+    // An array of the range's numbers, not materialized until needed
+    static SatanValue makeRange(NumberRange range) {
+        return SatanValue(ValueType::ARRAY, new Boxed<SatanArray>(range));
     }
 
     static SatanValue makeObject() {
-        SatanValue v;
-        v.type = ValueType::OBJECT;
-        v.object = std::make_shared<std::unordered_map<std::string, SatanValue>>();
-        return v;
+        return SatanValue(ValueType::OBJECT, new Boxed<ObjectMap>());
     }
 
     static SatanValue makeNativeFn(NativeFn fn) {
-        SatanValue v;
-        v.type = ValueType::NATIVE_FN;
-        v.nativeFn = std::make_shared<NativeFn>(std::move(fn));
-        return v;
+        return SatanValue(ValueType::NATIVE_FN, new Boxed<NativeFn>(std::move(fn)));
     }
 
     static SatanValue makeFunction(FunctionObject func) {
-        SatanValue v;
-        v.type = ValueType::FUNCTION;
-        v.function = std::make_shared<FunctionObject>(std::move(func));
-        return v;
+        return SatanValue(ValueType::FUNCTION, new Boxed<FunctionObject>(std::move(func)));
     }
 
     // Type checks
@@ -87,11 +238,25 @@ public:
     bool isFunction() const { return type == ValueType::FUNCTION; }
     bool isCallable() const { return isNativeFn() || isFunction(); }
 
+    // Payload access; empty string / nullptr when the value has another type.
+    // Arrays and objects are shared by reference, so their pointers are mutable.
+    const std::string& str() const {
+        static const std::string empty;
+        return isString() ? unbox<std::string>() : empty;
+    }
+    SatanArray* array() const { return isArray() ? &unbox<SatanArray>() : nullptr; }
+    ObjectMap* object() const { return isObject() ? &unbox<ObjectMap>() : nullptr; }
+    NativeFn* nativeFn() const { return isNativeFn() ? &unbox<NativeFn>() : nullptr; }
+    FunctionObject* function() const { return isFunction() ? &unbox<FunctionObject>() : nullptr; }
+
+    // Number of values sharing this value's heap cell; 0 for immediates
+    uint32_t refCount() const { return isHeap() ? cell->refs : 0; }
+
     double asNumber() const {
         if (type == ValueType::NUMBER) return number;
         if (type == ValueType::BOOLEAN) return boolean ? 1.0 : 0.0;
         if (type == ValueType::STRING) {
-            try { return std::stod(str); } catch (...) { return 0.0; }
+            try { return std::stod(str()); } catch (...) { return 0.0; }
         }
         return 0.0;
     }
@@ -101,8 +266,8 @@ public:
             case ValueType::NIL: return false;
             case ValueType::BOOLEAN: return boolean;
             case ValueType::NUMBER: return number != 0.0;
-            case ValueType::STRING: return !str.empty();
-            case ValueType::ARRAY: return array && !array->empty();
+            case ValueType::STRING: return !str().empty();
+            case ValueType::ARRAY: return !array()->empty();
             case ValueType::OBJECT: return true;
             case ValueType::NATIVE_FN: return true;
             case ValueType::FUNCTION: return true;
@@ -122,24 +287,21 @@ public:
                 oss << number;
                 return oss.str();
             }
-            case ValueType::STRING: return str;
+            case ValueType::STRING: return str();
             case ValueType::BOOLEAN: return boolean ? "true" : "false";
             case ValueType::ARRAY: {
                 std::string result = "[";
-                if (array) {
-                    for (size_t i = 0; i < array->size(); i++) {
-                        if (i > 0) result += ", ";
-                        if ((*array)[i].isString()) result += "\"" + (*array)[i].str + "\"";
-                        else result += (*array)[i].toString();
-                    }
-                }
+                bool first = true;
+                array()->forEach([&](const SatanValue& elem) {
+                    if (!first) result += ", ";
+                    first = false;
+                    if (elem.isString()) result += "\"" + elem.str() + "\"";
+                    else result += elem.toString();
+                });
                 return result + "]";
             }
             case ValueType::OBJECT: {
-                if (object) {
-                    auto it = object->find("__type__");
-                    if (it != object->end()) return "<" + it->second.str + ">";
-                }
+                if (const SatanValue* type = object()->find(SYM_TYPE)) return "<" + type->str() + ">";
                 return "<object>";
             }
             case ValueType::NATIVE_FN: return "<native fn>";
@@ -149,21 +311,182 @@ public:
     }
 
     // Object property access
-    SatanValue getProperty(const std::string& name) const {
-        if (type == ValueType::OBJECT && object) {
-            auto it = object->find(name);
-            if (it != object->end()) return it->second;
-        }
-        return SatanValue();
+    SatanValue getProperty(Symbol name) const {
+        const SatanValue* value = isObject() ? object()->find(name) : nullptr;
+        return value ? *value : SatanValue();
+    }
+
+    void setProperty(Symbol name, SatanValue val) {
+        if (!isObject()) *this = makeObject();
+        bool added;
+        object()->emplace(name, added) = std::move(val);
+    }
+
+    // Keys computed at runtime (dictionary literals, d["key"]); see ObjectMap
+    SatanValue getProperty(std::string_view name) const {
+        const SatanValue* value = isObject() ? object()->find(name) : nullptr;
+        return value ? *value : SatanValue();
+    }
+    void setProperty(std::string_view name, SatanValue val) {
+        if (!isObject()) *this = makeObject();
+        bool added;
+        object()->emplace(name, added) = std::move(val);
+    }
+
+private:
+    SatanValue(ValueType t, HeapCell* c) : type(t), cell(c) {}
+
+    bool isHeap() const {
+        return type != ValueType::NIL && type != ValueType::NUMBER && type != ValueType::BOOLEAN;
     }
 
-    void setProperty(const std::string& name, SatanValue val) {
-        if (type != ValueType::OBJECT || !object) {
-            type = ValueType::OBJECT;
-            object = std::make_shared<std::unordered_map<std::string, SatanValue>>();
+    template <typename T>
+    T& unbox() const { return static_cast<Boxed<T>*>(cell)->value; }
+
+    void release() {
+        if (!isHeap()) return;
+        if (--cell->refs > 0) {
+            if (cell->refs == 1 && type == ValueType::FUNCTION && function()->inOwnScope) suspectClosureScope(*function());
+            return;
+        }
+        switch (type) {
+            case ValueType::STRING: delete static_cast<Boxed<std::string>*>(cell); break;
+            case ValueType::ARRAY: delete static_cast<Boxed<SatanArray>*>(cell); break;
+            case ValueType::OBJECT: delete static_cast<Boxed<ObjectMap>*>(cell); break;
+            case ValueType::NATIVE_FN: delete static_cast<Boxed<NativeFn>*>(cell); break;
+            case ValueType::FUNCTION: delete static_cast<Boxed<FunctionObject>*>(cell); break;
+            default: break;
         }
-        (*object)[name] = std::move(val);
     }
 };
 
+static_assert(sizeof(SatanValue) == 16, "SatanValue should stay two words");
+
+inline SatanArray::SatanArray(std::vector<SatanValue> items) {
+    for (const SatanValue& v : items) {
+        if (!v.isNumber()) {
+            elements = std::move(items);
+            packed = false;
+            return;
+        }
+    }
+    numbers.reserve(items.size());
+    for (const SatanValue& v : items) numbers.push_back(v.number);
+}
+
+inline void SatanArray::materialize() {
+    if (!lazy) return;
+    numbers.resize(lazyRange.count);
+    for (size_t i = 0; i < lazyRange.count; i++) numbers[i] = lazyRange.at(i);
+    lazy = false;
+}
+
+inline std::vector<SatanValue>& SatanArray::values() {
+    materialize();
+    if (packed) {
+        elements.reserve(numbers.size());
+        for (double n : numbers) elements.emplace_back(n);
+        numbers = std::vector<double>();
+        packed = false;
+    }
+    return elements;
+}
+
+inline SatanValue SatanArray::get(size_t i) const {
+    if (!packed) return elements[i];
+    return SatanValue(lazy ? lazyRange.at(i) : numbers[i]);
+}
+
+inline void SatanArray::set(size_t i, SatanValue value) {
+    materialize();
+    if (packed && value.isNumber()) numbers[i] = value.number;
+    else values()[i] = std::move(value);
+}
+
+inline void SatanArray::push(SatanValue value) {
+    materialize();
+    if (packed && value.isNumber()) numbers.push_back(value.number);
+    else values().push_back(std::move(value));
+}
+
+inline SatanValue SatanArray::pop() {
+    materialize();
+    if (packed) {
+        double last = numbers.back();
+        numbers.pop_back();
+        return SatanValue(last);
+    }
+    SatanValue last = std::move(elements.back());
+    elements.pop_back();
+    return last;
+}
+
+inline SatanValue* ObjectMap::findText(std::string_view name) {
+    if (texts.empty()) return nullptr;
+    auto it = texts.find(name);
+    return it == texts.end() ? nullptr : &it->second;
+}
+
+inline SatanValue* ObjectMap::find(Symbol name) {
+    auto it = symbols.find(name);
+    return it != symbols.end() ? &it->second : findText(symbolName(name));
+}
+
+inline SatanValue* ObjectMap::find(std::string_view name) {
+    if (SatanValue* value = findText(name)) return value;
+    Symbol symbol;
+    if (!lookupSymbol(name, symbol)) return nullptr;
+    auto it = symbols.find(symbol);
+    return it == symbols.end() ? nullptr : &it->second;
+}
+
+inline SatanValue& ObjectMap::emplace(Symbol name, bool& added) {
+    if (SatanValue* value = findText(symbolName(name))) {
+        added = false;
+        return *value;
+    }
+    auto [it, inserted] = symbols.try_emplace(name);
+    added = inserted;
+    return it->second;
+}
+
+inline SatanValue& ObjectMap::emplace(std::string_view name, bool& added) {
+    Symbol symbol;
+    if (lookupSymbol(name, symbol)) return emplace(symbol, added);
+    auto [it, inserted] = texts.try_emplace(std::string(name));
+    added = inserted;
+    return it->second;
+}
+
+inline void ObjectMap::erase(Symbol name) {
+    if (symbols.erase(name) == 0 && !texts.empty()) erase(symbolName(name));
+}
+
+inline void ObjectMap::erase(std::string_view name) {
+    auto it = texts.find(name);
+    if (it != texts.end()) {
+        texts.erase(it);
+        return;
+    }
+    Symbol symbol;
+    if (lookupSymbol(name, symbol)) symbols.erase(symbol);
+}
+
+template <typename F>
+void ObjectMap::forEach(F&& f) const {
+    for (const auto& [name, value] : symbols) f(symbolName(name), value);
+    for (const auto& [name, value] : texts) f(name, value);
+}
+
+template <typename F>
+void SatanArray::forEach(F&& f) const {
+    if (lazy) {
+        for (size_t i = 0; i < lazyRange.count; i++) f(SatanValue(lazyRange.at(i)));
+    } else if (packed) {
+        for (double n : numbers) f(SatanValue(n));
+    } else {
+        for (const SatanValue& v : elements) f(v);
+    }
+}
+
 #endif
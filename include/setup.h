@@ -3,6 +3,8 @@
 
 #include <string>
 
+constexpr const char* SATAN_VERSION = "2.0.0";
+
 // Check all dependencies and print status
 void checkDependencies();
 
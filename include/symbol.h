@@ -0,0 +1,84 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Every identifier, property and method name is interned once into a
+// process-wide table and passed around as a 32-bit id. Environments, object
+// maps and method dispatch compare ids instead of hashing strings. The table
+// never shrinks, so names only computed at runtime (dictionary keys such as
+// d[str(i)]) are not interned; ObjectMap keeps them as strings.
+using Symbol = uint32_t;
+
+// Names the runtime refers to directly. They are interned first, in this
+// order, so each SYM_ constant is the id of its name.
+#define SATAN_PREDEFINED_SYMBOLS(X) \
+    X(TYPE, "__type__") \
+    X(PYVAR, "__pyvar__") \
+    X(SOURCE, "__source__") \
+    X(STEPS, "__steps__") \
+    X(KWARGS, "__kwargs__") \
+    X(FITTED, "__fitted__") \
+    X(CREATE_CODE, "__create_code__") \
+    X(LAYERS, "__layers__") \
+    X(PARENT, "__parent__") \
+    X(COLUMN, "__column__") \
+    X(FIND_BEST, "__find_best__") \
+    X(NAMED_KEY, "__named_key__") \
+    X(NAMED_VALUE, "__named_value__") \
+    X(LENGTH, "length") \
+    X(PUSH, "push") \
+    X(POP, "pop") \
+    X(SIZE, "size") \
+    X(MAP, "map") \
+    X(FILTER, "filter") \
+    X(FOR_EACH, "forEach") \
+    X(JOIN, "join") \
+    X(INDEX_OF, "indexOf") \
+    X(CONTAINS, "contains") \
+    X(REVERSE, "reverse") \
+    X(SLICE, "slice") \
+    X(SORT, "sort") \
+    X(UPPER, "upper") \
+    X(LOWER, "lower") \
+    X(SPLIT, "split") \
+    X(TRIM, "trim") \
+    X(REPLACE, "replace") \
+    X(STARTS_WITH, "starts_with") \
+    X(ENDS_WITH, "ends_with") \
+    X(CHAR_AT, "charAt") \
+    X(INCLUDES, "includes") \
+    X(SUBSTRING, "substring") \
+    X(REPEAT, "repeat") \
+    X(KEYS, "keys") \
+    X(VALUES, "values") \
+    X(HAS, "has")
+
+enum PredefinedSymbol : Symbol {
+#define SATAN_SYMBOL_ENUM(id, text) SYM_##id,
+    SATAN_PREDEFINED_SYMBOLS(SATAN_SYMBOL_ENUM)
+#undef SATAN_SYMBOL_ENUM
+    PREDEFINED_SYMBOL_COUNT
+};
+
+// Marks a compiler slot that has no name
+constexpr Symbol NO_SYMBOL = UINT32_MAX;
+
+// Id of `name`, adding it on first use. Not thread-safe: only the
+// interpreter thread interns.
+Symbol intern(std::string_view name);
+
+// Looks `name` up without adding it; false if it was never interned, in
+// which case no object or scope can have a property or variable by that name
+bool lookupSymbol(std::string_view name, Symbol& symbol);
+
+// The text a symbol was interned from
+const std::string& symbolName(Symbol symbol);
+
+// Runtime-internal keys such as __type__ start with two underscores and
+// are hidden from keys()/values()/size()
+bool isInternalName(std::string_view name);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "environment.h"
+#include "runtime.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class ModuleRegistry;
+
+constexpr size_t MAX_CALL_DEPTH = 100000;
+
+// Stack-based bytecode VM. A frame's locals occupy fixed slots at the start
+// of its window on the value stack, and its operands are pushed above them.
+class VM {
+public:
+    // Names the compiled code does not define resolve against `builtins`
+    VM(Environment& builtins, ModuleRegistry& modules);
+
+    // Runs a compiled script; its top-level declarations become globals
+    void runScript(const std::shared_ptr<FunctionProto>& script);
+
+    GlobalTable& getGlobals() { return globals; }
+
+private:
+    struct Frame {
+        const FunctionProto* proto;
+        FunctionObject* closure;
+        size_t ip;
+        size_t base;   // stack index of slot 0; the callee sits just below it
+    };
+
+    struct Handler {
+        size_t frameCount;   // frames.size() when the try began
+        size_t stackSize;
+        size_t target;
+        size_t firstSlot;    // first stack slot of the try block's locals
+    };
+
+    Environment& builtins;
+    ModuleRegistry& modules;
+    GlobalTable globals;
+    std::vector<SatanValue> stack;
+    std::vector<Frame> frames;
+    std::vector<Handler> handlers;
+    std::vector<std::shared_ptr<Upvalue>> openUpvalues;   // sorted by slot
+    FunctionInvoker invoker;
+
+    SatanValue run(size_t entryFrames);
+    SatanValue execute(size_t entryFrames);
+    void unwind(size_t entryFrames);
+    void pushFrame(const SatanValue& callee, size_t base);
+    SatanValue callFunction(const SatanValue& fn, std::vector<SatanValue> args);
+    void resolveGlobal(uint32_t id);
+    const SatanValue* fusedOperand(const FusedOperand& operand, const Frame& frame);
+    bool runFused(const FusedSite& site, const Frame& frame);
+    std::shared_ptr<Upvalue> captureUpvalue(size_t slot);
+    void closeUpvalues(size_t fromSlot);
+    void importFile(const std::string& path);
+};
+
+#endif
@@ -1,38 +1,70 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <optional>
 #include <string>
 #include <cstring>
+#include <filesystem>
 #include "include/lexer.h"
 #include "include/parser.h"
 #include "include/interpreter.h"
 #include "include/repl.h"
 #include "include/setup.h"
+#include "include/ast_cache.h"
+#include "include/optimizer.h"
 
-static void runFile(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "\033[31m[error]\033[0m Could not open file '" << path << "'" << std::endl;
-        return;
-    }
+// Scripts at least this large are parsed and run one top-level statement at
+// a time, so tokens and AST for the whole file never exist at once
+static constexpr size_t STREAM_SOURCE_BYTES = 64 * 1024 * 1024;
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
+static void reportUnreadable(const std::string& path) {
+    std::cerr << "\033[31m[error]\033[0m Could not open file '" << path << "'" << std::endl;
+}
 
-    Lexer lexer(source);
-    auto tokens = lexer.scanTokens();
+static void runFile(const std::string& path, bool treeWalk, int optimizationLevel) {
+    std::error_code sizeError;
+    uintmax_t size = std::filesystem::file_size(path, sizeError);
+    if (sizeError) {
+        reportUnreadable(path);
+        return;
+    }
 
-    Parser parser(tokens);
-    auto statements = parser.parse();
+    // Streamed scripts skip the parse cache, which needs the whole AST at once
+    if (size >= STREAM_SOURCE_BYTES) {
+        std::optional<Lexer> lexer;
+        try {
+            lexer.emplace(Lexer::fromFile(path));
+        } catch (const std::runtime_error&) {
+            reportUnreadable(path);
+            return;
+        }
+        Parser parser(*lexer);
+        Interpreter interpreter;
+        interpreter.setTreeWalk(treeWalk);
+        interpreter.setOptimizationLevel(optimizationLevel);
+        bool parsedAny = false;
+        // Each statement is its own unit, freed once it has run unless a
+        // function declared in it is still reachable
+        for (Program unit = parser.parseNext(); !unit.empty(); unit = parser.parseNext()) {
+            parsedAny = true;
+            if (!interpreter.interpret(unit)) return;
+        }
+        if (!parsedAny) std::cerr << "\033[31m[error]\033[0m Parsing failed." << std::endl;
+        return;
+    }
 
-    if (statements.empty()) {
+    std::optional<Program> program = loadProgram(path);
+    if (!program) {
+        reportUnreadable(path);
+        return;
+    }
+    if (program->empty()) {
         std::cerr << "\033[31m[error]\033[0m Parsing failed." << std::endl;
         return;
     }
 
     Interpreter interpreter;
-    interpreter.interpret(statements);
+    interpreter.setTreeWalk(treeWalk);
+    interpreter.setOptimizationLevel(optimizationLevel);
+    interpreter.interpret(*program);
 }
 
 int main(int argc, char* argv[]) {
@@ -50,15 +82,28 @@ int main(int argc, char* argv[]) {
         std::cout << " Usage:" << std::endl;
         std::cout << "   satan                   Launch REPL" << std::endl;
         std::cout << "   satan <script.satan>     Run a Satan script" << std::endl;
+        std::cout << "   satan --tree-walk <file> Run on the AST interpreter instead of the VM" << std::endl;
+        std::cout << "   satan -O0 <file>         Run without constant folding or dead code removal" << std::endl;
         std::cout << "   satan --version          Show version info" << std::endl;
         std::cout << "   satan --check            Check dependencies" << std::endl;
         std::cout << "   satan --setup-ml         Install ML dependencies" << std::endl;
         std::cout << "   satan --help             Show this help" << std::endl;
-    } else if (argc == 2) {
-        runFile(argv[1]);
     } else {
-        std::cerr << "Usage: satan [script.satan]" << std::endl;
-        return 1;
+        bool treeWalk = false;
+        int optimizationLevel = DEFAULT_OPTIMIZATION_LEVEL;
+        int arg = 1;
+        for (; arg < argc - 1; arg++) {
+            std::string option = argv[arg];
+            if (option == "--tree-walk") treeWalk = true;
+            else if (option == "-O0") optimizationLevel = 0;
+            else if (option == "-O1") optimizationLevel = 1;
+            else break;
+        }
+        if (arg != argc - 1) {
+            std::cerr << "Usage: satan [--tree-walk] [-O0|-O1] [script.satan]" << std::endl;
+            return 1;
+        }
+        runFile(argv[arg], treeWalk, optimizationLevel);
     }
     return 0;
 }
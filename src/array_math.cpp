@@ -0,0 +1,324 @@
+#include "../include/array_math.h"
+#include "../include/runtime.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#define ARRAY_AVX2 1
+#include <immintrin.h>
+#endif
+
+bool isElementwiseArithmetic(TokenType op) {
+    switch (op) {
+        case TokenType::PLUS: case TokenType::MINUS: case TokenType::STAR:
+        case TokenType::SLASH: case TokenType::PERCENT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isElementwise(TokenType op) {
+    switch (op) {
+        case TokenType::LESS: case TokenType::LESS_EQUAL:
+        case TokenType::GREATER: case TokenType::GREATER_EQUAL:
+            return true;
+        default:
+            return isElementwiseArithmetic(op);
+    }
+}
+
+static bool isComparison(TokenType op) {
+    return isElementwise(op) && !isElementwiseArithmetic(op);
+}
+
+static bool divides(TokenType op) {
+    return op == TokenType::SLASH || op == TokenType::PERCENT;
+}
+
+// Elements per block: the handful of block buffers a chain needs stay in L1
+static constexpr size_t BLOCK = 512;
+
+// out[i] = a[i] op b[i]; comparisons store 1.0 or 0.0. `out` may be `a`.
+using Kernel = void (*)(const double* a, const double* b, double* out, size_t n);
+
+// =================== Scalar ===================
+
+#define SCALAR_KERNEL(name, expr) \
+    static void name##Scalar(const double* a, const double* b, double* out, size_t n) { \
+        for (size_t i = 0; i < n; i++) out[i] = (expr); \
+    }
+
+SCALAR_KERNEL(add, a[i] + b[i])
+SCALAR_KERNEL(subtract, a[i] - b[i])
+SCALAR_KERNEL(multiply, a[i] * b[i])
+SCALAR_KERNEL(divide, a[i] / b[i])
+SCALAR_KERNEL(modulo, std::fmod(a[i], b[i]))
+SCALAR_KERNEL(less, a[i] < b[i] ? 1.0 : 0.0)
+SCALAR_KERNEL(lessEqual, a[i] <= b[i] ? 1.0 : 0.0)
+SCALAR_KERNEL(greater, a[i] > b[i] ? 1.0 : 0.0)
+SCALAR_KERNEL(greaterEqual, a[i] >= b[i] ? 1.0 : 0.0)
+
+static bool anyZeroScalar(const double* p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == 0) return true;
+    }
+    return false;
+}
+
+// =================== AVX2 ===================
+
+#if ARRAY_AVX2
+#define ARRAY_TARGET_AVX2 __attribute__((target("avx2")))
+
+// Four doubles at a time; the tail goes to the scalar kernel
+#define AVX2_KERNEL(name, expr) \
+    ARRAY_TARGET_AVX2 static void name##Avx2(const double* a, const double* b, double* out, size_t n) { \
+        size_t i = 0; \
+        for (; i + 4 <= n; i += 4) { \
+            __m256d x = _mm256_loadu_pd(a + i); \
+            __m256d y = _mm256_loadu_pd(b + i); \
+            _mm256_storeu_pd(out + i, (expr)); \
+        } \
+        name##Scalar(a + i, b + i, out + i, n - i); \
+    }
+
+// Ordered compares are false for NaN, like the scalar operators
+#define AVX2_COMPARE(pred) _mm256_and_pd(_mm256_cmp_pd(x, y, pred), _mm256_set1_pd(1.0))
+
+AVX2_KERNEL(add, _mm256_add_pd(x, y))
+AVX2_KERNEL(subtract, _mm256_sub_pd(x, y))
+AVX2_KERNEL(multiply, _mm256_mul_pd(x, y))
+AVX2_KERNEL(divide, _mm256_div_pd(x, y))
+AVX2_KERNEL(less, AVX2_COMPARE(_CMP_LT_OQ))
+AVX2_KERNEL(lessEqual, AVX2_COMPARE(_CMP_LE_OQ))
+AVX2_KERNEL(greater, AVX2_COMPARE(_CMP_GT_OQ))
+AVX2_KERNEL(greaterEqual, AVX2_COMPARE(_CMP_GE_OQ))
+
+ARRAY_TARGET_AVX2 static bool anyZeroAvx2(const double* p, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d hits = zero;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) hits = _mm256_or_pd(hits, _mm256_cmp_pd(_mm256_loadu_pd(p + i), zero, _CMP_EQ_OQ));
+    return _mm256_movemask_pd(hits) != 0 || anyZeroScalar(p + i, n - i);
+}
+#endif
+
+// =================== Dispatch ===================
+
+// fmod has no vector instruction, so modulo is scalar in every set
+struct ArrayKernels {
+    Kernel add, subtract, multiply, divide, modulo, less, lessEqual, greater, greaterEqual;
+    bool (*anyZero)(const double*, size_t);
+};
+
+static ArrayKernels selectKernels() {
+#if ARRAY_AVX2
+    __builtin_cpu_init();
+    if (!std::getenv("SATAN_ARRAY_KERNEL") && __builtin_cpu_supports("avx2")) {
+        return {addAvx2, subtractAvx2, multiplyAvx2, divideAvx2, moduloScalar,
+                lessAvx2, lessEqualAvx2, greaterAvx2, greaterEqualAvx2, anyZeroAvx2};
+    }
+#endif
+    return {addScalar, subtractScalar, multiplyScalar, divideScalar, moduloScalar,
+            lessScalar, lessEqualScalar, greaterScalar, greaterEqualScalar, anyZeroScalar};
+}
+
+static const ArrayKernels KERNELS = selectKernels();
+
+static Kernel kernelFor(TokenType op) {
+    switch (op) {
+        case TokenType::PLUS: return KERNELS.add;
+        case TokenType::MINUS: return KERNELS.subtract;
+        case TokenType::STAR: return KERNELS.multiply;
+        case TokenType::SLASH: return KERNELS.divide;
+        case TokenType::PERCENT: return KERNELS.modulo;
+        case TokenType::LESS: return KERNELS.less;
+        case TokenType::LESS_EQUAL: return KERNELS.lessEqual;
+        case TokenType::GREATER: return KERNELS.greater;
+        default: return KERNELS.greaterEqual;
+    }
+}
+
+// =================== Evaluation ===================
+
+// binaryOp owns the wording of the zero divisor errors
+[[noreturn]] static void zeroDivisor(TokenType op) {
+    binaryOp(op, SatanValue(1.0), SatanValue(0.0));
+    throw std::runtime_error("Division by zero.");
+}
+
+// One operator at a time, exactly as the unfused expression would run
+static SatanValue evaluateStepwise(const FusedPlan& plan, const SatanValue* operands) {
+    std::vector<SatanValue> stack;
+    stack.reserve(plan.operands);
+    for (const FusedStep& step : plan.steps) {
+        if (step.operand) {
+            stack.push_back(*operands++);
+            continue;
+        }
+        SatanValue r = std::move(stack.back());
+        stack.pop_back();
+        stack.back() = binaryOp(step.op, stack.back(), r);
+    }
+    return std::move(stack.back());
+}
+
+// Comparisons only end a chain, so nothing reads their result as a number
+SatanValue evaluateNumbers(const FusedPlan& plan, const double* operands) {
+    double stack[MAX_FUSED_OPERANDS];
+    size_t top = 0;
+    for (const FusedStep& step : plan.steps) {
+        if (step.operand) {
+            stack[top++] = *operands++;
+            continue;
+        }
+        double r = stack[--top];
+        double& l = stack[top - 1];
+        switch (step.op) {
+            case TokenType::PLUS: l += r; break;
+            case TokenType::MINUS: l -= r; break;
+            case TokenType::STAR: l *= r; break;
+            case TokenType::SLASH: if (r == 0) zeroDivisor(step.op); l /= r; break;
+            case TokenType::PERCENT: if (r == 0) zeroDivisor(step.op); l = std::fmod(l, r); break;
+            default: return binaryOp(step.op, SatanValue(l), SatanValue(r));
+        }
+    }
+    return SatanValue(stack[0]);
+}
+
+namespace {
+
+// Where a kernel reads its input for the current block: a whole array
+// (offset by the block start), or a block buffer holding a broadcast
+// number or an earlier operator's result
+struct Source {
+    const double* data;
+    bool advances;
+    const double* at(size_t start) const { return advances ? data + start : data; }
+};
+
+// A value on the planning stack: a number known for every element, or a source
+struct Pending {
+    bool constant;
+    double number;
+    Source source;
+};
+
+struct Instruction {
+    Kernel kernel;
+    TokenType op;
+    Source a, b;
+    double* out;
+};
+
+// Numbers of an unpacked array, or throws if some element is not a number
+std::vector<double> numbersOf(SatanArray& arr) {
+    std::vector<double> numbers;
+    numbers.reserve(arr.size());
+    for (const SatanValue& v : arr.values()) {
+        if (!v.isNumber()) throw std::runtime_error("Element-wise arithmetic needs arrays of numbers.");
+        numbers.push_back(v.number);
+    }
+    return numbers;
+}
+
+}
+
+// The fused path: operands are arrays of one length and numbers
+static SatanValue evaluateArrays(const FusedPlan& plan, const SatanValue* operands) {
+    std::vector<std::vector<double>> unpacked;
+    unpacked.reserve(plan.operands);
+    size_t length = 0;
+    bool sized = false;
+    for (uint32_t i = 0; i < plan.operands; i++) {
+        SatanArray* arr = operands[i].array();
+        if (!arr) continue;
+        if (!sized) {
+            length = arr->size();
+            sized = true;
+        } else if (arr->size() != length) {
+            throw std::runtime_error("Array lengths differ: " + std::to_string(length) + " and " +
+                                     std::to_string(arr->size()) + ".");
+        }
+        // The kernels read a range's elements from memory, so it is materialized
+        if (arr->isRange()) arr->packedNumbers();
+        if (!arr->isPacked()) unpacked.push_back(numbersOf(*arr));
+    }
+
+    // Lay the chain out as kernel calls. Operators on two numbers are
+    // computed here once; the result of the operator that leaves a value at
+    // stack depth d goes to block buffer d.
+    size_t block = std::max<size_t>(1, std::min(BLOCK, length));
+    std::vector<double> results(plan.operands * block);
+    std::vector<std::vector<double>> broadcasts;
+    broadcasts.reserve(plan.operands);
+    auto materialize = [&](const Pending& p) {
+        if (!p.constant) return p.source;
+        broadcasts.emplace_back(block, p.number);
+        return Source{broadcasts.back().data(), false};
+    };
+
+    std::vector<Instruction> program;
+    std::vector<Pending> stack;
+    size_t nextUnpacked = 0;
+    for (const FusedStep& step : plan.steps) {
+        if (step.operand) {
+            const SatanValue& v = *operands++;
+            if (v.isNumber()) stack.push_back({true, v.number, {}});
+            else if (v.array()->isPacked()) stack.push_back({false, 0, {v.array()->packedNumbers().data(), true}});
+            else stack.push_back({false, 0, {unpacked[nextUnpacked++].data(), true}});
+            continue;
+        }
+        Pending r = stack.back();
+        stack.pop_back();
+        Pending& l = stack.back();
+        if (l.constant && r.constant) {
+            l.number = binaryOp(step.op, SatanValue(l.number), SatanValue(r.number)).number;
+            continue;
+        }
+        if (divides(step.op) && r.constant && r.number == 0) zeroDivisor(step.op);
+        double* out = results.data() + (stack.size() - 1) * block;
+        program.push_back({kernelFor(step.op), step.op, materialize(l), materialize(r), out});
+        l = {false, 0, {out, false}};
+    }
+
+    std::vector<double> result;
+    result.reserve(length);
+    for (size_t start = 0; start < length; start += block) {
+        size_t n = std::min(block, length - start);
+        for (const Instruction& ins : program) {
+            const double* b = ins.b.at(start);
+            if (divides(ins.op) && ins.b.advances && KERNELS.anyZero(b, n)) zeroDivisor(ins.op);
+            ins.kernel(ins.a.at(start), b, ins.out, n);
+        }
+        const double* last = stack.back().source.at(start);
+        result.insert(result.end(), last, last + n);
+    }
+
+    if (!isComparison(plan.steps.back().op)) return SatanValue::makeArray(std::move(result));
+    std::vector<SatanValue> flags;
+    flags.reserve(length);
+    for (double f : result) flags.emplace_back(f != 0);
+    return SatanValue::makeArray(std::move(flags));
+}
+
+SatanValue evaluateFused(const FusedPlan& plan, const SatanValue* operands) {
+    double numbers[MAX_FUSED_OPERANDS];
+    bool arrays = false;
+    for (uint32_t i = 0; i < plan.operands; i++) {
+        if (operands[i].isNumber()) numbers[i] = operands[i].number;
+        else if (operands[i].isArray()) arrays = true;
+        else return evaluateStepwise(plan, operands);
+    }
+    return arrays ? evaluateArrays(plan, operands) : evaluateNumbers(plan, numbers);
+}
+
+SatanValue elementwise(TokenType op, const SatanValue& l, const SatanValue& r) {
+    FusedPlan plan{{{true, op}, {true, op}, {false, op}}, 2};
+    SatanValue operands[2] = {l, r};
+    return evaluateArrays(plan, operands);
+}
@@ -0,0 +1,27 @@
+#include "../include/ast_arena.h"
+#include <algorithm>
+#include <cstdint>
+
+AstArena::~AstArena() {
+    for (auto it = cleanups.rbegin(); it != cleanups.rend(); ++it) it->destroy(it->node);
+}
+
+void* AstArena::allocate(size_t size, size_t align) {
+    auto aligned = [&](std::byte* p) {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+        return reinterpret_cast<std::byte*>((addr + align - 1) & ~(uintptr_t)(align - 1));
+    };
+    std::byte* p = cursor ? aligned(cursor) : nullptr;
+    if (!p || p + size > limit) {
+        // Chunks double up to MAX_CHUNK so small units stay small
+        size_t chunkSize = std::max(nextChunk, size + align);
+        nextChunk = std::min(nextChunk * 2, MAX_CHUNK);
+        chunks.emplace_back(new std::byte[chunkSize]);   // left uninitialised
+        cursor = chunks.back().get();
+        limit = cursor + chunkSize;
+        p = aligned(cursor);
+    }
+    cursor = p + size;
+    used += size;
+    return p;
+}
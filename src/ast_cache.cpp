@@ -0,0 +1,585 @@
+#include "../include/ast_cache.h"
+#include "../include/mapped_file.h"
+#include "../include/setup.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char MAGIC[8] = {'S', 'A', 'T', 'A', 'N', 'A', 'S', 'T'};
+
+// Hashes text a word at a time. With the length, the hash of the source
+// decides whether an entry still matches its script, and the hash of the
+// entry's body whether it was written out intact.
+uint64_t hashBytes(std::string_view text) {
+    const uint64_t mul = 0x9fb21c651e98df25ULL;
+    uint64_t h = text.size() * 0x9e3779b97f4a7c15ULL;
+    size_t i = 0;
+    for (; i + 8 <= text.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, text.data() + i, 8);
+        h = (h ^ word) * mul;
+        h ^= h >> 47;
+    }
+    if (i < text.size()) {
+        uint64_t word = 0;
+        std::memcpy(&word, text.data() + i, text.size() - i);
+        h = (h ^ word) * mul;
+        h ^= h >> 47;
+    }
+    return h ^ (h >> 29);
+}
+
+template <typename T>
+void appendFixed(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+// LEB128: seven bits per byte, high bit set on all but the last
+void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+// A truncated or malformed entry; the script is parsed instead
+struct CorruptEntry {};
+
+class AstReader {
+public:
+    AstReader(std::string_view data, AstArena& arena)
+        : p(data.data()), end(data.data() + data.size()), arena(arena) {}
+
+    // Reads the header and string table; false if the entry is for another
+    // version or another source text, or its body is truncated or altered
+    bool header(uint64_t sourceSize, uint64_t sourceHash) {
+        need(sizeof MAGIC);
+        if (std::memcmp(p, MAGIC, sizeof MAGIC) != 0) return false;
+        p += sizeof MAGIC;
+        if (fixed<uint32_t>() != AST_CACHE_FORMAT) return false;
+        if (bytes(count()) != SATAN_VERSION) return false;
+        if (fixed<uint64_t>() != sourceSize) return false;
+        if (fixed<uint64_t>() != sourceHash) return false;
+        uint64_t bodySize = fixed<uint64_t>();
+        uint64_t bodyHash = fixed<uint64_t>();
+        if (static_cast<uint64_t>(end - p) != bodySize) return false;
+        if (hashBytes(std::string_view(p, bodySize)) != bodyHash) return false;
+        size_t n = count();
+        for (size_t i = 0; i < n; i++) strings.push_back(bytes(count()));
+        symbols.assign(n, NO_SYMBOL);
+        return true;
+    }
+
+    std::vector<Stmt*> statements() { return stmts(); }
+    bool atEnd() const { return p == end; }
+
+private:
+    const char* p;
+    const char* end;
+    AstArena& arena;
+    std::vector<std::string_view> strings;   // views into the mapped entry
+    std::vector<Symbol> symbols;             // interned on first use as an identifier
+    int lastLine = 0;
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) { return arena.make<T>(std::forward<Args>(args)...); }
+
+    void need(size_t n) {
+        if (static_cast<size_t>(end - p) < n) throw CorruptEntry{};
+    }
+
+    uint8_t byte() {
+        need(1);
+        return static_cast<uint8_t>(*p++);
+    }
+
+    template <typename T>
+    T fixed() {
+        T value;
+        need(sizeof value);
+        std::memcpy(&value, p, sizeof value);
+        p += sizeof value;
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return value;
+        }
+        throw CorruptEntry{};
+    }
+
+    // A length or item count. Every item takes at least a byte, which
+    // rejects sizes no intact entry could have before anything is allocated.
+    size_t count() {
+        uint64_t n = varint();
+        if (n > static_cast<uint64_t>(end - p)) throw CorruptEntry{};
+        return static_cast<size_t>(n);
+    }
+
+    std::string_view bytes(size_t n) {
+        need(n);
+        std::string_view s(p, n);
+        p += n;
+        return s;
+    }
+
+    size_t stringIndex() {
+        uint64_t i = varint();
+        if (i >= strings.size()) throw CorruptEntry{};
+        return static_cast<size_t>(i);
+    }
+
+    std::string_view text() { return strings[stringIndex()]; }
+
+    TokenType op() {
+        uint8_t type = byte();
+        if (type > static_cast<uint8_t>(TokenType::ERROR)) throw CorruptEntry{};
+        return static_cast<TokenType>(type);
+    }
+
+    Token token() {
+        uint8_t type = byte();
+        if (type > static_cast<uint8_t>(TokenType::ERROR)) throw CorruptEntry{};
+        lastLine += static_cast<int>(unzigzag(varint()));
+        size_t i = stringIndex();
+        Token t(static_cast<TokenType>(type), strings[i], lastLine);
+        if (t.type == TokenType::NUMBER) {
+            uint64_t n = varint();
+            if (n == 1) t.number = fixed<double>();
+            else t.number = static_cast<double>(n >> 1);
+        } else if (t.type == TokenType::IDENTIFIER) {
+            if (symbols[i] == NO_SYMBOL) symbols[i] = intern(strings[i]);
+            t.symbol = symbols[i];
+        }
+        return t;
+    }
+
+    std::vector<Expr*> exprs() {
+        std::vector<Expr*> list(count());
+        for (auto& e : list) e = expr();
+        return list;
+    }
+
+    std::vector<Stmt*> stmts() {
+        std::vector<Stmt*> list(count());
+        for (auto& s : list) s = stmt();
+        return list;
+    }
+
+    BlockStmt* block() {
+        if (static_cast<AstTag>(byte()) != AstTag::BLOCK) throw CorruptEntry{};
+        return make<BlockStmt>(stmts());
+    }
+
+    // Fields are read into locals first: argument evaluation order is unspecified
+    Expr* expr() {
+        switch (static_cast<AstTag>(byte())) {
+            case AstTag::NONE: return nullptr;
+            case AstTag::LITERAL: return make<LiteralExpr>(token());
+            case AstTag::VARIABLE: return make<VariableExpr>(token());
+            case AstTag::BINARY: {
+                Expr* left = expr();
+                Token op = token();
+                return make<BinaryExpr>(left, op, expr());
+            }
+            case AstTag::LOGICAL: {
+                Expr* left = expr();
+                Token op = token();
+                return make<LogicalExpr>(left, op, expr());
+            }
+            case AstTag::CALL: {
+                Expr* callee = expr();
+                return make<CallExpr>(callee, exprs());
+            }
+            case AstTag::UNARY: {
+                Token op = token();
+                return make<UnaryExpr>(op, expr());
+            }
+            case AstTag::ARRAY: return make<ArrayExpr>(exprs());
+            case AstTag::MEMBER_ACCESS: {
+                Expr* object = expr();
+                return make<MemberAccessExpr>(object, token());
+            }
+            case AstTag::METHOD_CALL: {
+                Expr* object = expr();
+                Token method = token();
+                return make<MethodCallExpr>(object, method, exprs());
+            }
+            case AstTag::INDEX: {
+                Expr* object = expr();
+                Expr* index = expr();
+                return make<IndexExpr>(object, index);
+            }
+            case AstTag::ASSIGN: {
+                Token name = token();
+                Expr* value = expr();
+                return make<AssignExpr>(name, value, op());
+            }
+            case AstTag::INDEX_ASSIGN: {
+                Expr* object = expr();
+                Expr* index = expr();
+                Expr* value = expr();
+                return make<IndexAssignExpr>(object, index, value, op());
+            }
+            case AstTag::MEMBER_ASSIGN: {
+                Expr* object = expr();
+                Token member = token();
+                Expr* value = expr();
+                return make<MemberAssignExpr>(object, member, value, op());
+            }
+            case AstTag::NAMED_ARG: {
+                Token name = token();
+                return make<NamedArgExpr>(name, expr());
+            }
+            case AstTag::DICT: {
+                std::vector<std::pair<Expr*, Expr*>> entries(count());
+                for (auto& entry : entries) {
+                    entry.first = expr();
+                    entry.second = expr();
+                }
+                return make<DictExpr>(std::move(entries));
+            }
+            default: throw CorruptEntry{};
+        }
+    }
+
+    Stmt* stmt() {
+        switch (static_cast<AstTag>(byte())) {
+            case AstTag::NONE: return nullptr;
+            case AstTag::VAR_DECL: {
+                Token name = token();
+                return make<VarDecl>(name, expr());
+            }
+            case AstTag::ASSEMBLE: return make<AssembleStmt>(expr());
+            case AstTag::PRINT: return make<PrintStmt>(expr());
+            case AstTag::EXPR_STMT: return make<ExprStmt>(expr());
+            case AstTag::SUMMON: return make<SummonStmt>(expr());
+            case AstTag::IF: {
+                Expr* condition = expr();
+                Stmt* thenBranch = stmt();
+                Stmt* elseBranch = stmt();
+                return make<IfStmt>(condition, thenBranch, elseBranch);
+            }
+            case AstTag::BLOCK: return make<BlockStmt>(stmts());
+            case AstTag::FUN_DECL: {
+                Token name = token();
+                std::vector<Token> params;
+                for (size_t n = count(); n > 0; n--) params.push_back(token());
+                BlockStmt* body = block();
+                return make<FunDecl>(name, std::move(params), body, &arena);
+            }
+            case AstTag::RETURN: {
+                Token keyword = token();
+                return make<ReturnStmt>(keyword, expr());
+            }
+            case AstTag::WHILE: {
+                Expr* condition = expr();
+                return make<WhileStmt>(condition, stmt());
+            }
+            case AstTag::FOR: {
+                Stmt* initializer = stmt();
+                Expr* condition = expr();
+                Expr* increment = expr();
+                return make<ForStmt>(initializer, condition, increment, stmt());
+            }
+            case AstTag::BREAK: return make<BreakStmt>();
+            case AstTag::CONTINUE: return make<ContinueStmt>();
+            case AstTag::TRY_CATCH: {
+                Stmt* tryBlock = stmt();
+                Stmt* catchBlock = stmt();
+                Token catchVar = token();
+                bool hasCatchVar = byte() != 0;
+                return make<TryCatchStmt>(tryBlock, catchBlock, catchVar, hasCatchVar);
+            }
+            case AstTag::IMPORT: return make<ImportStmt>(std::string(text()));
+            case AstTag::FOR_IN: {
+                Token varName = token();
+                Expr* iterable = expr();
+                return make<ForInStmt>(varName, iterable, stmt());
+            }
+            case AstTag::ASSERT: {
+                Expr* condition = expr();
+                return make<AssertStmt>(condition, std::string(text()));
+            }
+            case AstTag::TEST: {
+                std::string name(text());
+                return make<TestStmt>(std::move(name), stmt());
+            }
+            default: throw CorruptEntry{};
+        }
+    }
+};
+
+fs::path cacheEntryPath(const std::string& path) {
+    fs::path source(path);
+    return source.parent_path() / "__satancache__" / (source.filename().string() + ".satanc");
+}
+
+std::optional<Program> readEntry(const fs::path& entry, uint64_t sourceSize, uint64_t sourceHash) {
+    // Loaded tokens view into the mapping, so it is kept for the rest of the program
+    static std::vector<std::unique_ptr<const MappedFile>> retained;
+
+    std::error_code ec;
+    if (!fs::is_regular_file(entry, ec)) return std::nullopt;
+    std::unique_ptr<const MappedFile> file;
+    try {
+        file = std::make_unique<const MappedFile>(entry.string(), "cache entry");
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+    Program program{std::make_shared<AstArena>(), {}};
+    try {
+        AstReader reader(file->view(), *program.arena);
+        if (!reader.header(sourceSize, sourceHash)) return std::nullopt;
+        program.statements = reader.statements();
+        if (!reader.atEnd()) return std::nullopt;
+    } catch (const CorruptEntry&) {
+        return std::nullopt;
+    }
+    retained.push_back(std::move(file));
+    return program;
+}
+
+// Best effort: a read-only directory or a full disk just means no caching
+void writeEntry(const fs::path& entry, const Program& program, uint64_t sourceSize, uint64_t sourceHash) {
+    AstWriter writer;
+    writer.stmts(program.statements);
+    std::string data = writer.finish(sourceSize, sourceHash);
+
+    std::error_code ec;
+    fs::create_directories(entry.parent_path(), ec);
+    if (ec) return;
+    // Written under a private name and renamed into place, so concurrent
+    // runs never see half an entry
+    fs::path temp = entry;
+    temp += "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            out.close();
+            fs::remove(temp, ec);
+            return;
+        }
+    }
+    fs::rename(temp, entry, ec);
+    if (ec) fs::remove(temp, ec);
+}
+
+Program parseSource(std::string_view source) {
+    Lexer lexer = Lexer::fromRetained(source);
+    Parser parser(lexer);
+    return parser.parse();
+}
+
+}
+
+bool cacheDisabled() {
+    const char* value = std::getenv("SATAN_NO_CACHE");
+    return value && *value && std::string_view(value) != "0";
+}
+
+std::optional<Program> loadProgram(const std::string& path) {
+    std::string_view source;
+    try {
+        source = loadSource(path);
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+    if (cacheDisabled()) return parseSource(source);
+
+    uint64_t hash = hashBytes(source);
+    fs::path entry = cacheEntryPath(path);
+    if (auto cached = readEntry(entry, source.size(), hash)) return cached;
+    Program program = parseSource(source);
+    writeEntry(entry, program, source.size(), hash);
+    return program;
+}
+
+// =================== AstWriter ===================
+
+void AstWriter::expr(const Expr* e) {
+    if (e) e->write(*this);
+    else tag(AstTag::NONE);
+}
+
+void AstWriter::stmt(const Stmt* s) {
+    if (s) s->write(*this);
+    else tag(AstTag::NONE);
+}
+
+void AstWriter::exprs(const std::vector<Expr*>& list) {
+    count(list.size());
+    for (const Expr* e : list) expr(e);
+}
+
+void AstWriter::stmts(const std::vector<Stmt*>& list) {
+    count(list.size());
+    for (const Stmt* s : list) stmt(s);
+}
+
+void AstWriter::token(const Token& t) {
+    tree.push_back(static_cast<char>(t.type));
+    appendVarint(tree, zigzag(static_cast<int64_t>(t.line) - lastLine));
+    lastLine = t.line;
+    if (t.type == TokenType::IDENTIFIER) {
+        if (t.symbol >= identifierIds.size()) identifierIds.resize(t.symbol + 1, UINT32_MAX);
+        uint32_t& id = identifierIds[t.symbol];
+        if (id == UINT32_MAX) id = addString(t.lexeme);
+        count(id);
+    } else {
+        text(t.lexeme);
+    }
+    if (t.type == TokenType::NUMBER) {
+        // Small non-negative integers, the usual literal, are a varint (even);
+        // anything else is a 1 followed by the raw double
+        double v = t.number;
+        if (v >= 0 && v < 9007199254740992.0 && v == std::floor(v) && !std::signbit(v)) {
+            appendVarint(tree, static_cast<uint64_t>(v) << 1);
+        } else {
+            tree.push_back(1);
+            appendFixed(tree, v);
+        }
+    }
+}
+
+void AstWriter::text(std::string_view s) {
+    auto [it, added] = stringIds.try_emplace(s, 0);
+    if (added) it->second = addString(s);
+    count(it->second);
+}
+
+uint32_t AstWriter::addString(std::string_view s) {
+    strings.push_back(s);
+    return static_cast<uint32_t>(strings.size() - 1);
+}
+
+void AstWriter::count(size_t n) { appendVarint(tree, n); }
+
+std::string AstWriter::finish(uint64_t sourceSize, uint64_t sourceHash) const {
+    std::string out(MAGIC, sizeof MAGIC);
+    appendFixed(out, AST_CACHE_FORMAT);
+    std::string_view version = SATAN_VERSION;
+    appendVarint(out, version.size());
+    out += version;
+    appendFixed(out, sourceSize);
+    appendFixed(out, sourceHash);
+    std::string body;
+    appendVarint(body, strings.size());
+    for (std::string_view s : strings) {
+        appendVarint(body, s.size());
+        body += s;
+    }
+    body += tree;
+    appendFixed(out, static_cast<uint64_t>(body.size()));
+    appendFixed(out, hashBytes(body));
+    return out + body;
+}
+
+// =================== Node serialization ===================
+
+void LiteralExpr::write(AstWriter& out) const { out.tag(AstTag::LITERAL); out.token(value); }
+void VariableExpr::write(AstWriter& out) const { out.tag(AstTag::VARIABLE); out.token(name); }
+
+void BinaryExpr::write(AstWriter& out) const {
+    out.tag(AstTag::BINARY); out.expr(left); out.token(op); out.expr(right);
+}
+
+void CallExpr::write(AstWriter& out) const {
+    out.tag(AstTag::CALL); out.expr(callee); out.exprs(arguments);
+}
+
+void LogicalExpr::write(AstWriter& out) const {
+    out.tag(AstTag::LOGICAL); out.expr(left); out.token(op); out.expr(right);
+}
+
+void UnaryExpr::write(AstWriter& out) const { out.tag(AstTag::UNARY); out.token(op); out.expr(right); }
+void ArrayExpr::write(AstWriter& out) const { out.tag(AstTag::ARRAY); out.exprs(elements); }
+
+void MemberAccessExpr::write(AstWriter& out) const {
+    out.tag(AstTag::MEMBER_ACCESS); out.expr(object); out.token(member);
+}
+
+void MethodCallExpr::write(AstWriter& out) const {
+    out.tag(AstTag::METHOD_CALL); out.expr(object); out.token(method); out.exprs(arguments);
+}
+
+void IndexExpr::write(AstWriter& out) const { out.tag(AstTag::INDEX); out.expr(object); out.expr(index); }
+void AssignExpr::write(AstWriter& out) const { out.tag(AstTag::ASSIGN); out.token(name); out.expr(value); out.op(op); }
+
+void IndexAssignExpr::write(AstWriter& out) const {
+    out.tag(AstTag::INDEX_ASSIGN); out.expr(object); out.expr(index); out.expr(value); out.op(op);
+}
+
+void MemberAssignExpr::write(AstWriter& out) const {
+    out.tag(AstTag::MEMBER_ASSIGN); out.expr(object); out.token(member); out.expr(value); out.op(op);
+}
+void NamedArgExpr::write(AstWriter& out) const { out.tag(AstTag::NAMED_ARG); out.token(name); out.expr(value); }
+
+void DictExpr::write(AstWriter& out) const {
+    out.tag(AstTag::DICT);
+    out.count(entries.size());
+    for (const auto& [key, value] : entries) {
+        out.expr(key);
+        out.expr(value);
+    }
+}
+
+void VarDecl::write(AstWriter& out) const { out.tag(AstTag::VAR_DECL); out.token(name); out.expr(initializer); }
+void AssembleStmt::write(AstWriter& out) const { out.tag(AstTag::ASSEMBLE); out.expr(expr); }
+void PrintStmt::write(AstWriter& out) const { out.tag(AstTag::PRINT); out.expr(expr); }
+
+void IfStmt::write(AstWriter& out) const {
+    out.tag(AstTag::IF); out.expr(condition); out.stmt(thenBranch); out.stmt(elseBranch);
+}
+
+void BlockStmt::write(AstWriter& out) const { out.tag(AstTag::BLOCK); out.stmts(statements); }
+void ExprStmt::write(AstWriter& out) const { out.tag(AstTag::EXPR_STMT); out.expr(expr); }
+void SummonStmt::write(AstWriter& out) const { out.tag(AstTag::SUMMON); out.expr(message); }
+
+void FunDecl::write(AstWriter& out) const {
+    out.tag(AstTag::FUN_DECL);
+    out.token(name);
+    out.count(params.size());
+    for (const Token& param : params) out.token(param);
+    out.stmt(body);
+}
+
+void ReturnStmt::write(AstWriter& out) const { out.tag(AstTag::RETURN); out.token(keyword); out.expr(value); }
+void WhileStmt::write(AstWriter& out) const { out.tag(AstTag::WHILE); out.expr(condition); out.stmt(body); }
+
+void ForStmt::write(AstWriter& out) const {
+    out.tag(AstTag::FOR); out.stmt(initializer); out.expr(condition); out.expr(increment); out.stmt(body);
+}
+
+void BreakStmt::write(AstWriter& out) const { out.tag(AstTag::BREAK); }
+void ContinueStmt::write(AstWriter& out) const { out.tag(AstTag::CONTINUE); }
+
+void TryCatchStmt::write(AstWriter& out) const {
+    out.tag(AstTag::TRY_CATCH); out.stmt(tryBlock); out.stmt(catchBlock); out.token(catchVar); out.flag(hasCatchVar);
+}
+
+void ImportStmt::write(AstWriter& out) const { out.tag(AstTag::IMPORT); out.text(filepath); }
+
+void ForInStmt::write(AstWriter& out) const {
+    out.tag(AstTag::FOR_IN); out.token(varName); out.expr(iterable); out.stmt(body);
+}
+
+void AssertStmt::write(AstWriter& out) const { out.tag(AstTag::ASSERT); out.expr(condition); out.text(message); }
+void TestStmt::write(AstWriter& out) const { out.tag(AstTag::TEST); out.text(name); out.stmt(body); }
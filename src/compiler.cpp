@@ -0,0 +1,571 @@
+#include "../include/compiler.h"
+#include <stdexcept>
+
+Compiler::Compiler(GlobalTable& globals) : globals(globals) {}
+
+std::shared_ptr<FunctionProto> Compiler::compileScript(const std::vector<Stmt*>& statements) {
+    FunctionState script{nullptr, std::make_shared<FunctionProto>(), true};
+    script.proto->name = "<script>";
+    state = &script;
+    for (const auto& stmt : statements) stmt->compile(*this);
+    emit(OpCode::NIL);
+    emit(OpCode::RETURN);
+    state = nullptr;
+    return script.proto;
+}
+
+// =================== Emission ===================
+
+void Compiler::emit(OpCode op) {
+    state->proto->code.push_back(static_cast<uint32_t>(op));
+}
+
+void Compiler::emit(OpCode op, uint32_t a) {
+    auto& code = state->proto->code;
+    code.push_back(static_cast<uint32_t>(op));
+    code.push_back(a);
+}
+
+void Compiler::emit(OpCode op, uint32_t a, uint32_t b) {
+    auto& code = state->proto->code;
+    code.push_back(static_cast<uint32_t>(op));
+    code.push_back(a);
+    code.push_back(b);
+}
+
+void Compiler::emit(OpCode op, uint32_t a, uint32_t b, uint32_t c) {
+    auto& code = state->proto->code;
+    code.push_back(static_cast<uint32_t>(op));
+    code.push_back(a);
+    code.push_back(b);
+    code.push_back(c);
+}
+
+size_t Compiler::emitJump(OpCode op) {
+    emit(op, 0);
+    return position() - 1;
+}
+
+void Compiler::patchJump(size_t operand) { patchJump(operand, position()); }
+
+void Compiler::patchJump(size_t operand, size_t target) {
+    state->proto->code[operand] = static_cast<uint32_t>(target);
+}
+
+size_t Compiler::position() const { return state->proto->code.size(); }
+
+uint32_t Compiler::addConstant(SatanValue value) {
+    auto& constants = state->proto->constants;
+    constants.push_back(std::move(value));
+    return static_cast<uint32_t>(constants.size() - 1);
+}
+
+uint32_t Compiler::addMethodCache() {
+    auto& caches = state->proto->methodCaches;
+    caches.emplace_back();
+    return static_cast<uint32_t>(caches.size() - 1);
+}
+
+uint32_t Compiler::addFusedSite(const FusedChain& chain) {
+    FusedSite site{chain.plan, {}};
+    for (const Expr* operand : chain.operands) {
+        if (auto* literal = dynamic_cast<const LiteralExpr*>(operand)) {
+            site.operands.push_back({FusedOperand::VALUE, 0, literal->constant});
+        } else {
+            site.operands.push_back(variableOperand(static_cast<const VariableExpr*>(operand)->name.symbol));
+        }
+    }
+    auto& sites = state->proto->fusedSites;
+    sites.push_back(std::move(site));
+    return static_cast<uint32_t>(sites.size() - 1);
+}
+
+uint32_t Compiler::addName(std::string_view name) {
+    auto& names = state->proto->names;
+    for (size_t i = 0; i < names.size(); i++)
+        if (names[i] == name) return static_cast<uint32_t>(i);
+    names.emplace_back(name);
+    return static_cast<uint32_t>(names.size() - 1);
+}
+
+// =================== Scopes and variables ===================
+
+bool Compiler::isGlobalScope() const {
+    return state->isScript && state->scopeDepth == 0;
+}
+
+void Compiler::beginScope() { state->scopeDepth++; }
+
+void Compiler::endScope() {
+    auto& locals = state->locals;
+    bool captured = false;
+    uint32_t firstSlot = state->nextSlot;
+    while (!locals.empty() && locals.back().depth == state->scopeDepth) {
+        captured = captured || locals.back().captured;
+        firstSlot = locals.back().slot;
+        locals.pop_back();
+    }
+    if (captured) emit(OpCode::CLOSE_UPVALUES, firstSlot);
+    state->nextSlot = firstSlot;
+    state->scopeDepth--;
+}
+
+uint32_t Compiler::declareLocal(Symbol name) {
+    // Redeclaring a name in the same scope reuses its slot, like Environment::define
+    if (name != NO_SYMBOL) {
+        for (auto it = state->locals.rbegin(); it != state->locals.rend() && it->depth == state->scopeDepth; ++it)
+            if (it->name == name) return it->slot;
+    }
+    uint32_t slot = state->nextSlot++;
+    state->locals.push_back({name, state->scopeDepth, slot, false});
+    if (state->nextSlot > state->proto->numSlots) state->proto->numSlots = state->nextSlot;
+    return slot;
+}
+
+uint32_t Compiler::reserveSlot() { return declareLocal(NO_SYMBOL); }
+
+void Compiler::defineVariable(Symbol name) {
+    if (isGlobalScope()) emit(OpCode::DEFINE_GLOBAL, globals.intern(name));
+    else emit(OpCode::DEFINE_LOCAL, declareLocal(name));
+}
+
+int Compiler::resolveLocal(FunctionState* fs, Symbol name) {
+    for (auto it = fs->locals.rbegin(); it != fs->locals.rend(); ++it)
+        if (it->name == name) return static_cast<int>(it - fs->locals.rbegin());
+    return -1;
+}
+
+uint32_t Compiler::addUpvalue(FunctionState* fs, bool isLocal, uint32_t index) {
+    auto& upvalues = fs->proto->upvalues;
+    for (size_t i = 0; i < upvalues.size(); i++)
+        if (upvalues[i].isLocal == isLocal && upvalues[i].index == index) return static_cast<uint32_t>(i);
+    upvalues.push_back({isLocal, index});
+    return static_cast<uint32_t>(upvalues.size() - 1);
+}
+
+int Compiler::resolveUpvalue(FunctionState* fs, Symbol name) {
+    if (!fs->enclosing) return -1;
+    FunctionState* outer = fs->enclosing;
+    int local = resolveLocal(outer, name);
+    if (local >= 0) {
+        Local& l = outer->locals[outer->locals.size() - 1 - local];
+        l.captured = true;
+        return static_cast<int>(addUpvalue(fs, true, l.slot));
+    }
+    int up = resolveUpvalue(outer, name);
+    if (up >= 0) return static_cast<int>(addUpvalue(fs, false, static_cast<uint32_t>(up)));
+    return -1;
+}
+
+void Compiler::loadVariable(Symbol name) {
+    int local = resolveLocal(state, name);
+    if (local >= 0) {
+        emit(OpCode::GET_LOCAL, state->locals[state->locals.size() - 1 - local].slot);
+        return;
+    }
+    int up = resolveUpvalue(state, name);
+    if (up >= 0) emit(OpCode::GET_UPVALUE, static_cast<uint32_t>(up));
+    else emit(OpCode::GET_GLOBAL, globals.intern(name));
+}
+
+FusedOperand Compiler::variableOperand(Symbol name) {
+    int local = resolveLocal(state, name);
+    if (local >= 0) return {FusedOperand::LOCAL, state->locals[state->locals.size() - 1 - local].slot, {}};
+    int up = resolveUpvalue(state, name);
+    if (up >= 0) return {FusedOperand::UPVALUE, static_cast<uint32_t>(up), {}};
+    return {FusedOperand::GLOBAL, globals.intern(name), {}};
+}
+
+void Compiler::storeVariable(Symbol name) {
+    int local = resolveLocal(state, name);
+    if (local >= 0) {
+        emit(OpCode::SET_LOCAL, state->locals[state->locals.size() - 1 - local].slot);
+        return;
+    }
+    int up = resolveUpvalue(state, name);
+    if (up >= 0) emit(OpCode::SET_UPVALUE, static_cast<uint32_t>(up));
+    else emit(OpCode::SET_GLOBAL, globals.intern(name));
+}
+
+void Compiler::updateVariable(Symbol name, TokenType op) {
+    uint32_t binary = static_cast<uint32_t>(op);
+    int local = resolveLocal(state, name);
+    if (local >= 0) {
+        emit(OpCode::UPDATE_LOCAL, state->locals[state->locals.size() - 1 - local].slot, binary);
+        return;
+    }
+    int up = resolveUpvalue(state, name);
+    if (up >= 0) emit(OpCode::UPDATE_UPVALUE, static_cast<uint32_t>(up), binary);
+    else emit(OpCode::UPDATE_GLOBAL, globals.intern(name), binary);
+}
+
+void Compiler::compileFunction(const FunDecl& decl) {
+    // A local function is declared before its body so it can call itself
+    bool global = isGlobalScope();
+    uint32_t slot = global ? 0 : declareLocal(decl.name.symbol);
+
+    FunctionState fn{state, std::make_shared<FunctionProto>(), false};
+    fn.proto->name = decl.name.lexeme;
+    fn.proto->arity = static_cast<uint32_t>(decl.params.size());
+    state = &fn;
+    beginScope();
+    for (const auto& param : decl.params) declareLocal(param.symbol);
+    decl.body->compile(*this);
+    emit(OpCode::NIL);
+    emit(OpCode::RETURN);
+    state = fn.enclosing;
+
+    state->proto->functions.push_back(fn.proto);
+    emit(OpCode::CLOSURE, static_cast<uint32_t>(state->proto->functions.size() - 1));
+    if (global) emit(OpCode::DEFINE_GLOBAL, globals.intern(decl.name.symbol));
+    else emit(OpCode::DEFINE_LOCAL, slot);
+}
+
+// =================== Loops and control flow ===================
+
+void Compiler::beginLoop() {
+    state->loops.push_back({state->nextSlot, state->tryDepth, false, 0, {}, {}});
+}
+
+void Compiler::setContinueTarget(size_t target) {
+    Loop& loop = state->loops.back();
+    loop.continueKnown = true;
+    loop.continueTarget = target;
+}
+
+void Compiler::endLoop(size_t continueTarget) {
+    Loop& loop = state->loops.back();
+    for (size_t jump : loop.continueJumps) patchJump(jump, continueTarget);
+    for (size_t jump : loop.breakJumps) patchJump(jump);
+    state->loops.pop_back();
+}
+
+void Compiler::leaveLoopScopes(const Loop& loop) {
+    for (int i = loop.tryDepth; i < state->tryDepth; i++) emit(OpCode::TRY_END);
+    if (state->nextSlot > loop.bodySlot) emit(OpCode::CLOSE_UPVALUES, loop.bodySlot);
+}
+
+void Compiler::emitBreak() {
+    if (state->loops.empty()) {
+        emit(OpCode::FAIL, addName("'break' used outside of a loop"));
+        return;
+    }
+    leaveLoopScopes(state->loops.back());
+    state->loops.back().breakJumps.push_back(emitJump(OpCode::JUMP));
+}
+
+void Compiler::emitContinue() {
+    if (state->loops.empty()) {
+        emit(OpCode::FAIL, addName("'continue' used outside of a loop"));
+        return;
+    }
+    Loop& loop = state->loops.back();
+    leaveLoopScopes(loop);
+    if (loop.continueKnown) emit(OpCode::JUMP, static_cast<uint32_t>(loop.continueTarget));
+    else loop.continueJumps.push_back(emitJump(OpCode::JUMP));
+}
+
+void Compiler::emitReturn(bool hasValue) {
+    if (state->isScript) {
+        if (hasValue) emit(OpCode::POP);
+        emit(OpCode::FAIL, addName("'return' used outside of a function"));
+        return;
+    }
+    if (!hasValue) emit(OpCode::NIL);
+    emit(OpCode::RETURN);
+}
+
+size_t Compiler::beginTry() {
+    emit(OpCode::TRY_BEGIN, 0, state->nextSlot);
+    state->tryDepth++;
+    return position() - 2;
+}
+
+void Compiler::endTry() {
+    emit(OpCode::TRY_END);
+    state->tryDepth--;
+}
+
+// =================== Expressions ===================
+
+void LiteralExpr::compile(Compiler& c) const {
+    switch (value.type) {
+        case TokenType::NUMBER:
+        case TokenType::STRING: c.emit(OpCode::CONSTANT, c.addConstant(constant)); break;
+        case TokenType::TRUE: c.emit(OpCode::TRUE); break;
+        case TokenType::FALSE: c.emit(OpCode::FALSE); break;
+        default: c.emit(OpCode::NIL); break;
+    }
+}
+
+void VariableExpr::compile(Compiler& c) const { c.loadVariable(name.symbol); }
+
+void BinaryExpr::compile(Compiler& c) const {
+    // A fusable chain runs as one FUSED instruction, reading its operands
+    // in place; the plain code after it handles operands of other types
+    FusedChain chain;
+    bool fused = fuse(chain);
+    size_t skip = 0;
+    if (fused) {
+        c.emit(OpCode::FUSED, c.addFusedSite(chain), 0);
+        skip = c.position() - 1;
+    }
+    left->compile(c);
+    right->compile(c);
+    switch (op.type) {
+        case TokenType::PLUS: c.emit(OpCode::ADD); break;
+        case TokenType::MINUS: c.emit(OpCode::SUBTRACT); break;
+        case TokenType::STAR: c.emit(OpCode::MULTIPLY); break;
+        case TokenType::SLASH: c.emit(OpCode::DIVIDE); break;
+        case TokenType::PERCENT: c.emit(OpCode::MODULO); break;
+        case TokenType::GREATER: c.emit(OpCode::GREATER); break;
+        case TokenType::GREATER_EQUAL: c.emit(OpCode::GREATER_EQUAL); break;
+        case TokenType::LESS: c.emit(OpCode::LESS); break;
+        case TokenType::LESS_EQUAL: c.emit(OpCode::LESS_EQUAL); break;
+        case TokenType::EQUAL_EQUAL: c.emit(OpCode::EQUAL); break;
+        case TokenType::BANG_EQUAL: c.emit(OpCode::NOT_EQUAL); break;
+        default: throw std::runtime_error("Unknown binary operator: " + std::string(op.lexeme));
+    }
+    if (fused) c.patchJump(skip);
+}
+
+void CallExpr::compile(Compiler& c) const {
+    callee->compile(c);
+    for (const auto& arg : arguments) arg->compile(c);
+    c.emit(OpCode::CALL, static_cast<uint32_t>(arguments.size()));
+}
+
+void LogicalExpr::compile(Compiler& c) const {
+    // Both operators yield a boolean, like LogicalExpr::evaluate
+    bool isOr = op.type == TokenType::OR;
+    left->compile(c);
+    size_t shortCircuit = c.emitJump(isOr ? OpCode::JUMP_IF_TRUE : OpCode::JUMP_IF_FALSE);
+    right->compile(c);
+    c.emit(OpCode::TO_BOOL);
+    size_t end = c.emitJump(OpCode::JUMP);
+    c.patchJump(shortCircuit);
+    c.emit(isOr ? OpCode::TRUE : OpCode::FALSE);
+    c.patchJump(end);
+}
+
+void UnaryExpr::compile(Compiler& c) const {
+    right->compile(c);
+    if (op.type == TokenType::MINUS) c.emit(OpCode::NEGATE);
+    else if (op.type == TokenType::BANG) c.emit(OpCode::NOT);
+}
+
+void ArrayExpr::compile(Compiler& c) const {
+    for (const auto& elem : elements) elem->compile(c);
+    c.emit(OpCode::BUILD_ARRAY, static_cast<uint32_t>(elements.size()));
+}
+
+void MemberAccessExpr::compile(Compiler& c) const {
+    object->compile(c);
+    c.emit(OpCode::GET_MEMBER, member.symbol);
+}
+
+void MethodCallExpr::compile(Compiler& c) const {
+    object->compile(c);
+    for (const auto& arg : arguments) arg->compile(c);
+    c.emit(OpCode::INVOKE, method.symbol, static_cast<uint32_t>(arguments.size()), c.addMethodCache());
+}
+
+void IndexExpr::compile(Compiler& c) const {
+    object->compile(c);
+    index->compile(c);
+    c.emit(OpCode::GET_INDEX);
+}
+
+void AssignExpr::compile(Compiler& c) const {
+    value->compile(c);
+    if (op == TokenType::EQUAL) c.storeVariable(name.symbol);
+    else c.updateVariable(name.symbol, op);
+}
+
+void IndexAssignExpr::compile(Compiler& c) const {
+    object->compile(c);
+    index->compile(c);
+    value->compile(c);
+    c.emit(OpCode::SET_INDEX, static_cast<uint32_t>(op));
+}
+
+void MemberAssignExpr::compile(Compiler& c) const {
+    object->compile(c);
+    value->compile(c);
+    c.emit(OpCode::SET_MEMBER, member.symbol, static_cast<uint32_t>(op));
+}
+
+void NamedArgExpr::compile(Compiler& c) const { value->compile(c); }
+
+void DictExpr::compile(Compiler& c) const {
+    for (const auto& entry : entries) {
+        entry.first->compile(c);
+        entry.second->compile(c);
+    }
+    c.emit(OpCode::BUILD_DICT, static_cast<uint32_t>(entries.size()));
+}
+
+// =================== Statements ===================
+
+void VarDecl::compile(Compiler& c) const {
+    if (initializer) initializer->compile(c);
+    else c.emit(OpCode::NIL);
+    c.defineVariable(name.symbol);
+}
+
+void AssembleStmt::compile(Compiler& c) const {
+    expr->compile(c);
+    c.emit(OpCode::PRINT);
+}
+
+void PrintStmt::compile(Compiler& c) const {
+    expr->compile(c);
+    c.emit(OpCode::PRINT);
+}
+
+void SummonStmt::compile(Compiler& c) const {
+    message->compile(c);
+    c.emit(OpCode::PRINT);
+}
+
+void ExprStmt::compile(Compiler& c) const {
+    expr->compile(c);
+    c.emit(OpCode::POP);
+}
+
+void IfStmt::compile(Compiler& c) const {
+    condition->compile(c);
+    size_t toElse = c.emitJump(OpCode::JUMP_IF_FALSE);
+    thenBranch->compile(c);
+    if (!elseBranch) {
+        c.patchJump(toElse);
+        return;
+    }
+    size_t toEnd = c.emitJump(OpCode::JUMP);
+    c.patchJump(toElse);
+    elseBranch->compile(c);
+    c.patchJump(toEnd);
+}
+
+void BlockStmt::compile(Compiler& c) const {
+    c.beginScope();
+    for (const auto& stmt : statements) stmt->compile(c);
+    c.endScope();
+}
+
+void FunDecl::compile(Compiler& c) const { c.compileFunction(*this); }
+
+void ReturnStmt::compile(Compiler& c) const {
+    if (value) value->compile(c);
+    c.emitReturn(value != nullptr);
+}
+
+void WhileStmt::compile(Compiler& c) const {
+    c.beginScope();
+    uint32_t counter = c.reserveSlot();
+    c.emit(OpCode::CONSTANT, c.addConstant(SatanValue(0.0)));
+    c.emit(OpCode::DEFINE_LOCAL, counter);
+
+    size_t start = c.position();
+    condition->compile(c);
+    size_t exit = c.emitJump(OpCode::JUMP_IF_FALSE);
+    c.emit(OpCode::LOOP_GUARD, counter, c.addName("While loop exceeded maximum iteration limit"));
+    c.beginLoop();
+    c.setContinueTarget(start);
+    body->compile(c);
+    c.emit(OpCode::JUMP, static_cast<uint32_t>(start));
+    c.patchJump(exit);
+    c.endLoop(start);
+    c.endScope();
+}
+
+void ForStmt::compile(Compiler& c) const {
+    // The initializer belongs to the enclosing scope, as in ForStmt::execute
+    if (initializer) initializer->compile(c);
+    c.beginScope();
+    uint32_t counter = c.reserveSlot();
+    c.emit(OpCode::CONSTANT, c.addConstant(SatanValue(0.0)));
+    c.emit(OpCode::DEFINE_LOCAL, counter);
+
+    size_t start = c.position();
+    size_t exit = 0;
+    if (condition) {
+        condition->compile(c);
+        exit = c.emitJump(OpCode::JUMP_IF_FALSE);
+    }
+    c.emit(OpCode::LOOP_GUARD, counter, c.addName("For loop exceeded maximum iteration limit"));
+    c.beginLoop();
+    body->compile(c);
+    size_t next = c.position();
+    if (increment) {
+        increment->compile(c);
+        c.emit(OpCode::POP);
+    }
+    c.emit(OpCode::JUMP, static_cast<uint32_t>(start));
+    if (condition) c.patchJump(exit);
+    c.endLoop(next);
+    c.endScope();
+}
+
+void BreakStmt::compile(Compiler& c) const { c.emitBreak(); }
+void ContinueStmt::compile(Compiler& c) const { c.emitContinue(); }
+
+void TryCatchStmt::compile(Compiler& c) const {
+    size_t handler = c.beginTry();
+    tryBlock->compile(c);
+    c.endTry();
+    size_t end = c.emitJump(OpCode::JUMP);
+
+    // The VM enters here with the error message on the stack
+    c.patchJump(handler);
+    c.beginScope();
+    if (hasCatchVar) c.emit(OpCode::DEFINE_LOCAL, c.declareLocal(catchVar.symbol));
+    else c.emit(OpCode::POP);
+    catchBlock->compile(c);
+    c.endScope();
+    c.patchJump(end);
+}
+
+void ImportStmt::compile(Compiler& c) const {
+    c.emit(OpCode::IMPORT, c.addName(filepath));
+}
+
+void ForInStmt::compile(Compiler& c) const {
+    iterable->compile(c);
+    c.beginScope();
+    uint32_t iter = c.reserveSlot();
+    c.reserveSlot(); // cursor
+    c.emit(OpCode::ITER_PREP, iter);
+
+    // The loop variable gets a fresh scope per iteration, like loopEnv
+    c.beginLoop();
+    size_t start = c.position();
+    c.setContinueTarget(start);
+    c.beginScope();
+    uint32_t var = c.declareLocal(varName.symbol);
+    c.emit(OpCode::ITER_NEXT, iter, var);
+    size_t exit = c.emitJump(OpCode::JUMP);
+    body->compile(c);
+    c.endScope();
+    c.emit(OpCode::JUMP, static_cast<uint32_t>(start));
+    c.patchJump(exit);
+    c.endLoop(start);
+    c.endScope();
+}
+
+void AssertStmt::compile(Compiler& c) const {
+    condition->compile(c);
+    c.emit(OpCode::ASSERT, c.addName(message));
+}
+
+void TestStmt::compile(Compiler& c) const {
+    c.emit(OpCode::TEST_BEGIN, c.addName(name));
+    size_t handler = c.beginTry();
+    body->compile(c);
+    c.endTry();
+    c.emit(OpCode::TEST_PASS);
+    size_t end = c.emitJump(OpCode::JUMP);
+    c.patchJump(handler);
+    c.emit(OpCode::TEST_FAIL);
+    c.patchJump(end);
+}
@@ -0,0 +1,380 @@
+#include "../include/dataframe.h"
+#include "../include/mapped_file.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+constexpr double MISSING = std::numeric_limits<double>::quiet_NaN();
+
+bool isMissingToken(std::string_view f) {
+    return f.empty() || f == "NA" || f == "N/A" || f == "NaN" || f == "nan"
+        || f == "null" || f == "NULL" || f == "None";
+}
+
+std::string_view trimField(std::string_view f) {
+    while (!f.empty() && (f.front() == ' ' || f.front() == '\t')) f.remove_prefix(1);
+    while (!f.empty() && (f.back() == ' ' || f.back() == '\t' || f.back() == '\r')) f.remove_suffix(1);
+    return f;
+}
+
+bool parseNumber(std::string_view f, double& out) {
+    if (!f.empty() && f.front() == '+') f.remove_prefix(1);
+    if (f.empty()) return false;
+    auto res = std::from_chars(f.data(), f.data() + f.size(), out);
+    return res.ec == std::errc() && res.ptr == f.data() + f.size();
+}
+
+bool looksIntegral(std::string_view f) {
+    return f.find_first_of(".eE") == std::string_view::npos;
+}
+
+// Calls fn(columnIndex, field) for every field of the line [p, end).
+// Quoted fields are unescaped into scratch; plain fields are views into the file.
+template <typename Fn>
+void forEachField(const char* p, const char* end, bool quoted, std::string& scratch, Fn&& fn) {
+    size_t col = 0;
+    while (true) {
+        if (quoted && p < end && *p == '"') {
+            scratch.clear();
+            ++p;
+            while (p < end) {
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') { scratch += '"'; p += 2; continue; }
+                    ++p;
+                    break;
+                }
+                scratch += *p++;
+            }
+            while (p < end && *p != ',') ++p;
+            fn(col, std::string_view(scratch));
+        } else {
+            const char* comma = static_cast<const char*>(std::memchr(p, ',', end - p));
+            const char* fieldEnd = comma ? comma : end;
+            fn(col, trimField(std::string_view(p, fieldEnd - p)));
+            p = fieldEnd;
+        }
+        ++col;
+        if (p >= end) break;
+        ++p; // skip ','
+    }
+}
+
+// End of the record starting at p. A newline inside quotes does not end it.
+const char* recordEnd(const char* p, const char* end, bool quoted) {
+    if (!quoted) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        return nl ? nl : end;
+    }
+    bool inQuotes = false;
+    for (; p < end; ++p) {
+        if (*p == '"') inQuotes = !inQuotes;
+        else if (*p == '\n' && !inQuotes) return p;
+    }
+    return end;
+}
+
+bool isBlankRecord(const char* p, const char* e) {
+    for (; p < e; ++p) if (*p != '\r' && *p != ' ' && *p != '\t') return false;
+    return true;
+}
+
+struct ChunkSniff {
+    size_t rows = 0;
+    std::vector<char> numeric;
+    std::vector<char> integral;
+};
+
+template <typename Fn>
+void runParallel(size_t count, Fn&& fn) {
+    if (count == 1) { fn(0); return; }
+    std::vector<std::thread> workers;
+    workers.reserve(count);
+    for (size_t i = 0; i < count; i++) workers.emplace_back([&fn, i] { fn(i); });
+    for (auto& w : workers) w.join();
+}
+
+std::string formatFixed(double v, int decimals) {
+    if (std::isnan(v)) return "NaN";
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    return buf;
+}
+
+// Decimals pandas shows for v: six, minus trailing zeros, but at least one.
+// A column uses the largest count among its cells.
+int decimalsNeeded(double v) {
+    if (std::isnan(v) || std::isinf(v)) return 1;
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.6f", v);
+    std::string s(buf);
+    size_t dot = s.find('.');
+    size_t last = s.find_last_not_of('0');
+    if (dot == std::string::npos || last <= dot) return 1;
+    return static_cast<int>(last - dot);
+}
+
+std::string padLeft(const std::string& s, size_t width) {
+    return s.size() >= width ? s : std::string(width - s.size(), ' ') + s;
+}
+
+std::string renderTable(const std::vector<std::string>& rowLabels,
+                        const std::vector<std::string>& headers,
+                        const std::vector<std::vector<std::string>>& cells) {
+    size_t labelWidth = 0;
+    for (const auto& l : rowLabels) labelWidth = std::max(labelWidth, l.size());
+    std::vector<size_t> widths(headers.size());
+    for (size_t c = 0; c < headers.size(); c++) {
+        widths[c] = headers[c].size();
+        for (const auto& cell : cells[c]) widths[c] = std::max(widths[c], cell.size());
+    }
+    std::string out(labelWidth, ' ');
+    for (size_t c = 0; c < headers.size(); c++) out += "  " + padLeft(headers[c], widths[c]);
+    out += "\n";
+    for (size_t r = 0; r < rowLabels.size(); r++) {
+        std::string line = rowLabels[r] + std::string(labelWidth - rowLabels[r].size(), ' ');
+        for (size_t c = 0; c < headers.size(); c++) line += "  " + padLeft(cells[c][r], widths[c]);
+        out += line + "\n";
+    }
+    return out;
+}
+
+// Linear-interpolated quantile (pandas' default) of an unsorted sample
+double quantile(std::vector<double>& v, double q) {
+    if (v.empty()) return MISSING;
+    double pos = q * static_cast<double>(v.size() - 1);
+    size_t lo = static_cast<size_t>(pos);
+    std::nth_element(v.begin(), v.begin() + lo, v.end());
+    double lower = v[lo];
+    if (lo + 1 >= v.size()) return lower;
+    double upper = *std::min_element(v.begin() + lo + 1, v.end());
+    return lower + (pos - static_cast<double>(lo)) * (upper - lower);
+}
+
+} // namespace
+
+std::shared_ptr<DataFrame> DataFrame::readCSV(const std::string& path) {
+    MappedFile file(path, "CSV file");
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    auto frame = std::make_shared<DataFrame>();
+    if (file.size() == 0) return frame;
+
+    if (file.size() >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0) begin += 3;
+    bool quoted = std::memchr(begin, '"', end - begin) != nullptr;
+
+    // Header
+    std::string scratch;
+    const char* headerEnd = recordEnd(begin, end, quoted);
+    forEachField(begin, headerEnd, quoted, scratch, [&](size_t, std::string_view f) {
+        DataColumn col;
+        col.name = std::string(trimField(f));
+        frame->columns.push_back(std::move(col));
+    });
+    const size_t ncols = frame->columns.size();
+    const char* body = headerEnd < end ? headerEnd + 1 : end;
+
+    // Split the body on record boundaries. A quote anywhere means a newline
+    // may sit inside a field, so such files are parsed as a single chunk.
+    size_t bodySize = static_cast<size_t>(end - body);
+    size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    size_t nchunks = quoted ? 1 : std::max<size_t>(1, std::min(hw, bodySize / MIN_CHUNK_BYTES));
+    std::vector<const char*> bounds(nchunks + 1, end);
+    bounds[0] = body;
+    for (size_t i = 1; i < nchunks; i++) {
+        const char* p = body + bodySize * i / nchunks;
+        p = std::max(p, bounds[i - 1]);
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        bounds[i] = nl ? nl + 1 : end;
+    }
+
+    // Pass 1: count records and sniff column types, one chunk per thread
+    std::vector<ChunkSniff> sniffs(nchunks);
+    runParallel(nchunks, [&](size_t i) {
+        ChunkSniff& s = sniffs[i];
+        s.numeric.assign(ncols, 1);
+        s.integral.assign(ncols, 1);
+        std::string local;
+        for (const char* p = bounds[i]; p < bounds[i + 1];) {
+            const char* e = recordEnd(p, bounds[i + 1], quoted);
+            if (!isBlankRecord(p, e)) {
+                size_t seen = 0;
+                forEachField(p, e, quoted, local, [&](size_t c, std::string_view f) {
+                    if (c >= ncols) return;
+                    seen = c + 1;
+                    if (isMissingToken(f)) { s.integral[c] = 0; return; }
+                    if (!s.numeric[c]) return;
+                    double v;
+                    if (!parseNumber(f, v)) { s.numeric[c] = 0; s.integral[c] = 0; }
+                    else if (!looksIntegral(f)) s.integral[c] = 0;
+                });
+                for (size_t c = seen; c < ncols; c++) s.integral[c] = 0;
+                s.rows++;
+            }
+            p = e + 1;
+        }
+    });
+
+    std::vector<size_t> offsets(nchunks + 1, 0);
+    for (size_t i = 0; i < nchunks; i++) offsets[i + 1] = offsets[i] + sniffs[i].rows;
+    frame->rows = offsets[nchunks];
+    for (size_t c = 0; c < ncols; c++) {
+        DataColumn& col = frame->columns[c];
+        for (const auto& s : sniffs) {
+            col.numeric = col.numeric && s.numeric[c];
+            col.integral = col.integral && s.integral[c];
+        }
+        if (col.numeric) col.values.assign(frame->rows, MISSING);
+        else { col.integral = false; col.text.assign(frame->rows, std::string()); }
+    }
+
+    // Pass 2: parse straight into the final column buffers at each chunk's row offset
+    runParallel(nchunks, [&](size_t i) {
+        size_t row = offsets[i];
+        std::string local;
+        for (const char* p = bounds[i]; p < bounds[i + 1];) {
+            const char* e = recordEnd(p, bounds[i + 1], quoted);
+            if (!isBlankRecord(p, e)) {
+                forEachField(p, e, quoted, local, [&](size_t c, std::string_view f) {
+                    if (c >= ncols || isMissingToken(f)) return;
+                    DataColumn& col = frame->columns[c];
+                    if (col.numeric) parseNumber(f, col.values[row]);
+                    else col.text[row] = std::string(f);
+                });
+                row++;
+            }
+            p = e + 1;
+        }
+    });
+
+    return frame;
+}
+
+size_t DataFrame::memoryBytes() const {
+    size_t bytes = sizeof(DataFrame);
+    for (const DataColumn& col : columns) {
+        bytes += sizeof(DataColumn) + col.name.capacity() + col.values.capacity() * sizeof(double)
+               + col.text.capacity() * sizeof(std::string);
+        for (const std::string& t : col.text) {
+            if (t.capacity() > std::string().capacity()) bytes += t.capacity();
+        }
+    }
+    return bytes;
+}
+
+std::shared_ptr<DataFrame> DataFrameCache::open(const std::string& path) {
+    std::error_code ec;
+    uintmax_t size = fs::file_size(path, ec);
+    if (ec) throw std::runtime_error("Cannot open CSV file: " + path);
+    auto mtime = fs::last_write_time(path, ec);
+    std::string key = fs::weakly_canonical(path, ec).string();
+    if (ec) key = path;
+
+    auto found = byKey.find(key);
+    if (found != byKey.end()) {
+        auto it = found->second;
+        if (it->size == size && it->mtime == mtime) {
+            entries.splice(entries.begin(), entries, it);
+            return it->frame;
+        }
+        evict(it);
+    }
+
+    auto frame = DataFrame::readCSV(path);
+    size_t bytes = frame->memoryBytes();
+    if (bytes > capacity) return frame;
+    while (used + bytes > capacity) evict(std::prev(entries.end()));
+    entries.push_front(Entry{key, size, mtime, frame, bytes});
+    byKey[key] = entries.begin();
+    used += bytes;
+    return frame;
+}
+
+void DataFrameCache::evict(std::list<Entry>::iterator it) {
+    used -= it->bytes;
+    byKey.erase(it->key);
+    entries.erase(it);
+}
+
+std::string DataFrame::formatColumnList() const {
+    std::string out = "[";
+    for (size_t c = 0; c < columns.size(); c++) {
+        if (c > 0) out += ", ";
+        out += "'" + columns[c].name + "'";
+    }
+    return out + "]";
+}
+
+std::string DataFrame::formatHead(size_t n) const {
+    size_t shown = std::min(n, rows);
+    std::vector<std::string> labels, headers;
+    std::vector<std::vector<std::string>> cells;
+    for (size_t r = 0; r < shown; r++) labels.push_back(std::to_string(r));
+    for (const auto& col : columns) {
+        headers.push_back(col.name);
+        std::vector<std::string> out;
+        if (!col.numeric) {
+            for (size_t r = 0; r < shown; r++) out.push_back(col.text[r].empty() ? "NaN" : col.text[r]);
+        } else if (col.integral) {
+            for (size_t r = 0; r < shown; r++) out.push_back(formatFixed(col.values[r], 0));
+        } else {
+            int decimals = 1;
+            for (size_t r = 0; r < shown; r++) decimals = std::max(decimals, decimalsNeeded(col.values[r]));
+            for (size_t r = 0; r < shown; r++) out.push_back(formatFixed(col.values[r], decimals));
+        }
+        cells.push_back(std::move(out));
+    }
+    if (headers.empty()) return "Empty DataFrame\n";
+    return renderTable(labels, headers, cells);
+}
+
+std::string DataFrame::formatDescribe() const {
+    std::vector<std::string> labels = {"count", "mean", "std", "min", "25%", "50%", "75%", "max"};
+    std::vector<std::string> headers;
+    std::vector<std::vector<std::string>> cells;
+    for (const auto& col : columns) {
+        if (!col.numeric) continue;
+        std::vector<double> present;
+        present.reserve(col.values.size());
+        double sum = 0;
+        for (double v : col.values) {
+            if (std::isnan(v)) continue;
+            present.push_back(v);
+            sum += v;
+        }
+        double count = static_cast<double>(present.size());
+        double mean = present.empty() ? MISSING : sum / count;
+        double var = 0;
+        for (double v : present) var += (v - mean) * (v - mean);
+        double sd = present.size() < 2 ? MISSING : std::sqrt(var / (count - 1));
+        double mn = present.empty() ? MISSING : *std::min_element(present.begin(), present.end());
+        double mx = present.empty() ? MISSING : *std::max_element(present.begin(), present.end());
+        double q1 = quantile(present, 0.25);
+        double q2 = quantile(present, 0.50);
+        double q3 = quantile(present, 0.75);
+
+        headers.push_back(col.name);
+        std::vector<std::string> out;
+        int decimals = 1;
+        for (double v : {count, mean, sd, mn, q1, q2, q3, mx}) decimals = std::max(decimals, decimalsNeeded(v));
+        for (double v : {count, mean, sd, mn, q1, q2, q3, mx}) out.push_back(formatFixed(v, decimals));
+        cells.push_back(std::move(out));
+    }
+    if (headers.empty()) return "No numeric columns to describe.\n";
+    return renderTable(labels, headers, cells);
+}
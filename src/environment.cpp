@@ -1,3 +1,123 @@
-// Environment is now header-only (all methods inlined in environment.h)
-// This file is kept for backward compatibility with build systems.
 #include "../include/environment.h"
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// A heap scope, or an array, object or function reachable from one, with
+// the references to it that come from inside the graph being collected
+struct CycleNode {
+    Environment* scope = nullptr;
+    const SatanValue* value = nullptr;
+    long internal = 0;
+    bool live = false;
+
+    const void* identity() const { return scope ? static_cast<const void*>(scope) : value->cell; }
+    long references() const {
+        return scope ? scope->weak_from_this().use_count() : static_cast<long>(value->refCount());
+    }
+};
+
+bool mayReachScope(const SatanValue& v) { return v.isArray() || v.isObject() || v.isFunction(); }
+
+// Calls visit(scope, value) with each node `node` references
+template <typename Visit>
+void forEachEdge(const CycleNode& node, Visit&& visit) {
+    if (node.scope) {
+        node.scope->forEachReference(
+            [&](const SatanValue& v) { visit(nullptr, &v); },
+            [&](Environment* parent) { visit(parent, nullptr); });
+        return;
+    }
+    const SatanValue& v = *node.value;
+    if (v.isFunction()) {
+        if (v.function()->closure.use_count() > 0) visit(v.function()->closure.get(), nullptr);
+    } else if (v.isArray()) {
+        // Packed arrays and ranges hold only numbers
+        if (v.array()->isPacked() || v.array()->isRange()) return;
+        v.array()->forEach([&](const SatanValue& e) { if (mayReachScope(e)) visit(nullptr, &e); });
+    } else {
+        v.object()->forEach([&](const std::string&, const SatanValue& e) { if (mayReachScope(e)) visit(nullptr, &e); });
+    }
+}
+
+struct Suspect {
+    Environment* env;
+    std::weak_ptr<Environment> alive;   // the scope may be freed while queued
+};
+
+// Suspects are collected once this many have queued up
+constexpr size_t SUSPECT_BATCH = 1024;
+
+std::vector<Suspect>& suspects() {
+    static std::vector<Suspect> queue;
+    return queue;
+}
+
+bool collecting = false;   // freeing garbage must not start another batch
+
+}
+
+void Environment::addSuspect(Environment* env) {
+    env->suspected = true;
+    suspects().push_back({env, env->weak_from_this()});
+    if (suspects().size() >= SUSPECT_BATCH && !collecting) collectCycles();
+}
+
+// Trial deletion: a node referenced more often than the graph accounts for
+// is held from outside, and so is everything it reaches. Scopes left
+// unmarked are only reachable from each other; clearing their slots breaks
+// every cycle through them. Only released scopes and scopes whose function
+// lost a holder are suspected, so a cycle that becomes garbage when an array
+// or object holding a closure is dropped is not noticed.
+void Environment::collectCycles() {
+    // Freeing garbage can leave new suspects behind; those are collected too
+    while (!suspects().empty()) {
+        std::vector<CycleNode> nodes;
+        std::unordered_map<const void*, size_t> index;
+        auto key = [](Environment* scope, const SatanValue* value) { return CycleNode{scope, value}.identity(); };
+
+        for (const Suspect& suspect : suspects()) {
+            if (suspect.alive.expired()) continue;
+            suspect.env->suspected = false;
+            if (index.emplace(suspect.env, nodes.size()).second) nodes.push_back({suspect.env});
+        }
+        suspects().clear();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            CycleNode current = nodes[i];
+            forEachEdge(current, [&](Environment* scope, const SatanValue* value) {
+                auto [it, added] = index.emplace(key(scope, value), nodes.size());
+                if (added) nodes.push_back({scope, value});
+                nodes[it->second].internal++;
+            });
+        }
+
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i].references() > nodes[i].internal) pending.push_back(i);
+        }
+        while (!pending.empty()) {
+            CycleNode& node = nodes[pending.back()];
+            pending.pop_back();
+            if (node.live) continue;
+            node.live = true;
+            forEachEdge(node, [&](Environment* scope, const SatanValue* value) {
+                size_t reached = index.at(key(scope, value));
+                if (!nodes[reached].live) pending.push_back(reached);
+            });
+        }
+
+        // Nothing is freed until every garbage scope has been emptied
+        std::vector<SatanValue> dropped;
+        for (CycleNode& node : nodes) {
+            if (node.scope && !node.live) node.scope->moveSlots(dropped);
+        }
+        collecting = true;
+        dropped.clear();
+        collecting = false;
+    }
+}
+
+void suspectClosureScope(const FunctionObject& fn) {
+    Environment::suspect(fn.closure.get());
+}
@@ -1,43 +1,77 @@
 #include "../include/interpreter.h"
 #include "../include/stdlib_ml.h"
+#include "../include/compiler.h"
+#include "../include/resolver.h"
 #include <iostream>
 
 Interpreter* Interpreter::current = nullptr;
 
-Interpreter::Interpreter() : env(), bridge() {
+Interpreter::Interpreter() : env(), bridge(), modules(), vm(env, modules) {
     current = this;
     bridge.initSession();
     registerBuiltins();
 }
 
+// Globals go first, so cycles that only they could reach are collected
+Interpreter::~Interpreter() {
+    env.clear();
+    Environment::collectCycles();
+}
+
 void Interpreter::registerBuiltins() {
     registerMLBuiltins(env, bridge);
 }
 
-void Interpreter::interpret(const std::vector<std::unique_ptr<Stmt>>& statements) {
+bool Interpreter::interpret(Program& program) {
     current = this;
+    if (optimizationLevel > 0) Optimizer(*program.arena).optimize(program.statements);
+    if (!treeWalk) {
+        try {
+            Compiler compiler(vm.getGlobals());
+            vm.runScript(compiler.compileScript(program.statements));
+        } catch (const std::runtime_error& err) {
+            std::cerr << "[runtime error] " << err.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
     try {
-        for (const auto& stmt : statements) {
-            execute(stmt.get());
+        Resolver resolver;
+        resolver.resolve(program.statements);
+        for (const Stmt* stmt : program.statements) {
+            if (!execute(stmt)) return false;
         }
-    } catch (const BreakSignal&) {
-        std::cerr << "[runtime error] 'break' used outside of a loop" << std::endl;
-    } catch (const ContinueSignal&) {
-        std::cerr << "[runtime error] 'continue' used outside of a loop" << std::endl;
     } catch (const std::runtime_error& err) {
         std::cerr << "[runtime error] " << err.what() << std::endl;
+        return false;
     }
+    return true;
 }
 
-void Interpreter::execute(const Stmt* stmt) {
-    if (!stmt) return;
-    stmt->execute(env);
+bool Interpreter::execute(const Stmt* stmt) {
+    if (!stmt) return true;
+    ExecStatus status = stmt->execute(env);
+    switch (status.kind) {
+        case ExecStatus::RETURN:
+            std::cerr << "[runtime error] 'return' used outside of a function" << std::endl;
+            return false;
+        case ExecStatus::BREAK:
+            std::cerr << "[runtime error] 'break' used outside of a loop" << std::endl;
+            return false;
+        case ExecStatus::CONTINUE:
+            std::cerr << "[runtime error] 'continue' used outside of a loop" << std::endl;
+            return false;
+        default:
+            return true;
+    }
 }
 
-void Interpreter::executeBlock(const std::vector<std::unique_ptr<Stmt>>& statements, Environment& newEnv) {
+ExecStatus Interpreter::executeBlock(const std::vector<Stmt*>& statements, Environment& newEnv) {
     for (const auto& stmt : statements) {
-        stmt->execute(newEnv);
+        ExecStatus status = stmt->execute(newEnv);
+        if (!status.isNormal()) return status;
     }
+    return {};
 }
 
 SatanValue Interpreter::evaluate(const Expr* expr) {
@@ -1,52 +1,121 @@
 #include "../include/lexer.h"
+#include "../include/lexer_scan.h"
+#include "../include/mapped_file.h"
 #include <iostream>
-#include <cctype>
-#include <stdexcept>
+#include <charconv>
+#include <memory>
 
-Token::Token(TokenType t, std::string lex, int ln)
-    : type(t), lexeme(std::move(lex)), line(ln) {}
+std::string_view retainSource(std::string source) {
+    static std::vector<std::unique_ptr<const std::string>> buffers;
+    buffers.push_back(std::make_unique<const std::string>(std::move(source)));
+    return *buffers.back();
+}
 
-Lexer::Lexer(std::string src)
-    : source(std::move(src)), start(0), current(0), line(1) {
-    if (source.size() > MAX_SOURCE_SIZE) {
-        throw std::runtime_error("Source input exceeds maximum allowed size of 10 MB");
+std::string_view loadSource(const std::string& path) {
+    static std::vector<std::unique_ptr<const MappedFile>> files;
+    files.push_back(std::make_unique<const MappedFile>(path, "source file"));
+    return files.back()->view();
+}
+
+struct Keyword {
+    std::string_view text;
+    TokenType type = TokenType::IDENTIFIER;
+};
+
+static constexpr Keyword KEYWORD_LIST[] = {
+    {"let", TokenType::LET},
+    {"var", TokenType::VAR},
+    {"func", TokenType::FUNC},
+    {"if", TokenType::IF},
+    {"else", TokenType::ELSE},
+    {"for", TokenType::FOR},
+    {"while", TokenType::WHILE},
+    {"return", TokenType::RETURN},
+    {"true", TokenType::TRUE},
+    {"false", TokenType::FALSE},
+    {"summon", TokenType::SUMMON},
+    {"print", TokenType::PRINT},
+    {"and", TokenType::AND},
+    {"or", TokenType::OR},
+    {"not", TokenType::NOT},
+    {"assemble", TokenType::ASSEMBLE},
+    {"break", TokenType::BREAK},
+    {"continue", TokenType::CONTINUE},
+    {"fun", TokenType::FUN},
+    {"import", TokenType::IMPORT},
+    {"try", TokenType::TRY},
+    {"catch", TokenType::CATCH},
+    {"in", TokenType::IN},
+    {"assert", TokenType::ASSERT},
+    {"test", TokenType::TEST}
+};
+
+// Keywords are recognised with a perfect hash built at compile time: length
+// plus first and last character put every keyword in its own bucket of a
+// 64-entry table, so classifying an identifier is one hash and one compare.
+static constexpr size_t KEYWORD_TABLE_SIZE = 64;
+
+static constexpr size_t keywordHash(std::string_view s) {
+    return (s.size() * 2 + static_cast<unsigned char>(s.front()) * 6 +
+            static_cast<unsigned char>(s.back())) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+struct KeywordTable {
+    Keyword slots[KEYWORD_TABLE_SIZE];
+    bool collision = false;
+};
+
+static constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table{};
+    for (const Keyword& keyword : KEYWORD_LIST) {
+        Keyword& slot = table.slots[keywordHash(keyword.text)];
+        if (!slot.text.empty()) table.collision = true;
+        slot = keyword;
     }
-    keywords = {
-        {"let", TokenType::LET},
-        {"var", TokenType::VAR},
-        {"func", TokenType::FUNC},
-        {"if", TokenType::IF},
-        {"else", TokenType::ELSE},
-        {"for", TokenType::FOR},
-        {"while", TokenType::WHILE},
-        {"return", TokenType::RETURN},
-        {"true", TokenType::TRUE},
-        {"false", TokenType::FALSE},
-        {"summon", TokenType::SUMMON},
-        {"print", TokenType::PRINT},
-        {"and", TokenType::AND},
-        {"or", TokenType::OR},
-        {"not", TokenType::NOT},
-        {"assemble", TokenType::ASSEMBLE},
-        {"break", TokenType::BREAK},
-        {"continue", TokenType::CONTINUE},
-        {"fun", TokenType::FUN},
-        {"import", TokenType::IMPORT},
-        {"try", TokenType::TRY},
-        {"catch", TokenType::CATCH},
-        {"in", TokenType::IN},
-        {"assert", TokenType::ASSERT},
-        {"test", TokenType::TEST}
-    };
+    return table;
+}
+
+static constexpr KeywordTable KEYWORDS = buildKeywordTable();
+static_assert(!KEYWORDS.collision, "keyword hash must put each keyword in its own slot");
+
+static TokenType keywordType(std::string_view text) {
+    const Keyword& keyword = KEYWORDS.slots[keywordHash(text)];
+    return keyword.text == text ? keyword.type : TokenType::IDENTIFIER;
+}
+
+Lexer::Lexer(std::string src)
+    : Lexer(Retained{}, retainSource(std::move(src))) {}
+
+Lexer::Lexer(Retained, std::string_view retained)
+    : source(retained), start(0), current(0), line(1) {}
+
+Lexer Lexer::fromFile(const std::string& path) {
+    return Lexer(Retained{}, loadSource(path));
+}
+
+Lexer Lexer::fromRetained(std::string_view source) {
+    return Lexer(Retained{}, source);
 }
 
 std::vector<Token> Lexer::scanTokens() {
-    while (!isAtEnd()) {
+    std::deque<Token> all;
+    while (!finished) scanInto(all, SIZE_MAX);
+    return std::vector<Token>(all.begin(), all.end());
+}
+
+void Lexer::scanInto(std::deque<Token>& sink, size_t count) {
+    if (finished) return;
+    out = &sink;
+    size_t first = sink.size();
+    while (sink.size() - first < count && !isAtEnd()) {
         start = current;
         scanToken();
     }
-    tokens.emplace_back(TokenType::EOF_TOKEN, "", line);
-    return tokens;
+    if (isAtEnd()) {
+        sink.emplace_back(TokenType::EOF_TOKEN, "", line);
+        finished = true;
+    }
+    out = nullptr;
 }
 
 bool Lexer::isAtEnd() const {
@@ -64,11 +133,11 @@ void Lexer::scanToken() {
         case ']': addToken(TokenType::RIGHT_BRACKET); break;
         case ',': addToken(TokenType::COMMA); break;
         case '.': addToken(TokenType::DOT); break;
-        case '-': addToken(TokenType::MINUS); break;
-        case '+': addToken(TokenType::PLUS); break;
+        case '-': addToken(match('=') ? TokenType::MINUS_EQUAL : TokenType::MINUS); break;
+        case '+': addToken(match('=') ? TokenType::PLUS_EQUAL : TokenType::PLUS); break;
         case ';': addToken(TokenType::SEMICOLON); break;
-        case '*': addToken(TokenType::STAR); break;
-        case '%': addToken(TokenType::PERCENT); break;
+        case '*': addToken(match('=') ? TokenType::STAR_EQUAL : TokenType::STAR); break;
+        case '%': addToken(match('=') ? TokenType::PERCENT_EQUAL : TokenType::PERCENT); break;
         case ':': addToken(TokenType::COLON); break;
         case '!':
             addToken(match('=') ? TokenType::BANG_EQUAL : TokenType::BANG);
@@ -96,27 +165,26 @@ void Lexer::scanToken() {
             break;
         case '/':
             if (match('/')) {
-                while (peek() != '\n' && !isAtEnd()) advance();
+                current = scanFindByte(source.data() + current, source.data() + source.size(), '\n') - source.data();
             } else if (match('*')) {
                 multiLineComment();
             } else {
-                addToken(TokenType::SLASH);
+                addToken(match('=') ? TokenType::SLASH_EQUAL : TokenType::SLASH);
             }
             break;
         case ' ':
         case '\r':
         case '\t':
-            break;
         case '\n':
-            line++;
+            whitespace();
             break;
         case '"':
             string();
             break;
         default:
-            if (isdigit(c)) {
+            if (charIs(c, CHAR_DIGIT)) {
                 number();
-            } else if (isalpha(c) || c == '_') {
+            } else if (charIs(c, CHAR_ALPHA)) {
                 identifier();
             } else {
                 std::cerr << "[Line " << line << "] Unexpected character: " << c << "\n";
@@ -146,55 +214,76 @@ char Lexer::peekNext() const {
 }
 
 void Lexer::addToken(TokenType type) {
-    std::string text = source.substr(start, current - start);
-    tokens.emplace_back(type, text, line);
+    out->emplace_back(type, source.substr(start, current - start), line);
 }
 
-void Lexer::string() {
-    while (peek() != '"' && !isAtEnd()) {
-        if (peek() == '\n') line++;
-        advance();
+// The scans below jump straight to the next interesting byte and count the
+// newlines they passed over in bulk, instead of stepping through advance()
+
+void Lexer::whitespace() {
+    // Most runs are a single separator; only longer ones (indentation, blank
+    // lines) are worth a bulk scan
+    if (!charIs(peek(), CHAR_SPACE)) {
+        if (source[start] == '\n') line++;
+        return;
     }
+    const char* run = source.data() + start;
+    const char* end = scanWhitespaceEnd(source.data() + current, source.data() + source.size());
+    line += static_cast<int>(scanCountByte(run, end, '\n'));
+    current = end - source.data();
+}
+
+void Lexer::string() {
+    const char* body = source.data() + current;
+    const char* quote = scanFindByte(body, source.data() + source.size(), '"');
+    line += static_cast<int>(scanCountByte(body, quote, '\n'));
+    current = quote - source.data();
     if (isAtEnd()) {
         std::cerr << "[Line " << line << "] Unterminated string.\n";
         addToken(TokenType::ERROR);
         return;
     }
     advance();
-    std::string value = source.substr(start + 1, current - start - 2);
-    tokens.emplace_back(TokenType::STRING, value, line);
+    out->emplace_back(TokenType::STRING, source.substr(start + 1, current - start - 2), line);
 }
 
 void Lexer::number() {
-    while (isdigit(peek())) advance();
-    if (peek() == '.' && isdigit(peekNext())) {
+    while (charIs(peek(), CHAR_DIGIT)) advance();
+    if (peek() == '.' && charIs(peekNext(), CHAR_DIGIT)) {
         advance();
-        while (isdigit(peek())) advance();
+        while (charIs(peek(), CHAR_DIGIT)) advance();
     }
-    std::string value = source.substr(start, current - start);
-    tokens.emplace_back(TokenType::NUMBER, value, line);
+    double value = 0;
+    std::from_chars(source.data() + start, source.data() + current, value);
+    out->emplace_back(TokenType::NUMBER, source.substr(start, current - start), line, value);
 }
 
 void Lexer::identifier() {
-    while (isalnum(peek()) || peek() == '_') advance();
-    std::string text = source.substr(start, current - start);
-    auto keyword = keywords.find(text);
-    if (keyword != keywords.end()) {
-        addToken(keyword->second);
-    } else {
-        addToken(TokenType::IDENTIFIER);
-    }
+    current = scanIdentifierEnd(source.data() + current, source.data() + source.size()) - source.data();
+    std::string_view text = source.substr(start, current - start);
+    TokenType type = keywordType(text);
+    Token& token = out->emplace_back(type, text, line);
+    if (type == TokenType::IDENTIFIER) token.symbol = internName(text);
+}
+
+Symbol Lexer::internName(std::string_view name) {
+    size_t slot = (name.size() * 31 + static_cast<unsigned char>(name.front()) * 7
+                   + static_cast<unsigned char>(name.back())) & (NAME_CACHE_SIZE - 1);
+    CachedName& cached = nameCache[slot];
+    if (cached.name != name) cached = {name, intern(name)};
+    return cached.symbol;
 }
 
 void Lexer::multiLineComment() {
-    while (!(peek() == '*' && peekNext() == '/') && !isAtEnd()) {
-        if (peek() == '\n') line++;
-        advance();
-    }
+    const char* body = source.data() + current;
+    const char* end = source.data() + source.size();
+    const char* p = body;
+    while ((p = scanFindByte(p, end, '*')) != end && !(p + 1 < end && p[1] == '/')) p++;
+    line += static_cast<int>(scanCountByte(body, p, '\n'));
+    current = p - source.data();
     if (isAtEnd()) {
         std::cerr << "[Line " << line << "] Unterminated multi-line comment.\n";
         return;
     }
-    advance();
-    advance();
+    current += 2;
 }
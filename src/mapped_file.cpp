@@ -0,0 +1,49 @@
+#include "../include/mapped_file.h"
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+MappedFile::MappedFile(const std::string& path, const std::string& kind) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + kind + ": " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + kind + ": " + path);
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Cannot map " + kind + ": " + path);
+        }
+        madvise(p, length, MADV_SEQUENTIAL);
+        mapped = static_cast<const char*>(p);
+    }
+    ::close(fd);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Cannot open " + kind + ": " + path);
+    std::stringstream buf;
+    buf << file.rdbuf();
+    copy = buf.str();
+    mapped = copy.data();
+    length = copy.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped && length > 0) munmap(const_cast<char*>(mapped), length);
+#endif
+}
@@ -0,0 +1,40 @@
+#include "../include/module_registry.h"
+#include "../include/ast_cache.h"
+#include <filesystem>
+#include <stdexcept>
+
+std::string ModuleRegistry::canonicalPath(const std::string& path) {
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, ec);
+    return ec ? path : canonical.string();
+}
+
+// A module scope and the functions declared in it hold each other
+ModuleRegistry::~ModuleRegistry() {
+    for (auto& [path, module] : modules) {
+        if (module->scope) module->scope->clear();
+    }
+}
+
+ModuleRegistry::Module* ModuleRegistry::find(const std::string& path) {
+    auto seen = byImportPath.find(path);
+    if (seen != byImportPath.end()) return seen->second;
+    // Same file under another spelling, e.g. "./lib.satan" after "lib.satan"
+    auto it = modules.find(canonicalPath(path));
+    if (it == modules.end()) return nullptr;
+    byImportPath.emplace(path, it->second.get());
+    return it->second.get();
+}
+
+ModuleRegistry::Module& ModuleRegistry::load(const std::string& path) {
+    std::optional<Program> program = loadProgram(path);
+    if (!program) throw std::runtime_error("Cannot import '" + path + "': file not found.");
+    auto module = std::make_unique<Module>();
+    module->path = canonicalPath(path);
+    module->program = std::move(*program);
+    if (optimizationLevel > 0) Optimizer(*module->program.arena).optimize(module->program.statements);
+    Module& registered = *module;
+    modules[registered.path] = std::move(module);
+    byImportPath[path] = &registered;
+    return registered;
+}
@@ -0,0 +1,256 @@
+#include "../include/optimizer.h"
+#include "../include/runtime.h"
+#include <stdexcept>
+
+// Longer results are left to be built at runtime rather than copied into the arena
+static constexpr size_t MAX_FOLDED_STRING = 1024;
+
+static const LiteralExpr* asLiteral(const Expr* e) {
+    return dynamic_cast<const LiteralExpr*>(e);
+}
+
+// True if control never reaches the statement after `s`
+static bool alwaysExits(const Stmt* s) {
+    if (dynamic_cast<const ReturnStmt*>(s) || dynamic_cast<const BreakStmt*>(s) ||
+        dynamic_cast<const ContinueStmt*>(s)) return true;
+    if (auto* block = dynamic_cast<const BlockStmt*>(s)) {
+        return !block->statements.empty() && alwaysExits(block->statements.back());
+    }
+    if (auto* branch = dynamic_cast<const IfStmt*>(s)) {
+        return branch->elseBranch && alwaysExits(branch->thenBranch) && alwaysExits(branch->elseBranch);
+    }
+    return false;
+}
+
+Stmt* Optimizer::branch(Stmt* s) {
+    Stmt* result = stmt(s);
+    if (result || !s) return result;
+    return arena.make<BlockStmt>(std::vector<Stmt*>{});
+}
+
+void Optimizer::exprs(std::vector<Expr*>& list) {
+    for (Expr*& e : list) e = expr(e);
+}
+
+void Optimizer::stmts(std::vector<Stmt*>& list) {
+    size_t kept = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+        Stmt* s = stmt(list[i]);
+        if (!s) continue;
+        list[kept++] = s;
+        if (alwaysExits(s)) break;
+    }
+    list.resize(kept);
+}
+
+LiteralExpr* Optimizer::literal(const SatanValue& value, int line) {
+    if (value.isNumber()) {
+        std::string_view text = arena.copyText(value.toString());
+        return arena.make<LiteralExpr>(Token(TokenType::NUMBER, text, line, value.number));
+    }
+    if (value.isString()) {
+        if (value.str().size() > MAX_FOLDED_STRING) return nullptr;
+        return arena.make<LiteralExpr>(Token(TokenType::STRING, arena.copyText(value.str()), line));
+    }
+    if (value.isBoolean()) {
+        return arena.make<LiteralExpr>(value.boolean ? Token(TokenType::TRUE, "true", line)
+                                                     : Token(TokenType::FALSE, "false", line));
+    }
+    return nullptr;
+}
+
+// =================== Expressions ===================
+
+Expr* LiteralExpr::optimize(Optimizer&) { return this; }
+Expr* VariableExpr::optimize(Optimizer&) { return this; }
+
+Expr* BinaryExpr::optimize(Optimizer& opt) {
+    left = opt.expr(left);
+    right = opt.expr(right);
+    const LiteralExpr* l = asLiteral(left);
+    const LiteralExpr* r = asLiteral(right);
+    if (!l || !r) return this;
+    try {
+        if (LiteralExpr* folded = opt.literal(binaryOp(op.type, l->constant, r->constant), op.line)) return folded;
+    } catch (const std::runtime_error&) {
+        // e.g. `1 / 0`: keep it so the error is raised where it always was
+    }
+    return this;
+}
+
+Expr* CallExpr::optimize(Optimizer& opt) {
+    callee = opt.expr(callee);
+    opt.exprs(arguments);
+    return this;
+}
+
+Expr* LogicalExpr::optimize(Optimizer& opt) {
+    left = opt.expr(left);
+    right = opt.expr(right);
+    const LiteralExpr* l = asLiteral(left);
+    if (!l) return this;
+    // `true or x` and `false and x` never look at x
+    bool isOr = op.type == TokenType::OR;
+    if (l->constant.isTruthy() == isOr) return opt.literal(SatanValue(isOr), op.line);
+    if (const LiteralExpr* r = asLiteral(right)) return opt.literal(SatanValue(r->constant.isTruthy()), op.line);
+    return this;
+}
+
+Expr* UnaryExpr::optimize(Optimizer& opt) {
+    right = opt.expr(right);
+    const LiteralExpr* r = asLiteral(right);
+    if (!r) return this;
+    LiteralExpr* folded = nullptr;
+    if (op.type == TokenType::MINUS) folded = opt.literal(SatanValue(-r->constant.asNumber()), op.line);
+    else if (op.type == TokenType::BANG) folded = opt.literal(SatanValue(!r->constant.isTruthy()), op.line);
+    if (folded) return folded;
+    return this;
+}
+
+Expr* ArrayExpr::optimize(Optimizer& opt) {
+    opt.exprs(elements);
+    return this;
+}
+
+Expr* MemberAccessExpr::optimize(Optimizer& opt) {
+    object = opt.expr(object);
+    return this;
+}
+
+Expr* MethodCallExpr::optimize(Optimizer& opt) {
+    object = opt.expr(object);
+    opt.exprs(arguments);
+    return this;
+}
+
+Expr* IndexExpr::optimize(Optimizer& opt) {
+    object = opt.expr(object);
+    index = opt.expr(index);
+    return this;
+}
+
+Expr* AssignExpr::optimize(Optimizer& opt) {
+    value = opt.expr(value);
+    return this;
+}
+
+Expr* IndexAssignExpr::optimize(Optimizer& opt) {
+    object = opt.expr(object);
+    index = opt.expr(index);
+    value = opt.expr(value);
+    return this;
+}
+
+Expr* MemberAssignExpr::optimize(Optimizer& opt) {
+    object = opt.expr(object);
+    value = opt.expr(value);
+    return this;
+}
+
+Expr* NamedArgExpr::optimize(Optimizer& opt) {
+    value = opt.expr(value);
+    return this;
+}
+
+Expr* DictExpr::optimize(Optimizer& opt) {
+    for (auto& [key, value] : entries) {
+        key = opt.expr(key);
+        value = opt.expr(value);
+    }
+    return this;
+}
+
+// =================== Statements ===================
+
+Stmt* VarDecl::optimize(Optimizer& opt) {
+    initializer = opt.expr(initializer);
+    return this;
+}
+
+Stmt* AssembleStmt::optimize(Optimizer& opt) {
+    expr = opt.expr(expr);
+    return this;
+}
+
+Stmt* PrintStmt::optimize(Optimizer& opt) {
+    expr = opt.expr(expr);
+    return this;
+}
+
+Stmt* IfStmt::optimize(Optimizer& opt) {
+    condition = opt.expr(condition);
+    if (const LiteralExpr* c = asLiteral(condition)) {
+        return opt.stmt(c->constant.isTruthy() ? thenBranch : elseBranch);
+    }
+    thenBranch = opt.branch(thenBranch);
+    elseBranch = opt.stmt(elseBranch);
+    return this;
+}
+
+Stmt* BlockStmt::optimize(Optimizer& opt) {
+    opt.stmts(statements);
+    return this;
+}
+
+Stmt* ExprStmt::optimize(Optimizer& opt) {
+    expr = opt.expr(expr);
+    return asLiteral(expr) ? nullptr : this;
+}
+
+Stmt* SummonStmt::optimize(Optimizer& opt) {
+    message = opt.expr(message);
+    return this;
+}
+
+Stmt* FunDecl::optimize(Optimizer& opt) {
+    opt.stmts(body->statements);
+    return this;
+}
+
+Stmt* ReturnStmt::optimize(Optimizer& opt) {
+    value = opt.expr(value);
+    return this;
+}
+
+Stmt* WhileStmt::optimize(Optimizer& opt) {
+    condition = opt.expr(condition);
+    if (const LiteralExpr* c = asLiteral(condition); c && !c->constant.isTruthy()) return nullptr;
+    body = opt.branch(body);
+    return this;
+}
+
+Stmt* ForStmt::optimize(Optimizer& opt) {
+    // The initializer runs even if the condition is false, so the loop stays
+    initializer = opt.stmt(initializer);
+    condition = opt.expr(condition);
+    increment = opt.expr(increment);
+    body = opt.branch(body);
+    return this;
+}
+
+Stmt* BreakStmt::optimize(Optimizer&) { return this; }
+Stmt* ContinueStmt::optimize(Optimizer&) { return this; }
+
+Stmt* TryCatchStmt::optimize(Optimizer& opt) {
+    tryBlock = opt.branch(tryBlock);
+    catchBlock = opt.branch(catchBlock);
+    return this;
+}
+
+Stmt* ImportStmt::optimize(Optimizer&) { return this; }
+
+Stmt* ForInStmt::optimize(Optimizer& opt) {
+    iterable = opt.expr(iterable);
+    body = opt.branch(body);
+    return this;
+}
+
+Stmt* AssertStmt::optimize(Optimizer& opt) {
+    condition = opt.expr(condition);
+    return this;
+}
+
+Stmt* TestStmt::optimize(Optimizer& opt) {
+    body = opt.branch(body);
+    return this;
+}
@@ -1,43 +1,64 @@
 #include "../include/parser.h"
 #include "../include/interpreter.h"
-#include "../include/stdlib_ml.h"
+#include "../include/runtime.h"
+#include "../include/resolver.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <cstdlib>
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
 
-static constexpr int MAX_LOOP_ITERATIONS = 1000000;
+Parser::Parser(const std::vector<Token>& tokens)
+    : tokens(tokens.begin(), tokens.end()), current(0) {}
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens), current(0) {}
+Parser::Parser(Lexer& lexer) : lexer(&lexer), current(0) {}
 
-std::vector<std::unique_ptr<Stmt>> Parser::parse() {
-    std::vector<std::unique_ptr<Stmt>> statements;
+Program Parser::beginUnit() {
+    arena = std::make_shared<AstArena>();
+    return {arena, {}};
+}
+
+Program Parser::parse() {
+    Program program = beginUnit();
+    while (Stmt* decl = nextDeclaration()) program.statements.push_back(decl);
+    return program;
+}
+
+Program Parser::parseNext() {
+    Program program = beginUnit();
+    if (Stmt* decl = nextDeclaration()) program.statements.push_back(decl);
+    return program;
+}
+
+Stmt* Parser::nextDeclaration() {
     while (!isAtEnd()) {
-        auto decl = declaration();
-        if (decl) statements.push_back(std::move(decl));
+        // Keep the previous token; everything before it is no longer needed
+        if (current > 1) {
+            tokens.erase(tokens.begin(), tokens.begin() + (current - 1));
+            current = 1;
+        }
+        if (Stmt* decl = declaration()) return decl;
     }
-    return statements;
+    return nullptr;
 }
 
-std::unique_ptr<Stmt> Parser::declaration() {
+Stmt* Parser::declaration() {
     if (match({TokenType::VAR, TokenType::LET})) return varDeclaration();
     if (match({TokenType::FUNC, TokenType::FUN})) return funDeclaration();
     return statement();
 }
 
-std::unique_ptr<Stmt> Parser::varDeclaration() {
+Stmt* Parser::varDeclaration() {
     Token name = consume(TokenType::IDENTIFIER, "Expected variable name.");
-    std::unique_ptr<Expr> initializer;
+    Expr* initializer = nullptr;
     if (match({TokenType::EQUAL})) {
         initializer = expression();
     }
     consume(TokenType::SEMICOLON, "Expected ';' after variable declaration.");
-    return std::make_unique<VarDecl>(name, std::move(initializer));
+    return node<VarDecl>(name, initializer);
 }
 
-std::unique_ptr<Stmt> Parser::funDeclaration() {
+Stmt* Parser::funDeclaration() {
     Token name = consume(TokenType::IDENTIFIER, "Expected function name.");
     consume(TokenType::LEFT_PAREN, "Expected '(' after function name.");
     std::vector<Token> parameters;
@@ -48,18 +69,12 @@ std::unique_ptr<Stmt> Parser::funDeclaration() {
     }
     consume(TokenType::RIGHT_PAREN, "Expected ')' after parameters.");
     consume(TokenType::LEFT_BRACE, "Expected '{' before function body.");
-    auto rawBlock = parseBlock().release();
-    auto* blockPtr = dynamic_cast<BlockStmt*>(rawBlock);
-    if (!blockPtr) {
-        delete rawBlock;
-        throw std::runtime_error("Parser error: Expected block statement in function body.");
-    }
-    auto body = std::shared_ptr<BlockStmt>(blockPtr);
-    return std::make_unique<FunDecl>(name, std::move(parameters), std::move(body));
+    BlockStmt* body = parseBlock();
+    return node<FunDecl>(name, std::move(parameters), body, arena.get());
 }
 
 // =================== Statements ===================
-std::unique_ptr<Stmt> Parser::statement() {
+Stmt* Parser::statement() {
     if (match({TokenType::PRINT})) return printStatement();
     if (match({TokenType::ASSEMBLE})) return assembleStatement();
     if (match({TokenType::SUMMON})) return summonStatement();
@@ -77,33 +92,33 @@ std::unique_ptr<Stmt> Parser::statement() {
     return expressionStatement();
 }
 
-std::unique_ptr<Stmt> Parser::expressionStatement() {
+Stmt* Parser::expressionStatement() {
     auto expr = expression();
     consume(TokenType::SEMICOLON, "Expect ';' after expression.");
-    return std::make_unique<ExprStmt>(std::move(expr));
+    return node<ExprStmt>(expr);
 }
 
-std::unique_ptr<Stmt> Parser::ifStatement() {
+Stmt* Parser::ifStatement() {
     consume(TokenType::LEFT_PAREN, "Expect '(' after 'if'.");
     auto condition = expression();
     consume(TokenType::RIGHT_PAREN, "Expect ')' after condition.");
-    std::unique_ptr<Stmt> thenBranch = statement();
-    std::unique_ptr<Stmt> elseBranch = nullptr;
+    Stmt* thenBranch = statement();
+    Stmt* elseBranch = nullptr;
     if (match({TokenType::ELSE})) elseBranch = statement();
-    return std::make_unique<IfStmt>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
+    return node<IfStmt>(condition, thenBranch, elseBranch);
 }
 
-std::unique_ptr<Stmt> Parser::whileStatement() {
+Stmt* Parser::whileStatement() {
     consume(TokenType::LEFT_PAREN, "Expect '(' after 'while'.");
     auto condition = expression();
     consume(TokenType::RIGHT_PAREN, "Expect ')' after condition.");
     auto body = statement();
-    return std::make_unique<WhileStmt>(std::move(condition), std::move(body));
+    return node<WhileStmt>(condition, body);
 }
 
-std::unique_ptr<Stmt> Parser::forStatement() {
+Stmt* Parser::forStatement() {
     consume(TokenType::LEFT_PAREN, "Expect '(' after 'for'.");
-    std::unique_ptr<Stmt> initializer;
+    Stmt* initializer = nullptr;
     if (match({TokenType::SEMICOLON})) {
         initializer = nullptr;
     } else if (match({TokenType::VAR})) {
@@ -111,156 +126,192 @@ std::unique_ptr<Stmt> Parser::forStatement() {
     } else {
         initializer = expressionStatement();
     }
-    std::unique_ptr<Expr> condition = nullptr;
+    Expr* condition = nullptr;
     if (!check(TokenType::SEMICOLON)) condition = expression();
     consume(TokenType::SEMICOLON, "Expect ';' after loop condition.");
-    std::unique_ptr<Expr> increment = nullptr;
+    Expr* increment = nullptr;
     if (!check(TokenType::RIGHT_PAREN)) increment = expression();
     consume(TokenType::RIGHT_PAREN, "Expect ')' after for clauses.");
     auto body = statement();
-    return std::make_unique<ForStmt>(std::move(initializer), std::move(condition), std::move(increment), std::move(body));
+    return node<ForStmt>(initializer, condition, increment, body);
 }
 
-std::unique_ptr<Stmt> Parser::breakStatement() {
+Stmt* Parser::breakStatement() {
     consume(TokenType::SEMICOLON, "Expect ';' after 'break'.");
-    return std::make_unique<BreakStmt>();
+    return node<BreakStmt>();
 }
 
-std::unique_ptr<Stmt> Parser::continueStatement() {
+Stmt* Parser::continueStatement() {
     consume(TokenType::SEMICOLON, "Expect ';' after 'continue'.");
-    return std::make_unique<ContinueStmt>();
+    return node<ContinueStmt>();
 }
 
-std::unique_ptr<Stmt> Parser::parseBlock() {
-    std::vector<std::unique_ptr<Stmt>> statements;
+BlockStmt* Parser::parseBlock() {
+    std::vector<Stmt*> statements;
     while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
         statements.push_back(declaration());
     }
     consume(TokenType::RIGHT_BRACE, "Expect '}' after block.");
-    return std::make_unique<BlockStmt>(std::move(statements));
+    return node<BlockStmt>(std::move(statements));
 }
 
-std::unique_ptr<Stmt> Parser::assembleStatement() {
-    std::unique_ptr<Expr> value = expression();
+Stmt* Parser::assembleStatement() {
+    Expr* value = expression();
     consume(TokenType::SEMICOLON, "Expected ';' after assemble expression.");
-    return std::make_unique<AssembleStmt>(std::move(value));
+    return node<AssembleStmt>(value);
 }
 
-std::unique_ptr<Stmt> Parser::printStatement() {
-    std::unique_ptr<Expr> value = expression();
+Stmt* Parser::printStatement() {
+    Expr* value = expression();
     consume(TokenType::SEMICOLON, "Expected ';' after value.");
-    return std::make_unique<PrintStmt>(std::move(value));
+    return node<PrintStmt>(value);
 }
 
-std::unique_ptr<Stmt> Parser::returnStatement() {
-    Token keyword = tokens[current - 1];
-    std::unique_ptr<Expr> value = nullptr;
+Stmt* Parser::returnStatement() {
+    Token keyword = tokenAt(current - 1);
+    Expr* value = nullptr;
     if (!check(TokenType::SEMICOLON)) value = expression();
     consume(TokenType::SEMICOLON, "Expect ';' after return value.");
-    return std::make_unique<ReturnStmt>(keyword, std::move(value));
+    return node<ReturnStmt>(keyword, value);
 }
 
-std::unique_ptr<Stmt> Parser::summonStatement() {
+Stmt* Parser::summonStatement() {
     auto expr = expression();
     consume(TokenType::SEMICOLON, "Expected ';' after summon expression.");
-    return std::make_unique<SummonStmt>(std::move(expr));
+    return node<SummonStmt>(expr);
 }
 
 // =================== Expressions ===================
-std::unique_ptr<Expr> Parser::expression() {
+// Binding power of each infix operator, looked up by token type instead of
+// descending one grammar rule per level. Operators on one level associate to
+// the left; unary operators and calls bind tighter than all of them.
+enum Precedence : uint8_t {
+    PREC_NONE,         // not an infix operator
+    PREC_LOGICAL,      // and or
+    PREC_EQUALITY,     // == !=
+    PREC_COMPARISON,   // < <= > >=
+    PREC_TERM,         // + -
+    PREC_FACTOR,       // * / %
+};
+
+struct InfixRule {
+    uint8_t precedence = PREC_NONE;
+    bool logical = false;          // builds a LogicalExpr rather than a BinaryExpr
+};
+
+struct InfixTable {
+    InfixRule rules[static_cast<size_t>(TokenType::ERROR) + 1] = {};
+    constexpr InfixTable() {
+        set(TokenType::AND, PREC_LOGICAL, true);
+        set(TokenType::OR, PREC_LOGICAL, true);
+        set(TokenType::BANG_EQUAL, PREC_EQUALITY);
+        set(TokenType::EQUAL_EQUAL, PREC_EQUALITY);
+        set(TokenType::GREATER, PREC_COMPARISON);
+        set(TokenType::GREATER_EQUAL, PREC_COMPARISON);
+        set(TokenType::LESS, PREC_COMPARISON);
+        set(TokenType::LESS_EQUAL, PREC_COMPARISON);
+        set(TokenType::PLUS, PREC_TERM);
+        set(TokenType::MINUS, PREC_TERM);
+        set(TokenType::STAR, PREC_FACTOR);
+        set(TokenType::SLASH, PREC_FACTOR);
+        set(TokenType::PERCENT, PREC_FACTOR);
+    }
+    constexpr void set(TokenType type, uint8_t precedence, bool logical = false) {
+        rules[static_cast<size_t>(type)] = {precedence, logical};
+    }
+    constexpr const InfixRule& operator[](TokenType type) const { return rules[static_cast<size_t>(type)]; }
+};
+
+static constexpr InfixTable INFIX_RULES{};
+
+Expr* Parser::expression() {
     DepthGuard guard(depth);
     return assignment();
 }
 
-std::unique_ptr<Expr> Parser::assignment() {
-    auto expr = logical();
-    if (match({TokenType::EQUAL})) {
-        auto value = assignment();
-        auto* varExpr = dynamic_cast<VariableExpr*>(expr.get());
-        if (varExpr) {
-            return std::make_unique<AssignExpr>(varExpr->name, std::move(value));
-        }
-        throw std::runtime_error("Invalid assignment target.");
+// The operator a compound assignment applies (PLUS for +=); EQUAL for plain
+// `=` and ERROR for any token that doesn't assign
+static TokenType assignmentOperator(TokenType type) {
+    switch (type) {
+        case TokenType::EQUAL: return TokenType::EQUAL;
+        case TokenType::PLUS_EQUAL: return TokenType::PLUS;
+        case TokenType::MINUS_EQUAL: return TokenType::MINUS;
+        case TokenType::STAR_EQUAL: return TokenType::STAR;
+        case TokenType::SLASH_EQUAL: return TokenType::SLASH;
+        case TokenType::PERCENT_EQUAL: return TokenType::PERCENT;
+        default: return TokenType::ERROR;
     }
-    return expr;
 }
 
-std::unique_ptr<Expr> Parser::logical() {
-    auto expr = equality();
-    while (match({TokenType::AND, TokenType::OR})) {
-        Token op = tokens[current - 1];
-        auto right = equality();
-        expr = std::make_unique<LogicalExpr>(std::move(expr), op, std::move(right));
+static const char* assignmentText(TokenType op) {
+    switch (op) {
+        case TokenType::PLUS: return "+=";
+        case TokenType::MINUS: return "-=";
+        case TokenType::STAR: return "*=";
+        case TokenType::SLASH: return "/=";
+        case TokenType::PERCENT: return "%=";
+        default: return "=";
     }
-    return expr;
 }
 
-std::unique_ptr<Expr> Parser::equality() {
-    auto expr = comparison();
-    while (match({TokenType::BANG_EQUAL, TokenType::EQUAL_EQUAL})) {
-        Token op = tokens[current - 1];
-        auto right = comparison();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+Expr* Parser::assignment() {
+    auto expr = binary(PREC_LOGICAL);
+    TokenType op = assignmentOperator(peek().type);
+    if (op == TokenType::ERROR) return expr;
+    advance();
+    auto value = assignment();
+    if (auto* varExpr = dynamic_cast<VariableExpr*>(expr)) {
+        return node<AssignExpr>(varExpr->name, value, op);
     }
-    return expr;
-}
-
-std::unique_ptr<Expr> Parser::comparison() {
-    auto expr = term();
-    while (match({TokenType::GREATER, TokenType::GREATER_EQUAL, TokenType::LESS, TokenType::LESS_EQUAL})) {
-        Token op = tokens[current - 1];
-        auto right = term();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+    if (auto* indexExpr = dynamic_cast<IndexExpr*>(expr)) {
+        return node<IndexAssignExpr>(indexExpr->object, indexExpr->index, value, op);
     }
-    return expr;
-}
-
-std::unique_ptr<Expr> Parser::term() {
-    auto expr = factor();
-    while (match({TokenType::PLUS, TokenType::MINUS})) {
-        Token op = tokens[current - 1];
-        auto right = factor();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+    if (auto* memberExpr = dynamic_cast<MemberAccessExpr*>(expr)) {
+        return node<MemberAssignExpr>(memberExpr->object, memberExpr->member, value, op);
     }
-    return expr;
+    throw std::runtime_error("Invalid assignment target.");
 }
 
-std::unique_ptr<Expr> Parser::factor() {
-    auto expr = unary();
-    while (match({TokenType::STAR, TokenType::SLASH, TokenType::PERCENT})) {
-        Token op = tokens[current - 1];
-        auto right = unary();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+Expr* Parser::binary(int minPrecedence) {
+    Expr* expr = unary();
+    while (true) {
+        const InfixRule& rule = INFIX_RULES[peek().type];
+        if (rule.precedence < minPrecedence) break;   // minPrecedence > PREC_NONE
+        Token op = advance();
+        Expr* right = binary(rule.precedence + 1);
+        if (rule.logical) expr = node<LogicalExpr>(expr, op, right);
+        else expr = node<BinaryExpr>(expr, op, right);
     }
     return expr;
 }
 
-std::unique_ptr<Expr> Parser::unary() {
-    if (match({TokenType::BANG, TokenType::MINUS})) {
-        Token op = tokens[current - 1];
-        auto right = unary();
-        return std::make_unique<UnaryExpr>(op, std::move(right));
+Expr* Parser::unary() {
+    TokenType type = peek().type;
+    if (type == TokenType::BANG || type == TokenType::MINUS) {
+        Token op = advance();
+        return node<UnaryExpr>(op, unary());
     }
     return call();
 }
 
-std::unique_ptr<Expr> Parser::call() {
+Expr* Parser::call() {
     auto expr = primary();
     while (true) {
-        if (match({TokenType::LEFT_PAREN})) {
+        TokenType type = peek().type;
+        if (type == TokenType::LEFT_PAREN) {
+            advance();
             // Function call
-            std::vector<std::unique_ptr<Expr>> args;
+            std::vector<Expr*> args;
             if (!check(TokenType::RIGHT_PAREN)) {
                 do {
                     // Check for named argument: identifier = expr
-                    if (check(TokenType::IDENTIFIER) && current + 1 < (int)tokens.size()
-                        && tokens[current + 1].type == TokenType::EQUAL) {
+                    if (check(TokenType::IDENTIFIER) && tokenAt(current + 1).type == TokenType::EQUAL) {
                         // But make sure it's not ==
-                        if (current + 2 < (int)tokens.size() && tokens[current + 2].type != TokenType::EQUAL) {
+                        if (tokenAt(current + 2).type != TokenType::EQUAL) {
                             Token name = advance();
                             advance(); // consume =
                             auto value = expression();
-                            args.push_back(std::make_unique<NamedArgExpr>(name, std::move(value)));
+                            args.push_back(node<NamedArgExpr>(name, value));
                             continue;
                         }
                     }
@@ -268,38 +319,39 @@ std::unique_ptr<Expr> Parser::call() {
                 } while (match({TokenType::COMMA}));
             }
             consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.");
-            expr = std::make_unique<CallExpr>(std::move(expr), std::move(args));
-        } else if (match({TokenType::DOT})) {
+            expr = node<CallExpr>(expr, std::move(args));
+        } else if (type == TokenType::DOT) {
+            advance();
             Token name = consume(TokenType::IDENTIFIER, "Expect property name after '.'.");
             if (check(TokenType::LEFT_PAREN)) {
                 // Method call: expr.name(args)
                 advance();
-                std::vector<std::unique_ptr<Expr>> args;
+                std::vector<Expr*> args;
                 if (!check(TokenType::RIGHT_PAREN)) {
                     do {
-                        if (check(TokenType::IDENTIFIER) && current + 1 < (int)tokens.size()
-                            && tokens[current + 1].type == TokenType::EQUAL
-                            && (current + 2 >= (int)tokens.size() || tokens[current + 2].type != TokenType::EQUAL)) {
+                        if (check(TokenType::IDENTIFIER) && tokenAt(current + 1).type == TokenType::EQUAL
+                            && tokenAt(current + 2).type != TokenType::EQUAL) {
                             Token argName = advance();
                             advance();
                             auto value = expression();
-                            args.push_back(std::make_unique<NamedArgExpr>(argName, std::move(value)));
+                            args.push_back(node<NamedArgExpr>(argName, value));
                             continue;
                         }
                         args.push_back(expression());
                     } while (match({TokenType::COMMA}));
                 }
                 consume(TokenType::RIGHT_PAREN, "Expect ')' after method arguments.");
-                expr = std::make_unique<MethodCallExpr>(std::move(expr), name, std::move(args));
+                expr = node<MethodCallExpr>(expr, name, std::move(args));
             } else {
                 // Property access: expr.name
-                expr = std::make_unique<MemberAccessExpr>(std::move(expr), name);
+                expr = node<MemberAccessExpr>(expr, name);
             }
-        } else if (match({TokenType::LEFT_BRACKET})) {
+        } else if (type == TokenType::LEFT_BRACKET) {
+            advance();
             // Index access: expr[index]
             auto index = expression();
             consume(TokenType::RIGHT_BRACKET, "Expect ']' after index.");
-            expr = std::make_unique<IndexExpr>(std::move(expr), std::move(index));
+            expr = node<IndexExpr>(expr, index);
         } else {
             break;
         }
@@ -307,23 +359,29 @@ std::unique_ptr<Expr> Parser::call() {
     return expr;
 }
 
-std::unique_ptr<Expr> Parser::primary() {
-    if (match({TokenType::NUMBER})) return std::make_unique<LiteralExpr>(tokens[current - 1]);
-    if (match({TokenType::STRING})) return std::make_unique<LiteralExpr>(tokens[current - 1]);
-    if (match({TokenType::TRUE})) return std::make_unique<LiteralExpr>(tokens[current - 1]);
-    if (match({TokenType::FALSE})) return std::make_unique<LiteralExpr>(tokens[current - 1]);
-    if (match({TokenType::IDENTIFIER})) return std::make_unique<VariableExpr>(tokens[current - 1]);
+Expr* Parser::primary() {
+    switch (peek().type) {
+        case TokenType::NUMBER:
+        case TokenType::STRING:
+        case TokenType::TRUE:
+        case TokenType::FALSE:
+            return node<LiteralExpr>(advance());
+        case TokenType::IDENTIFIER:
+            return node<VariableExpr>(advance());
+        default:
+            break;
+    }
 
     // Array literal: [expr, expr, ...]
     if (match({TokenType::LEFT_BRACKET})) {
-        std::vector<std::unique_ptr<Expr>> elements;
+        std::vector<Expr*> elements;
         if (!check(TokenType::RIGHT_BRACKET)) {
             do {
                 elements.push_back(expression());
             } while (match({TokenType::COMMA}));
         }
         consume(TokenType::RIGHT_BRACKET, "Expect ']' after array elements.");
-        return std::make_unique<ArrayExpr>(std::move(elements));
+        return node<ArrayExpr>(std::move(elements));
     }
 
     if (match({TokenType::LEFT_PAREN})) {
@@ -343,31 +401,31 @@ std::unique_ptr<Expr> Parser::primary() {
             if (check(TokenType::COLON)) {
                 // It's a dictionary literal!
                 current = saved + 1; // back to after {
-                std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr>>> entries;
+                std::vector<std::pair<Expr*, Expr*>> entries;
                 if (!check(TokenType::RIGHT_BRACE)) {
                     do {
                         auto key = expression();
                         consume(TokenType::COLON, "Expect ':' after dictionary key.");
                         auto value = expression();
-                        entries.push_back({std::move(key), std::move(value)});
+                        entries.push_back({key, value});
                     } while (match({TokenType::COMMA}));
                 }
                 consume(TokenType::RIGHT_BRACE, "Expect '}' after dictionary.");
-                return std::make_unique<DictExpr>(std::move(entries));
+                return node<DictExpr>(std::move(entries));
             } else {
                 current = saved; // restore — it's a block statement
             }
         } else if (check(TokenType::RIGHT_BRACE)) {
             // empty dict {}
             advance(); // consume }
-            std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr>>> entries;
-            return std::make_unique<DictExpr>(std::move(entries));
+            std::vector<std::pair<Expr*, Expr*>> entries;
+            return node<DictExpr>(std::move(entries));
         } else {
             current = saved; // restore
         }
     }
 
-    throw std::runtime_error("Parser error at line " + std::to_string(peek().line) + ": unexpected token '" + peek().lexeme + "'");
+    throw std::runtime_error("Parser error at line " + std::to_string(peek().line) + ": unexpected token '" + std::string(peek().lexeme) + "'");
 }
 
 // =================== Helpers ===================
@@ -383,19 +441,23 @@ bool Parser::check(TokenType type) const {
     return peek().type == type;
 }
 
-Token Parser::advance() {
+const Token& Parser::advance() {
     if (!isAtEnd()) current++;
-    return tokens[current - 1];
+    return tokenAt(current - 1);
 }
 
-Token Parser::peek() const { return tokens[current]; }
-
-Token Parser::peekNext() const {
-    if (current + 1 >= (int)tokens.size()) return tokens.back();
-    return tokens[current + 1];
+// Reads past the end of the stream return the final EOF_TOKEN
+const Token& Parser::tokenAt(int index) const {
+    size_t i = static_cast<size_t>(index);
+    while (i >= tokens.size() && lexer && !lexer->done()) lexer->scanInto(tokens, TOKEN_BATCH);
+    return i < tokens.size() ? tokens[i] : tokens.back();
 }
 
-Token Parser::consume(TokenType type, const std::string& message) {
+const Token& Parser::peek() const { return tokenAt(current); }
+
+const Token& Parser::peekNext() const { return tokenAt(current + 1); }
+
+const Token& Parser::consume(TokenType type, const std::string& message) {
     if (check(type)) return advance();
     throw std::runtime_error("Parser error: " + message);
 }
@@ -404,57 +466,181 @@ bool Parser::isAtEnd() const { return peek().type == TokenType::EOF_TOKEN; }
 
 // =================== Expression Evaluate Implementations ===================
 
+LiteralExpr::LiteralExpr(Token val) : value(val) {
+    if (value.type == TokenType::NUMBER) constant = SatanValue(value.number);
+    else if (value.type == TokenType::STRING) constant = SatanValue(std::string(value.lexeme));
+    else if (value.type == TokenType::TRUE) constant = SatanValue(true);
+    else if (value.type == TokenType::FALSE) constant = SatanValue(false);
+}
 void LiteralExpr::print() const { std::cout << value.lexeme; }
-SatanValue LiteralExpr::evaluate(Environment& env) const {
-    if (value.type == TokenType::NUMBER) return SatanValue(std::stod(value.lexeme));
-    if (value.type == TokenType::STRING) return SatanValue(value.lexeme);
-    if (value.type == TokenType::TRUE) return SatanValue(true);
-    if (value.type == TokenType::FALSE) return SatanValue(false);
-    return SatanValue();
+SatanValue LiteralExpr::evaluate(Environment&) const {
+    return constant;
 }
 
 void VariableExpr::print() const { std::cout << name.lexeme; }
 SatanValue VariableExpr::evaluate(Environment& env) const {
-    return env.get(name.lexeme);
+    if (depth >= 0) return env.getAt(depth, slot);
+    return env.get(name.symbol);
 }
 
 void BinaryExpr::print() const {
     std::cout << "("; left->print(); std::cout << " " << op.lexeme << " "; right->print(); std::cout << ")";
 }
 SatanValue BinaryExpr::evaluate(Environment& env) const {
-    SatanValue l = left->evaluate(env);
-    SatanValue r = right->evaluate(env);
-    switch (op.type) {
-        case TokenType::PLUS:
-            if (l.isNumber() && r.isNumber()) return SatanValue(l.number + r.number);
-            return SatanValue(l.toString() + r.toString());
-        case TokenType::MINUS: return SatanValue(l.asNumber() - r.asNumber());
-        case TokenType::STAR:  return SatanValue(l.asNumber() * r.asNumber());
-        case TokenType::SLASH:
-            if (r.asNumber() == 0) throw std::runtime_error("Division by zero.");
-            return SatanValue(l.asNumber() / r.asNumber());
-        case TokenType::PERCENT:
-            if (r.asNumber() == 0) throw std::runtime_error("Modulo by zero.");
-            return SatanValue(std::fmod(l.asNumber(), r.asNumber()));
-        case TokenType::GREATER:       return SatanValue(l.asNumber() > r.asNumber());
-        case TokenType::GREATER_EQUAL: return SatanValue(l.asNumber() >= r.asNumber());
-        case TokenType::LESS:          return SatanValue(l.asNumber() < r.asNumber());
-        case TokenType::LESS_EQUAL:    return SatanValue(l.asNumber() <= r.asNumber());
-        case TokenType::EQUAL_EQUAL:
-            if (l.type != r.type) return SatanValue(false);
-            if (l.isNumber()) return SatanValue(l.number == r.number);
-            if (l.isString()) return SatanValue(l.str == r.str);
-            if (l.isBoolean()) return SatanValue(l.boolean == r.boolean);
-            return SatanValue(false);
-        case TokenType::BANG_EQUAL:
-            if (l.type != r.type) return SatanValue(true);
-            if (l.isNumber()) return SatanValue(l.number != r.number);
-            if (l.isString()) return SatanValue(l.str != r.str);
-            if (l.isBoolean()) return SatanValue(l.boolean != r.boolean);
-            return SatanValue(true);
-        default:
-            throw std::runtime_error("Unknown binary operator: " + op.lexeme);
+    return evaluator(*this, env);
+}
+
+// Quickening: the first evaluation of a BinaryExpr looks at its operands. If
+// both are numbers it switches to a handler for that one operator that works
+// on the doubles directly, reading literal and local variable operands in
+// place instead of evaluating them into copies. A handler that then meets
+// another type hands the node to the generic path for good, so a mixed-type
+// site doesn't flip back and forth. If that type is an array and the node
+// heads a fusable chain, the whole chain runs fused from then on.
+namespace {
+
+SatanValue evaluateGeneric(const BinaryExpr& e, Environment& env) {
+    SatanValue l = e.left->evaluate(env);
+    SatanValue r = e.right->evaluate(env);
+    return binaryOp(e.op.type, l, r);
+}
+
+SatanValue evaluateChain(const BinaryExpr& e, Environment& env) {
+    const FusedChain& chain = *e.fused;
+    SatanValue operands[MAX_FUSED_OPERANDS];
+    for (size_t i = 0; i < chain.operands.size(); i++) operands[i] = chain.operands[i]->evaluate(env);
+    return evaluateFused(chain.plan, operands);
+}
+
+// Leaves the number handlers for good
+void generalize(const BinaryExpr& e, const SatanValue& l, const SatanValue& r) {
+    e.evaluator = evaluateGeneric;
+    if (!l.isArray() && !r.isArray()) return;
+    auto chain = std::make_unique<FusedChain>();
+    if (!e.fuse(*chain)) return;
+    e.fused = std::move(chain);
+    e.evaluator = evaluateChain;
+}
+
+// Division and modulo leave a zero divisor to binaryOp, which reports it
+struct Add { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a + b); } };
+struct Subtract { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a - b); } };
+struct Multiply { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a * b); } };
+struct Divide { static constexpr bool divides = true; static SatanValue apply(double a, double b) { return SatanValue(a / b); } };
+struct Modulo { static constexpr bool divides = true; static SatanValue apply(double a, double b) { return SatanValue(std::fmod(a, b)); } };
+struct Less { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a < b); } };
+struct LessEqual { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a <= b); } };
+struct Greater { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a > b); } };
+struct GreaterEqual { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a >= b); } };
+struct Equal { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a == b); } };
+struct NotEqual { static constexpr bool divides = false; static SatanValue apply(double a, double b) { return SatanValue(a != b); } };
+
+// Where an operand's value can be found
+enum class Operand { ANY, LITERAL, LOCAL };
+
+Operand operandKind(const Expr* e) {
+    if (dynamic_cast<const LiteralExpr*>(e)) return Operand::LITERAL;
+    if (auto* var = dynamic_cast<const VariableExpr*>(e); var && var->depth >= 0) return Operand::LOCAL;
+    return Operand::ANY;
+}
+
+template <Operand kind>
+const SatanValue& operand(const Expr* e, Environment& env, SatanValue& scratch) {
+    if constexpr (kind == Operand::LITERAL) {
+        return static_cast<const LiteralExpr*>(e)->constant;
+    } else if constexpr (kind == Operand::LOCAL) {
+        auto* var = static_cast<const VariableExpr*>(e);
+        return env.getAt(var->depth, var->slot);
+    } else {
+        scratch = e->evaluate(env);
+        return scratch;
+    }
+}
+
+template <typename Op, Operand leftKind, Operand rightKind>
+SatanValue evaluateNumbers(const BinaryExpr& e, Environment& env) {
+    SatanValue leftScratch, rightScratch;
+    const SatanValue& l = operand<leftKind>(e.left, env, leftScratch);
+    const SatanValue& r = operand<rightKind>(e.right, env, rightScratch);
+    if (l.isNumber() && r.isNumber()) [[likely]] {
+        if (!Op::divides || r.number != 0) return Op::apply(l.number, r.number);
+    } else {
+        generalize(e, l, r);
+    }
+    return binaryOp(e.op.type, l, r);
+}
+
+template <Operand leftKind, Operand rightKind>
+BinaryExpr::Evaluator numberEvaluator(TokenType op) {
+    switch (op) {
+        case TokenType::PLUS: return evaluateNumbers<Add, leftKind, rightKind>;
+        case TokenType::MINUS: return evaluateNumbers<Subtract, leftKind, rightKind>;
+        case TokenType::STAR: return evaluateNumbers<Multiply, leftKind, rightKind>;
+        case TokenType::SLASH: return evaluateNumbers<Divide, leftKind, rightKind>;
+        case TokenType::PERCENT: return evaluateNumbers<Modulo, leftKind, rightKind>;
+        case TokenType::LESS: return evaluateNumbers<Less, leftKind, rightKind>;
+        case TokenType::LESS_EQUAL: return evaluateNumbers<LessEqual, leftKind, rightKind>;
+        case TokenType::GREATER: return evaluateNumbers<Greater, leftKind, rightKind>;
+        case TokenType::GREATER_EQUAL: return evaluateNumbers<GreaterEqual, leftKind, rightKind>;
+        case TokenType::EQUAL_EQUAL: return evaluateNumbers<Equal, leftKind, rightKind>;
+        case TokenType::BANG_EQUAL: return evaluateNumbers<NotEqual, leftKind, rightKind>;
+        default: return evaluateGeneric;
+    }
+}
+
+template <Operand leftKind>
+BinaryExpr::Evaluator numberEvaluator(TokenType op, Operand rightKind) {
+    switch (rightKind) {
+        case Operand::LITERAL: return numberEvaluator<leftKind, Operand::LITERAL>(op);
+        case Operand::LOCAL: return numberEvaluator<leftKind, Operand::LOCAL>(op);
+        default: return numberEvaluator<leftKind, Operand::ANY>(op);
+    }
+}
+
+}
+
+SatanValue BinaryExpr::quicken(const BinaryExpr& e, Environment& env) {
+    SatanValue l = e.left->evaluate(env);
+    SatanValue r = e.right->evaluate(env);
+    if (!l.isNumber() || !r.isNumber()) {
+        generalize(e, l, r);
+        return binaryOp(e.op.type, l, r);
+    }
+    Operand leftKind = operandKind(e.left);
+    Operand rightKind = operandKind(e.right);
+    // A local on the left is read by reference, so evaluating the right
+    // side must not be able to assign to it
+    if (leftKind == Operand::LOCAL && rightKind == Operand::ANY) leftKind = Operand::ANY;
+    switch (leftKind) {
+        case Operand::LITERAL: e.evaluator = numberEvaluator<Operand::LITERAL>(e.op.type, rightKind); break;
+        case Operand::LOCAL: e.evaluator = numberEvaluator<Operand::LOCAL>(e.op.type, rightKind); break;
+        default: e.evaluator = numberEvaluator<Operand::ANY>(e.op.type, rightKind); break;
     }
+    return binaryOp(e.op.type, l, r);
+}
+
+// Appends `e` to a chain: an arithmetic BinaryExpr contributes its operands
+// and then its operator, anything else must be a plain operand
+static bool appendToChain(const Expr* e, FusedChain& chain) {
+    if (auto* binary = dynamic_cast<const BinaryExpr*>(e); binary && isElementwiseArithmetic(binary->op.type)) {
+        if (!appendToChain(binary->left, chain) || !appendToChain(binary->right, chain)) return false;
+        chain.plan.steps.push_back({false, binary->op.type});
+        return true;
+    }
+    if (!dynamic_cast<const LiteralExpr*>(e) && !dynamic_cast<const VariableExpr*>(e)) return false;
+    if (chain.operands.size() == MAX_FUSED_OPERANDS) return false;
+    chain.operands.push_back(e);
+    chain.plan.steps.push_back({true, {}});
+    return true;
+}
+
+bool BinaryExpr::fuse(FusedChain& chain) const {
+    if (!isElementwise(op.type)) return false;
+    chain = FusedChain();
+    if (!appendToChain(left, chain) || !appendToChain(right, chain)) return false;
+    chain.plan.steps.push_back({false, op.type});
+    chain.plan.operands = static_cast<uint32_t>(chain.operands.size());
+    return chain.plan.steps.size() - chain.operands.size() >= 2;
 }
 
 void CallExpr::print() const {
@@ -465,36 +651,80 @@ void CallExpr::print() const {
     }
     std::cout << ")";
 }
+static ExecStatus runStatements(const std::vector<Stmt*>& statements, Environment& env) {
+    for (const auto& stmt : statements) {
+        ExecStatus status = stmt->execute(env);
+        if (!status.isNormal()) return status;
+    }
+    return {};
+}
+
+// A heap-allocated scope that a closure may capture, released when the
+// block, call or iteration that opened it ends
+struct SharedScope {
+    std::shared_ptr<Environment> env;
+    SharedScope(std::shared_ptr<Environment> parent, uint32_t numSlots)
+        : env(Environment::makeShared(std::move(parent), numSlots)) {}
+    ~SharedScope() { Environment::release(env); }
+};
+
+// Result of a user function call: the returned value, or nil when the body
+// runs off the end. A break/continue must not escape the function.
+static SatanValue completeCall(ExecStatus status) {
+    switch (status.kind) {
+        case ExecStatus::RETURN: return std::move(status.value);
+        case ExecStatus::BREAK: throw std::runtime_error("'break' used outside of a loop");
+        case ExecStatus::CONTINUE: throw std::runtime_error("'continue' used outside of a loop");
+        default: return SatanValue();
+    }
+}
+
+static void bindParam(Environment& callEnv, const FunctionObject& func, size_t i, SatanValue value) {
+    if (func.body->scope.numSlots) callEnv.slot(static_cast<uint32_t>(i)) = std::move(value);
+    else callEnv.define(func.params[i], std::move(value));
+}
+
+// Runs a user function in a new frame whose parent is the scope the function
+// was declared in. `bindArgs` fills the parameters, the frame's first slots.
+template <typename BindArgs>
+static SatanValue invokeFunction(const FunctionObject& func, BindArgs&& bindArgs) {
+    const ScopeInfo& frame = func.body->scope;
+    auto run = [&](Environment& callEnv) {
+        bindArgs(callEnv);
+        return completeCall(runStatements(func.body->statements, callEnv));
+    };
+    if (frame.captured) {
+        SharedScope callEnv(func.closure, frame.numSlots);
+        return run(*callEnv.env);
+    }
+    Environment callEnv(func.closure.get(), frame.numSlots);
+    return run(callEnv);
+}
+
 SatanValue CallExpr::evaluate(Environment& env) const {
     SatanValue fn = callee->evaluate(env);
 
     // Native function
-    if (fn.isNativeFn() && fn.nativeFn) {
+    if (fn.isNativeFn() && fn.nativeFn()) {
         std::vector<SatanValue> args;
         for (const auto& arg : arguments) {
             args.push_back(arg->evaluate(env));
         }
-        return (*fn.nativeFn)(args);
+        return (*fn.nativeFn())(args);
     }
 
     // User-defined function
-    if (fn.isFunction() && fn.function) {
-        const FunctionObject& func = *fn.function;
+    if (fn.isFunction() && fn.function()) {
+        const FunctionObject& func = *fn.function();
         if (arguments.size() != func.params.size()) {
             throw std::runtime_error("Expected " + std::to_string(func.params.size()) +
                                      " arguments but got " + std::to_string(arguments.size()) + ".");
         }
-        Environment callEnv(&env);
-        for (size_t i = 0; i < func.params.size(); i++) {
-            SatanValue argVal = arguments[i]->evaluate(env);
-            callEnv.define(func.params[i], std::move(argVal));
-        }
-        try {
-            func.body->execute(callEnv);
-        } catch (const ReturnException& ret) {
-            return ret.value;
-        }
-        return SatanValue();
+        // Arguments are evaluated straight into the callee's frame
+        return invokeFunction(func, [&](Environment& callEnv) {
+            for (size_t i = 0; i < arguments.size(); i++)
+                bindParam(callEnv, func, i, arguments[i]->evaluate(env));
+        });
     }
 
     throw std::runtime_error("Can only call functions.");
@@ -537,6 +767,7 @@ void ArrayExpr::print() const {
 }
 SatanValue ArrayExpr::evaluate(Environment& env) const {
     std::vector<SatanValue> vals;
+    vals.reserve(elements.size());
     for (const auto& elem : elements) vals.push_back(elem->evaluate(env));
     return SatanValue::makeArray(std::move(vals));
 }
@@ -545,22 +776,7 @@ void MemberAccessExpr::print() const {
     object->print(); std::cout << "." << member.lexeme;
 }
 SatanValue MemberAccessExpr::evaluate(Environment& env) const {
-    SatanValue obj = object->evaluate(env);
-    // For ML objects, use the property handler
-    if (obj.isObject()) {
-        auto typeIt = obj.object->find("__type__");
-        if (typeIt != obj.object->end() && Interpreter::current) {
-            return handlePropertyAccess(obj, member.lexeme, Interpreter::current->getBridge());
-        }
-        return obj.getProperty(member.lexeme);
-    }
-    if (obj.isArray() && member.lexeme == "length") {
-        return SatanValue(static_cast<double>(obj.array ? obj.array->size() : 0));
-    }
-    if (obj.isString() && member.lexeme == "length") {
-        return SatanValue(static_cast<double>(obj.str.size()));
-    }
-    return obj.getProperty(member.lexeme);
+    return getMember(object->evaluate(env), member.symbol);
 }
 
 void MethodCallExpr::print() const {
@@ -573,224 +789,42 @@ void MethodCallExpr::print() const {
 }
 SatanValue MethodCallExpr::evaluate(Environment& env) const {
     SatanValue obj = object->evaluate(env);
-    std::vector<SatanValue> args;
-    for (const auto& arg : arguments) args.push_back(arg->evaluate(env));
-
-    // Array built-in methods
-    if (obj.isArray()) {
-        if (method.lexeme == "push" && args.size() == 1) {
-            obj.array->push_back(args[0]);
-            return SatanValue();
+    // Borrows argBuffer for the call and hands it back empty (capacity kept)
+    // however the call ends, so no argument outlives it
+    struct ArgLease {
+        const MethodCallExpr& site;
+        std::vector<SatanValue> own;
+        std::vector<SatanValue>& args;
+        explicit ArgLease(const MethodCallExpr& s)
+            : site(s), args(s.argBufferBusy ? own : s.argBuffer) {
+            site.argBufferBusy = true;
         }
-        if (method.lexeme == "pop" && obj.array && !obj.array->empty()) {
-            SatanValue last = obj.array->back();
-            obj.array->pop_back();
-            return last;
+        ~ArgLease() {
+            if (&args != &site.argBuffer) return;
+            args.clear();
+            site.argBufferBusy = false;
         }
-        if (method.lexeme == "size" || method.lexeme == "length") {
-            return SatanValue(static_cast<double>(obj.array ? obj.array->size() : 0));
-        }
-        if (method.lexeme == "map" && args.size() == 1 && args[0].isCallable()) {
-            std::vector<SatanValue> result;
-            for (const auto& elem : *obj.array) {
-                std::vector<SatanValue> fnArgs = {elem};
-                if (args[0].isNativeFn()) result.push_back((*args[0].nativeFn)(fnArgs));
-                else if (args[0].isFunction()) {
-                    Environment callEnv(&env);
-                    for (size_t i = 0; i < args[0].function->params.size() && i < fnArgs.size(); i++)
-                        callEnv.define(args[0].function->params[i], fnArgs[i]);
-                    try { args[0].function->body->execute(callEnv); result.push_back(SatanValue()); }
-                    catch (const ReturnException& ret) { result.push_back(ret.value); }
-                }
-            }
-            return SatanValue::makeArray(std::move(result));
-        }
-        if (method.lexeme == "filter" && args.size() == 1 && args[0].isCallable()) {
-            std::vector<SatanValue> result;
-            for (const auto& elem : *obj.array) {
-                std::vector<SatanValue> fnArgs = {elem};
-                SatanValue res;
-                if (args[0].isNativeFn()) res = (*args[0].nativeFn)(fnArgs);
-                else if (args[0].isFunction()) {
-                    Environment callEnv(&env);
-                    for (size_t i = 0; i < args[0].function->params.size() && i < fnArgs.size(); i++)
-                        callEnv.define(args[0].function->params[i], fnArgs[i]);
-                    try { args[0].function->body->execute(callEnv); }
-                    catch (const ReturnException& ret) { res = ret.value; }
-                }
-                if (res.isTruthy()) result.push_back(elem);
-            }
-            return SatanValue::makeArray(std::move(result));
-        }
-        if (method.lexeme == "forEach" && args.size() == 1 && args[0].isCallable()) {
-            for (const auto& elem : *obj.array) {
-                std::vector<SatanValue> fnArgs = {elem};
-                if (args[0].isNativeFn()) (*args[0].nativeFn)(fnArgs);
-                else if (args[0].isFunction()) {
-                    Environment callEnv(&env);
-                    for (size_t i = 0; i < args[0].function->params.size() && i < fnArgs.size(); i++)
-                        callEnv.define(args[0].function->params[i], fnArgs[i]);
-                    try { args[0].function->body->execute(callEnv); }
-                    catch (const ReturnException&) {}
-                }
-            }
-            return SatanValue();
-        }
-        if (method.lexeme == "join") {
-            std::string delim = args.empty() ? ", " : args[0].toString();
-            std::string result;
-            for (size_t i = 0; i < obj.array->size(); i++) {
-                if (i > 0) result += delim;
-                result += (*obj.array)[i].toString();
-            }
-            return SatanValue(result);
-        }
-        if (method.lexeme == "indexOf" && args.size() == 1) {
-            for (size_t i = 0; i < obj.array->size(); i++) {
-                auto& el = (*obj.array)[i];
-                if (el.type == args[0].type) {
-                    if ((el.isNumber() && el.number == args[0].number) ||
-                        (el.isString() && el.str == args[0].str))
-                        return SatanValue(static_cast<double>(i));
-                }
-            }
-            return SatanValue(-1.0);
-        }
-        if (method.lexeme == "contains" && args.size() == 1) {
-            for (const auto& el : *obj.array) {
-                if (el.type == args[0].type) {
-                    if ((el.isNumber() && el.number == args[0].number) ||
-                        (el.isString() && el.str == args[0].str))
-                        return SatanValue(true);
-                }
-            }
-            return SatanValue(false);
-        }
-        if (method.lexeme == "reverse") {
-            std::vector<SatanValue> rev(obj.array->rbegin(), obj.array->rend());
-            return SatanValue::makeArray(std::move(rev));
-        }
-        if (method.lexeme == "slice") {
-            int start = args.size() > 0 ? (int)args[0].asNumber() : 0;
-            int end = args.size() > 1 ? (int)args[1].asNumber() : (int)obj.array->size();
-            if (start < 0) start = 0;
-            if (end > (int)obj.array->size()) end = (int)obj.array->size();
-            std::vector<SatanValue> sliced(obj.array->begin() + start, obj.array->begin() + end);
-            return SatanValue::makeArray(std::move(sliced));
-        }
-        if (method.lexeme == "sort") {
-            std::vector<SatanValue> sorted = *obj.array;
-            std::sort(sorted.begin(), sorted.end(), [](const SatanValue& a, const SatanValue& b) {
-                if (a.isNumber() && b.isNumber()) return a.number < b.number;
-                return a.toString() < b.toString();
-            });
-            return SatanValue::makeArray(std::move(sorted));
-        }
-    }
-
-    // String built-in methods
-    if (obj.isString()) {
-        if (method.lexeme == "upper") {
-            std::string s = obj.str;
-            for (auto& c : s) c = toupper(c);
-            return SatanValue(s);
-        }
-        if (method.lexeme == "lower") {
-            std::string s = obj.str;
-            for (auto& c : s) c = tolower(c);
-            return SatanValue(s);
-        }
-        if (method.lexeme == "split") {
-            std::string delim = args.empty() ? " " : args[0].toString();
-            std::vector<SatanValue> parts;
-            size_t pos = 0; std::string s = obj.str;
-            while ((pos = s.find(delim)) != std::string::npos) {
-                parts.push_back(SatanValue(s.substr(0, pos)));
-                s.erase(0, pos + delim.length());
-            }
-            parts.push_back(SatanValue(s));
-            return SatanValue::makeArray(std::move(parts));
-        }
-        if (method.lexeme == "trim") {
-            std::string s = obj.str;
-            s.erase(0, s.find_first_not_of(" \t\n\r"));
-            s.erase(s.find_last_not_of(" \t\n\r") + 1);
-            return SatanValue(s);
-        }
-        if (method.lexeme == "replace") {
-            if (args.size() < 2) throw std::runtime_error("replace() requires 2 arguments.");
-            std::string s = obj.str;
-            std::string from = args[0].toString(), to = args[1].toString();
-            size_t pos = 0;
-            while ((pos = s.find(from, pos)) != std::string::npos) {
-                s.replace(pos, from.length(), to);
-                pos += to.length();
-            }
-            return SatanValue(s);
-        }
-        if (method.lexeme == "starts_with" && args.size() == 1) {
-            return SatanValue(obj.str.substr(0, args[0].str.size()) == args[0].str);
-        }
-        if (method.lexeme == "ends_with" && args.size() == 1) {
-            if (args[0].str.size() > obj.str.size()) return SatanValue(false);
-            return SatanValue(obj.str.substr(obj.str.size() - args[0].str.size()) == args[0].str);
-        }
-        if (method.lexeme == "charAt" && args.size() == 1) {
-            int idx = (int)args[0].asNumber();
-            if (idx >= 0 && idx < (int)obj.str.size()) return SatanValue(std::string(1, obj.str[idx]));
-            return SatanValue(std::string(""));
-        }
-        if (method.lexeme == "includes" || method.lexeme == "contains") {
-            return SatanValue(obj.str.find(args[0].toString()) != std::string::npos);
-        }
-        if (method.lexeme == "substring") {
-            int start = args.size() > 0 ? (int)args[0].asNumber() : 0;
-            int len = args.size() > 1 ? (int)args[1].asNumber() : (int)obj.str.size() - start;
-            return SatanValue(obj.str.substr(start, len));
-        }
-        if (method.lexeme == "repeat") {
-            int count = args.size() > 0 ? (int)args[0].asNumber() : 1;
-            std::string result;
-            for (int i = 0; i < count; i++) result += obj.str;
-            return SatanValue(result);
-        }
-    }
-
-    // Object/Dictionary built-in methods
-    if (obj.isObject() && obj.object) {
-        if (method.lexeme == "keys") {
-            std::vector<SatanValue> keys;
-            for (const auto& p : *obj.object) {
-                if (p.first.size() >= 2 && p.first[0] == '_' && p.first[1] == '_') continue;
-                keys.push_back(SatanValue(p.first));
-            }
-            return SatanValue::makeArray(std::move(keys));
-        }
-        if (method.lexeme == "values") {
-            std::vector<SatanValue> vals;
-            for (const auto& p : *obj.object) {
-                if (p.first.size() >= 2 && p.first[0] == '_' && p.first[1] == '_') continue;
-                vals.push_back(p.second);
-            }
-            return SatanValue::makeArray(std::move(vals));
-        }
-        if (method.lexeme == "has" && args.size() == 1) {
-            return SatanValue(obj.object->count(args[0].toString()) > 0);
-        }
-        if (method.lexeme == "size") {
-            int count = 0;
-            for (const auto& p : *obj.object)
-                if (!(p.first.size() >= 2 && p.first[0] == '_' && p.first[1] == '_')) count++;
-            return SatanValue(static_cast<double>(count));
-        }
-    }
+    } lease(*this);
+    std::vector<SatanValue>& args = lease.args;
+    args.reserve(arguments.size());
+    for (const auto& arg : arguments) args.push_back(arg->evaluate(env));
 
-    // For ML objects, delegate to the ML handler
-    if (obj.isObject() && Interpreter::current) {
-        return handleMethodCall(obj, method.lexeme, args, Interpreter::current->getBridge());
+    // Callbacks passed to map/filter/forEach drop extra arguments; missing ones are nil
+    static const FunctionInvoker invoke = [](const SatanValue& fn, std::vector<SatanValue> fnArgs) {
+        const FunctionObject& func = *fn.function();
+        fnArgs.resize(func.params.size());
+        return invokeFunction(func, [&](Environment& callEnv) {
+            for (size_t i = 0; i < fnArgs.size(); i++) bindParam(callEnv, func, i, std::move(fnArgs[i]));
+        });
+    };
+    if (!cachedHandler || obj.type != cachedType) {
+        MethodHandler handler = findMethod(obj.type, method.symbol, args.size());
+        // ML objects and errors go the long way and leave the cache alone
+        if (!handler) return callMethod(obj, method.symbol, args, invoke);
+        cachedType = obj.type;
+        cachedHandler = handler;
     }
-
-    throw std::runtime_error("Cannot call method '" + method.lexeme + "' on " + obj.toString());
+    return cachedHandler(obj, args, invoke);
 }
 
 void IndexExpr::print() const {
@@ -799,31 +833,45 @@ void IndexExpr::print() const {
 SatanValue IndexExpr::evaluate(Environment& env) const {
     SatanValue obj = object->evaluate(env);
     SatanValue idx = index->evaluate(env);
-    if (obj.isArray() && idx.isNumber()) {
-        int i = static_cast<int>(idx.number);
-        if (i < 0 || i >= (int)obj.array->size())
-            throw std::runtime_error("Array index out of bounds: " + std::to_string(i));
-        return (*obj.array)[i];
-    }
-    if (obj.isString() && idx.isNumber()) {
-        int i = static_cast<int>(idx.number);
-        if (i < 0 || i >= (int)obj.str.size())
-            throw std::runtime_error("String index out of bounds: " + std::to_string(i));
-        return SatanValue(std::string(1, obj.str[i]));
-    }
-    if (obj.isObject() && idx.isString()) {
-        return obj.getProperty(idx.str);
-    }
-    throw std::runtime_error("Cannot index " + obj.toString());
+    return getIndex(obj, idx);
 }
 
 void AssignExpr::print() const {
-    std::cout << name.lexeme << " = "; value->print();
+    std::cout << name.lexeme << " " << assignmentText(op) << " "; value->print();
 }
 SatanValue AssignExpr::evaluate(Environment& env) const {
     SatanValue val = value->evaluate(env);
-    env.assign(name.lexeme, val);
-    return val;
+    if (op == TokenType::EQUAL) {
+        if (depth >= 0) env.assignAt(depth, slot, val);
+        else env.assign(name.symbol, val);
+        return val;
+    }
+    if (depth >= 0) {
+        SatanValue& target = env.slotAt(depth, slot);
+        compoundAssign(op, target, val);
+        return target;
+    }
+    SatanValue current = env.get(name.symbol);
+    compoundAssign(op, current, val);
+    env.assign(name.symbol, current);
+    return current;
+}
+
+void IndexAssignExpr::print() const {
+    object->print(); std::cout << "["; index->print(); std::cout << "] " << assignmentText(op) << " "; value->print();
+}
+SatanValue IndexAssignExpr::evaluate(Environment& env) const {
+    SatanValue obj = object->evaluate(env);
+    SatanValue idx = index->evaluate(env);
+    return setIndex(obj, idx, op, value->evaluate(env));
+}
+
+void MemberAssignExpr::print() const {
+    object->print(); std::cout << "." << member.lexeme << " " << assignmentText(op) << " "; value->print();
+}
+SatanValue MemberAssignExpr::evaluate(Environment& env) const {
+    SatanValue obj = object->evaluate(env);
+    return setMember(obj, member.symbol, op, value->evaluate(env));
 }
 
 void NamedArgExpr::print() const {
@@ -836,88 +884,104 @@ SatanValue NamedArgExpr::evaluate(Environment& env) const {
 
 // =================== Statement Implementations ===================
 
-void VarDecl::execute(Environment& env) const {
+ExecStatus VarDecl::execute(Environment& env) const {
     SatanValue val;
     if (initializer) val = initializer->evaluate(env);
-    env.define(name.lexeme, std::move(val));
+    if (slot >= 0) env.slot(slot) = std::move(val);
+    else env.define(name.symbol, std::move(val));
+    return {};
 }
 
-void AssembleStmt::execute(Environment& env) const {
+ExecStatus AssembleStmt::execute(Environment& env) const {
     SatanValue val = expr->evaluate(env);
     std::cout << val.toString() << std::endl;
+    return {};
 }
 
-void PrintStmt::execute(Environment& env) const {
+ExecStatus PrintStmt::execute(Environment& env) const {
     SatanValue val = expr->evaluate(env);
     std::cout << val.toString() << std::endl;
+    return {};
 }
 
-void IfStmt::execute(Environment& env) const {
+ExecStatus IfStmt::execute(Environment& env) const {
     SatanValue condVal = condition->evaluate(env);
-    if (condVal.isTruthy()) {
-        thenBranch->execute(env);
-    } else if (elseBranch) {
-        elseBranch->execute(env);
-    }
+    if (condVal.isTruthy()) return thenBranch->execute(env);
+    if (elseBranch) return elseBranch->execute(env);
+    return {};
 }
 
-void BlockStmt::execute(Environment& env) const {
-    Environment blockEnv(&env);
-    for (const auto& stmt : statements) stmt->execute(blockEnv);
+ExecStatus BlockStmt::execute(Environment& env) const {
+    if (scope.captured) {
+        SharedScope blockEnv(env.share(), scope.numSlots);
+        return runStatements(statements, *blockEnv.env);
+    }
+    Environment blockEnv(&env, scope.numSlots);
+    return runStatements(statements, blockEnv);
 }
 
-void ExprStmt::execute(Environment& env) const {
+ExecStatus ExprStmt::execute(Environment& env) const {
     expr->evaluate(env);
+    return {};
 }
 
-void SummonStmt::execute(Environment& env) const {
+ExecStatus SummonStmt::execute(Environment& env) const {
     SatanValue val = message->evaluate(env);
     std::cout << val.toString() << std::endl;
+    return {};
 }
 
-void FunDecl::execute(Environment& env) const {
+ExecStatus FunDecl::execute(Environment& env) const {
     FunctionObject func;
-    for (const auto& param : params) func.params.push_back(param.lexeme);
-    func.body = body;
-    env.defineFunction(name.lexeme, func);
-}
-
-void ReturnStmt::execute(Environment& env) const {
+    for (const auto& param : params) func.params.push_back(param.symbol);
+    // The body stays in its unit's arena; sharing ownership of the arena keeps it valid
+    func.body = std::shared_ptr<BlockStmt>(unit->shared_from_this(), body);
+    func.closure = env.share();
+    // A heap scope holding a function that holds it forms a cycle
+    func.inOwnScope = slot >= 0 && func.closure.use_count() > 0;
+    if (slot >= 0) env.slot(slot) = SatanValue::makeFunction(std::move(func));
+    else env.defineFunction(name.symbol, func);
+    return {};
+}
+
+ExecStatus ReturnStmt::execute(Environment& env) const {
     SatanValue val;
     if (value) val = value->evaluate(env);
-    throw ReturnException(std::move(val));
+    return {ExecStatus::RETURN, std::move(val)};
 }
 
-void WhileStmt::execute(Environment& env) const {
+ExecStatus WhileStmt::execute(Environment& env) const {
     int iterations = 0;
     while (condition->evaluate(env).isTruthy()) {
         if (++iterations > MAX_LOOP_ITERATIONS)
             throw std::runtime_error("While loop exceeded maximum iteration limit");
-        try { body->execute(env); }
-        catch (const BreakSignal&) { break; }
-        catch (const ContinueSignal&) { continue; }
+        ExecStatus status = body->execute(env);
+        if (status.kind == ExecStatus::BREAK) break;
+        if (status.kind == ExecStatus::RETURN) return status;
     }
+    return {};
 }
 
-void ForStmt::execute(Environment& env) const {
+ExecStatus ForStmt::execute(Environment& env) const {
     if (initializer) initializer->execute(env);
     int iterations = 0;
     while (!condition || condition->evaluate(env).isTruthy()) {
         if (++iterations > MAX_LOOP_ITERATIONS)
             throw std::runtime_error("For loop exceeded maximum iteration limit");
-        try { body->execute(env); }
-        catch (const BreakSignal&) { break; }
-        catch (const ContinueSignal&) { if (increment) increment->evaluate(env); continue; }
+        ExecStatus status = body->execute(env);
+        if (status.kind == ExecStatus::BREAK) break;
+        if (status.kind == ExecStatus::RETURN) return status;
         if (increment) increment->evaluate(env);
     }
+    return {};
 }
 
-void BreakStmt::execute(Environment&) const { throw BreakSignal(); }
-void ContinueStmt::execute(Environment&) const { throw ContinueSignal(); }
+ExecStatus BreakStmt::execute(Environment&) const { return ExecStatus(ExecStatus::BREAK); }
+ExecStatus ContinueStmt::execute(Environment&) const { return ExecStatus(ExecStatus::CONTINUE); }
 
 // =================== Phase 1: Parsing Methods ===================
 
-std::unique_ptr<Stmt> Parser::tryCatchStatement() {
+Stmt* Parser::tryCatchStatement() {
     consume(TokenType::LEFT_BRACE, "Expect '{' after 'try'.");
     auto tryBlock = parseBlock();
     consume(TokenType::CATCH, "Expect 'catch' after try block.");
@@ -930,16 +994,16 @@ std::unique_ptr<Stmt> Parser::tryCatchStatement() {
     }
     consume(TokenType::LEFT_BRACE, "Expect '{' after 'catch'.");
     auto catchBlock = parseBlock();
-    return std::make_unique<TryCatchStmt>(std::move(tryBlock), std::move(catchBlock), catchVar, hasCatchVar);
+    return node<TryCatchStmt>(tryBlock, catchBlock, catchVar, hasCatchVar);
 }
 
-std::unique_ptr<Stmt> Parser::importStatement() {
+Stmt* Parser::importStatement() {
     Token path = consume(TokenType::STRING, "Expect file path string after 'import'.");
     consume(TokenType::SEMICOLON, "Expect ';' after import path.");
-    return std::make_unique<ImportStmt>(path.lexeme);
+    return node<ImportStmt>(std::string(path.lexeme));
 }
 
-std::unique_ptr<Stmt> Parser::forInOrForStatement() {
+Stmt* Parser::forInOrForStatement() {
     consume(TokenType::LEFT_PAREN, "Expect '(' after 'for'.");
     // Check for 'for (let x in expr)' pattern
     if (check(TokenType::LET) || check(TokenType::VAR)) {
@@ -952,13 +1016,13 @@ std::unique_ptr<Stmt> Parser::forInOrForStatement() {
                 auto iterable = expression();
                 consume(TokenType::RIGHT_PAREN, "Expect ')' after for..in.");
                 auto body = statement();
-                return std::make_unique<ForInStmt>(varName, std::move(iterable), std::move(body));
+                return node<ForInStmt>(varName, iterable, body);
             }
         }
         current = saved; // not a for..in, restore and parse as normal for
     }
     // Regular C-style for loop
-    std::unique_ptr<Stmt> initializer;
+    Stmt* initializer = nullptr;
     if (match({TokenType::SEMICOLON})) {
         initializer = nullptr;
     } else if (match({TokenType::VAR})) {
@@ -966,17 +1030,17 @@ std::unique_ptr<Stmt> Parser::forInOrForStatement() {
     } else {
         initializer = expressionStatement();
     }
-    std::unique_ptr<Expr> condition = nullptr;
+    Expr* condition = nullptr;
     if (!check(TokenType::SEMICOLON)) condition = expression();
     consume(TokenType::SEMICOLON, "Expect ';' after loop condition.");
-    std::unique_ptr<Expr> increment = nullptr;
+    Expr* increment = nullptr;
     if (!check(TokenType::RIGHT_PAREN)) increment = expression();
     consume(TokenType::RIGHT_PAREN, "Expect ')' after for clauses.");
     auto body = statement();
-    return std::make_unique<ForStmt>(std::move(initializer), std::move(condition), std::move(increment), std::move(body));
+    return node<ForStmt>(initializer, condition, increment, body);
 }
 
-std::unique_ptr<Stmt> Parser::assertStatement() {
+Stmt* Parser::assertStatement() {
     auto condition = expression();
     std::string message = "Assertion failed";
     if (match({TokenType::COMMA})) {
@@ -984,108 +1048,136 @@ std::unique_ptr<Stmt> Parser::assertStatement() {
         message = msg.lexeme;
     }
     consume(TokenType::SEMICOLON, "Expect ';' after assert.");
-    return std::make_unique<AssertStmt>(std::move(condition), message);
+    return node<AssertStmt>(condition, message);
 }
 
-std::unique_ptr<Stmt> Parser::testStatement() {
+Stmt* Parser::testStatement() {
     Token name = consume(TokenType::STRING, "Expect test name string after 'test'.");
     consume(TokenType::LEFT_BRACE, "Expect '{' after test name.");
     auto body = parseBlock();
-    return std::make_unique<TestStmt>(name.lexeme, std::move(body));
+    return node<TestStmt>(std::string(name.lexeme), body);
 }
 
 // =================== Phase 1: Execution Implementations ===================
 
-void TryCatchStmt::execute(Environment& env) const {
+ExecStatus TryCatchStmt::execute(Environment& env) const {
+    // return/break/continue are plain statuses, so only real errors land in the catch
     try {
-        tryBlock->execute(env);
-    } catch (const ReturnException&) {
-        throw; // Don't catch returns
-    } catch (const BreakSignal&) {
-        throw; // Don't catch breaks
-    } catch (const ContinueSignal&) {
-        throw; // Don't catch continues
+        return tryBlock->execute(env);
     } catch (const std::exception& e) {
-        Environment catchEnv(&env);
-        if (hasCatchVar) {
-            catchEnv.define(catchVar.lexeme, SatanValue(std::string(e.what())));
+        SatanValue error(std::string(e.what()));
+        auto run = [&](Environment& catchEnv) {
+            if (hasCatchVar) {
+                if (catchScope.numSlots) catchEnv.slot(0) = std::move(error);
+                else catchEnv.define(catchVar.symbol, std::move(error));
+            }
+            return catchBlock->execute(catchEnv);
+        };
+        if (catchScope.captured) {
+            SharedScope catchEnv(env.share(), catchScope.numSlots);
+            return run(*catchEnv.env);
         }
-        catchBlock->execute(catchEnv);
+        Environment catchEnv(&env, catchScope.numSlots);
+        return run(catchEnv);
     }
 }
 
-void ImportStmt::execute(Environment& env) const {
+ExecStatus ImportStmt::execute(Environment& env) const {
     // Resolve path relative to current working directory
-    std::ifstream file(filepath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot import '" + filepath + "': file not found.");
+    ModuleRegistry& modules = Interpreter::current->getModules();
+    if (ModuleRegistry::Module* module = modules.find(filepath)) {
+        for (const auto& [name, value] : module->exports) env.define(name, value);
+        return {};
     }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
-
-    Lexer lexer(source);
-    auto tokens = lexer.scanTokens();
-    Parser parser(tokens);
-    auto stmts = parser.parse();
-
-    for (const auto& stmt : stmts) {
-        stmt->execute(env);
+    ModuleRegistry::Module& module = modules.load(filepath);
+    const std::vector<Stmt*>& statements = module.program.statements;
+    Resolver resolver;
+    resolver.resolve(statements);
+
+    // The body runs in a scope of its own under the globals, never in the
+    // importing frame: its functions capture that scope, and outlive the frame
+    module.scope = Environment::makeShared(Interpreter::current->getEnv().share(), 0);
+    for (Stmt* stmt : statements) {
+        ExecStatus status = stmt->execute(*module.scope);
+        if (!status.isNormal()) return status;
+    }
+    // Remember what the body defined for later imports to bind
+    for (Stmt* stmt : statements) {
+        if (auto* decl = dynamic_cast<VarDecl*>(stmt)) module.exports.emplace_back(decl->name.symbol, module.scope->get(decl->name.symbol));
+        else if (auto* fn = dynamic_cast<FunDecl*>(stmt)) module.exports.emplace_back(fn->name.symbol, module.scope->get(fn->name.symbol));
     }
+    for (const auto& [name, value] : module.exports) env.define(name, value);
+    return {};
 }
 
-void ForInStmt::execute(Environment& env) const {
+ExecStatus ForInStmt::execute(Environment& env) const {
     SatanValue iterVal = iterable->evaluate(env);
     int iterations = 0;
-    if (iterVal.isArray() && iterVal.array) {
-        for (const auto& elem : *iterVal.array) {
+    auto run = [&](Environment& loopEnv, SatanValue value) {
+        if (scope.numSlots) loopEnv.slot(0) = std::move(value);
+        else loopEnv.define(varName.symbol, std::move(value));
+        return body->execute(loopEnv);
+    };
+    // One loop scope is reused for every iteration, unless a closure declared
+    // in the body can capture it; then each iteration needs its own binding
+    Environment reused(&env, scope.captured ? 0 : scope.numSlots);
+    auto runBody = [&](SatanValue value) {
+        if (!scope.captured) return run(reused, std::move(value));
+        SharedScope loopEnv(env.share(), scope.numSlots);
+        return run(*loopEnv.env, std::move(value));
+    };
+    if (iterVal.isArray() && iterVal.array()) {
+        // By index, like the VM: the body may push to or unpack the array
+        const SatanArray& arr = *iterVal.array();
+        for (size_t i = 0; i < arr.size(); i++) {
             if (++iterations > 1000000) throw std::runtime_error("For..in loop exceeded max iterations");
-            Environment loopEnv(&env);
-            loopEnv.define(varName.lexeme, elem);
-            try { body->execute(loopEnv); }
-            catch (const BreakSignal&) { break; }
-            catch (const ContinueSignal&) { continue; }
+            ExecStatus status = runBody(arr.get(i));
+            if (status.kind == ExecStatus::BREAK) break;
+            if (status.kind == ExecStatus::RETURN) return status;
         }
     } else if (iterVal.isString()) {
-        for (char c : iterVal.str) {
+        for (char c : iterVal.str()) {
             if (++iterations > 1000000) throw std::runtime_error("For..in loop exceeded max iterations");
-            Environment loopEnv(&env);
-            loopEnv.define(varName.lexeme, SatanValue(std::string(1, c)));
-            try { body->execute(loopEnv); }
-            catch (const BreakSignal&) { break; }
-            catch (const ContinueSignal&) { continue; }
+            ExecStatus status = runBody(SatanValue(std::string(1, c)));
+            if (status.kind == ExecStatus::BREAK) break;
+            if (status.kind == ExecStatus::RETURN) return status;
         }
-    } else if (iterVal.isObject() && iterVal.object) {
-        for (const auto& pair : *iterVal.object) {
-            if (pair.first[0] == '_' && pair.first[1] == '_') continue; // skip internal props
+    } else if (iterVal.isObject() && iterVal.object()) {
+        // Over a snapshot of the visible keys, like the VM
+        std::vector<std::string> keys;
+        iterVal.object()->forEach([&](const std::string& name, const SatanValue&) {
+            if (!isInternalName(name)) keys.push_back(name);
+        });
+        for (std::string& key : keys) {
             if (++iterations > 1000000) throw std::runtime_error("For..in loop exceeded max iterations");
-            Environment loopEnv(&env);
-            loopEnv.define(varName.lexeme, SatanValue(pair.first));
-            try { body->execute(loopEnv); }
-            catch (const BreakSignal&) { break; }
-            catch (const ContinueSignal&) { continue; }
+            ExecStatus status = runBody(SatanValue(std::move(key)));
+            if (status.kind == ExecStatus::BREAK) break;
+            if (status.kind == ExecStatus::RETURN) return status;
         }
     } else {
         throw std::runtime_error("Cannot iterate over " + iterVal.toString());
     }
+    return {};
 }
 
-void AssertStmt::execute(Environment& env) const {
+ExecStatus AssertStmt::execute(Environment& env) const {
     SatanValue val = condition->evaluate(env);
     if (!val.isTruthy()) {
         throw std::runtime_error("Assertion failed: " + message);
     }
+    return {};
 }
 
-void TestStmt::execute(Environment& env) const {
+ExecStatus TestStmt::execute(Environment& env) const {
     std::cout << "\033[36m  TEST: " << name << "...\033[0m ";
+    ExecStatus status;
     try {
-        Environment testEnv(&env);
-        body->execute(testEnv);
+        status = body->execute(env);
         std::cout << "\033[32mPASSED\033[0m" << std::endl;
     } catch (const std::exception& e) {
         std::cout << "\033[31mFAILED: " << e.what() << "\033[0m" << std::endl;
     }
+    return status;
 }
 
 void DictExpr::print() const {
@@ -1,20 +1,31 @@
 #include "../include/python_bridge.h"
+#include "../include/ast_cache.h"
+#include <cstdlib>
 #include <cstdio>
 #include <array>
 #include <algorithm>
 #include <filesystem>
 #include <chrono>
+#include <cerrno>
 
 #ifdef _WIN32
 #include <windows.h>
 #define popen _popen
 #define pclose _pclose
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
 #endif
 
 namespace fs = std::filesystem;
 
 PythonBridge::PythonBridge()
-    : varCounter(0), plotCounter(0), pythonChecked(false), pythonAvailable(false) {
+    : varCounter(0), plotCounter(0), pythonChecked(false), pythonAvailable(false),
+      workerPid(-1), workerIn(-1), workerOut(-1), workerPrimed(false), workerDisabled(false) {
+    const char* noWorker = std::getenv("SATAN_NO_PY_WORKER");
+    if (noWorker && std::string(noWorker) != "0") workerDisabled = true;
     // Create plot output directory in current working directory
     plotDir = fs::current_path().string() + "/satan_plots";
     std::replace(plotDir.begin(), plotDir.end(), '\\', '/');
@@ -22,6 +33,7 @@ PythonBridge::PythonBridge()
 }
 
 PythonBridge::~PythonBridge() {
+    stopWorker();
     // Clean up temp session directory (scripts, pickles) but NOT plots
     try {
         if (!sessionDir.empty() && fs::exists(sessionDir)) {
@@ -137,16 +149,197 @@ std::string PythonBridge::writeTempAndRun(const std::string& script) {
     return output;
 }
 
+std::string PythonBridge::getWorkerSource() {
+    // Reads "<len>\n<code>" frames from fd 3 and answers each one on fd 4 with
+    // "<status> <outlen> <errlen>\n<stdout><stderr>". Globals persist between
+    // frames, so imports and loaded data survive for the whole session.
+    return R"PY(
+import io, os, sys, traceback
+_satan_rx = os.fdopen(3, 'rb')
+_satan_tx = os.fdopen(4, 'wb')
+_satan_globals = {'__name__': '__main__'}
+while True:
+    _hdr = _satan_rx.readline()
+    if not _hdr:
+        break
+    _code = _satan_rx.read(int(_hdr)).decode('utf-8', 'replace')
+    _out, _err = io.StringIO(), io.StringIO()
+    _status = 0
+    sys.stdout, sys.stderr = _out, _err
+    try:
+        exec(compile(_code, '<satan>', 'exec'), _satan_globals)
+    except SystemExit as _e:
+        _status = 0 if _e.code in (0, None) else 1
+    except BaseException:
+        _status = 1
+        _t, _v, _tb = sys.exc_info()
+        traceback.print_exception(_t, _v, _tb.tb_next)
+    finally:
+        sys.stdout, sys.stderr = sys.__stdout__, sys.__stderr__
+    _plt = sys.modules.get('matplotlib.pyplot')
+    if _plt is not None:
+        _plt.close('all')
+    _o = _out.getvalue().encode('utf-8', 'replace')
+    _e = _err.getvalue().encode('utf-8', 'replace')
+    _satan_tx.write(b'%d %d %d\n' % (_status, len(_o), len(_e)) + _o + _e)
+    _satan_tx.flush()
+)PY";
+}
+
+bool PythonBridge::startWorker() {
+#ifdef _WIN32
+    return false;
+#else
+    if (workerPid > 0) return true;
+    if (workerDisabled) return false;
+    if (sessionDir.empty()) initSession();
+
+    int toWorker[2], fromWorker[2];
+    if (pipe(toWorker) != 0) { workerDisabled = true; return false; }
+    if (pipe(fromWorker) != 0) {
+        close(toWorker[0]); close(toWorker[1]);
+        workerDisabled = true;
+        return false;
+    }
+    for (int fd : {toWorker[0], toWorker[1], fromWorker[0], fromWorker[1]})
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    std::string source = getWorkerSource();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(toWorker[0]); close(toWorker[1]);
+        close(fromWorker[0]); close(fromWorker[1]);
+        workerDisabled = true;
+        return false;
+    }
+    if (pid == 0) {
+        // Move the pipe ends out of the way first so dup2 cannot clobber them
+        int rx = fcntl(toWorker[0], F_DUPFD, 10);
+        int tx = fcntl(fromWorker[1], F_DUPFD, 10);
+        dup2(rx, 3);
+        dup2(tx, 4);
+        execlp("python", "python", "-u", "-c", source.c_str(), (char*)nullptr);
+        execlp("python3", "python3", "-u", "-c", source.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+
+    close(toWorker[0]);
+    close(fromWorker[1]);
+    // A worker that dies mid-request must surface as an error, not kill us
+    signal(SIGPIPE, SIG_IGN);
+    workerPid = pid;
+    workerIn = toWorker[1];
+    workerOut = fromWorker[0];
+    workerPrimed = false;
+    return true;
+#endif
+}
+
+void PythonBridge::stopWorker() {
+#ifndef _WIN32
+    if (workerPid <= 0) return;
+    close(workerIn);   // EOF on fd 3 ends the request loop
+    close(workerOut);
+    int status = 0;
+    waitpid(workerPid, &status, 0);
+    workerPid = -1;
+    workerIn = workerOut = -1;
+    workerPrimed = false;
+    residentFrames.clear();
+#endif
+}
+
+std::string PythonBridge::runInWorker(const std::string& code) {
+#ifdef _WIN32
+    return writeTempAndRun(getPreamble() + code);
+#else
+    auto writeAll = [this](const std::string& data) {
+        size_t off = 0;
+        while (off < data.size()) {
+            ssize_t n = write(workerIn, data.data() + off, data.size() - off);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            off += static_cast<size_t>(n);
+        }
+        return true;
+    };
+    auto readAll = [this](std::string& out, size_t len) {
+        out.resize(len);
+        size_t off = 0;
+        while (off < len) {
+            ssize_t n = read(workerOut, &out[off], len - off);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            off += static_cast<size_t>(n);
+        }
+        return true;
+    };
+    auto readLine = [this](std::string& line) {
+        line.clear();
+        char c;
+        while (true) {
+            ssize_t n = read(workerOut, &c, 1);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            if (c == '\n') return true;
+            line += c;
+        }
+    };
+    // Returns false when the worker went away before answering
+    auto roundTrip = [&](const std::string& payload, int& status, std::string& out, std::string& err) {
+        if (!writeAll(std::to_string(payload.size()) + "\n" + payload)) return false;
+        std::string header;
+        if (!readLine(header)) return false;
+        size_t outLen = 0, errLen = 0;
+        std::istringstream hs(header);
+        if (!(hs >> status >> outLen >> errLen)) return false;
+        return readAll(out, outLen) && readAll(err, errLen);
+    };
+
+    int status = 0;
+    std::string out, err;
+    if (!workerPrimed) {
+        if (!roundTrip(getPreamble(), status, out, err)) {
+            // The interpreter never came up: use one-shot scripts from now on
+            stopWorker();
+            workerDisabled = true;
+            return writeTempAndRun(getPreamble() + code);
+        }
+        if (status != 0) throw std::runtime_error("Python error:\n" + err);
+        workerPrimed = true;
+    }
+
+    if (!roundTrip(code, status, out, err)) {
+        stopWorker();
+        throw std::runtime_error("Python worker exited unexpectedly; it will be restarted on next use.");
+    }
+    if (status != 0) throw std::runtime_error("Python error:\n" + err);
+    return out;
+#endif
+}
+
 std::string PythonBridge::executeImmediate(const std::string& code) {
+    // Taken first, so a run that fails anywhere drops them
+    auto staged = std::move(pendingFrames);
+    pendingFrames.clear();
+    if (!checkPython())
+        throw std::runtime_error("Python not found! Run 'satan --setup-ml' to configure.");
+    if (startWorker()) {
+        std::string output = runInWorker(code);
+        if (hasWorker()) {
+            for (auto& frame : staged) residentFrames[frame.first] = std::move(frame.second);
+        }
+        return output;
+    }
     std::string fullScript = getPreamble() + code;
     return writeTempAndRun(fullScript);
 }
 
 std::string PythonBridge::flushAndExecute() {
     if (sessionScript.empty()) return "";
-    std::string fullScript = getPreamble() + sessionScript;
+    std::string script = sessionScript;
     sessionScript.clear();
-    return writeTempAndRun(fullScript);
+    return executeImmediate(script);
 }
 
 SatanValue PythonBridge::parseResult(const std::string& output) {
@@ -174,6 +367,45 @@ SatanValue PythonBridge::parseResult(const std::string& output) {
     return SatanValue(trimmed);
 }
 
+SatanValue PythonBridge::parseListResult(const std::string& output) {
+    std::vector<SatanValue> items;
+    auto pos = output.rfind("__SATAN_RESULT__:");
+    if (pos == std::string::npos) return SatanValue::makeArray(std::move(items));
+    size_t end = output.find('\n', pos);
+    std::string list = output.substr(pos + 17, end == std::string::npos ? std::string::npos : end - pos - 17);
+    size_t i = list.find('[');
+    if (i == std::string::npos) return SatanValue::makeArray(std::move(items));
+    i++;
+    while (i < list.size() && list[i] != ']') {
+        char c = list[i];
+        if (c == ' ' || c == ',') { i++; continue; }
+        if (c == '"') {
+            std::string text;
+            for (i++; i < list.size() && list[i] != '"'; i++) {
+                if (list[i] != '\\' || i + 1 >= list.size()) { text += list[i]; continue; }
+                char e = list[++i];
+                text += e == 'n' ? '\n' : e == 't' ? '\t' : e == 'r' ? '\r' : e;
+            }
+            i++;   // closing quote
+            items.push_back(SatanValue(std::move(text)));
+            continue;
+        }
+        char* next = nullptr;
+        double number = std::strtod(list.c_str() + i, &next);
+        if (next == list.c_str() + i) break;   // not a list of numbers and strings
+        items.push_back(SatanValue(number));
+        i = next - list.c_str();
+    }
+    return SatanValue::makeArray(std::move(items));
+}
+
+std::string PythonBridge::withoutResult(const std::string& output) {
+    auto pos = output.rfind("__SATAN_RESULT__:");
+    if (pos == std::string::npos) return output;
+    size_t end = output.find('\n', pos);
+    return output.substr(0, pos) + (end == std::string::npos ? "" : output.substr(end + 1));
+}
+
 void PythonBridge::openImage(const std::string& path) {
 #ifdef _WIN32
     std::string cmd = "start \"\" \"" + path + "\"";
@@ -187,7 +419,96 @@ void PythonBridge::openImage(const std::string& path) {
 
 // =================== Code Generators ===================
 
+bool PythonBridge::statFrame(const std::string& filepath, ResidentFrame& frame) {
+    std::error_code ec;
+    frame.size = fs::file_size(filepath, ec);
+    if (ec) return false;
+    auto mtime = fs::last_write_time(filepath, ec);
+    if (ec) return false;
+    frame.source = filepath;
+    frame.mtime = static_cast<long long>(mtime.time_since_epoch().count());
+    return true;
+}
+
+std::string PythonBridge::genUseFrame(const std::string& pyVar, const std::string& filepath,
+                                      const std::string& steps) {
+    ResidentFrame current;
+    bool known = statFrame(filepath, current);
+    current.steps = steps;
+
+    std::string start = "pd.read_csv('" + filepath + "')";
+    std::string todo = steps;
+    if (known) {
+        // Start from the resident frame of this file version that is furthest
+        // along the same pipeline. Steps transform _df in place, so another
+        // DataFrame's frame is copied first.
+        const std::string* from = nullptr;
+        size_t fromDone = 0;
+        for (const auto& [var, frame] : residentFrames) {
+            if (frame.source != current.source || frame.size != current.size || frame.mtime != current.mtime) continue;
+            const std::string& done = frame.steps;
+            if (var == pyVar && done == steps) return "";
+            bool earlier = done.empty() || done == steps || steps.compare(0, done.size() + 1, done + ",") == 0;
+            size_t length = done.size() + 1;
+            if (earlier && (length > fromDone || (length == fromDone && var == pyVar))) {
+                from = &var;
+                fromDone = length;
+                todo = done == steps ? "" : done.empty() ? steps : steps.substr(done.size() + 1);
+            }
+        }
+        if (from) start = *from == pyVar ? pyVar : *from + ".copy()";
+    }
+    residentFrames.erase(pyVar);
+    if (known) pendingFrames.push_back({pyVar, current});
+
+    if (steps.empty()) return pyVar + " = " + start + "\n";
+
+    // Fuse every pending step into one pass over a single copy of the data
+    std::string pipeline = "_df = " + start + "\n";
+    std::stringstream names(todo);
+    std::string step;
+    while (std::getline(names, step, ',')) pipeline += genPreprocessStep(step);
+    pipeline += pyVar + " = _df\n";
+    if (!known || cacheDisabled()) return pipeline;
+
+    // Keep the materialized result for later runs of the pipeline, in a
+    // __satancache__ directory next to the CSV like parsed scripts. An entry
+    // is a (file version and steps, frame) pair; one for an older version of
+    // the file is ignored and then replaced.
+    fs::path csv(filepath);
+    std::ostringstream name;
+    name << csv.filename().string() << "." << std::hex << std::hash<std::string>{}(steps) << ".pkl";
+    std::string cachePath = (csv.parent_path() / "__satancache__" / name.str()).generic_string();
+    std::string key = std::to_string(current.size) + "|" + std::to_string(current.mtime) + "|" + steps;
+    std::string code;
+    code += "_satan_cache = '" + cachePath + "'\n";
+    code += "_satan_key = '" + key + "'\n";
+    code += "_satan_hit = None\n";
+    code += "try:\n";
+    code += "    _satan_k, _satan_v = pd.read_pickle(_satan_cache)\n";
+    code += "    if _satan_k == _satan_key: _satan_hit = _satan_v\n";
+    code += "except Exception:\n";
+    code += "    pass\n";
+    code += "if _satan_hit is not None:\n";
+    code += "    " + pyVar + " = _satan_hit\n";
+    code += "else:\n";
+    std::stringstream lines(pipeline);
+    std::string line;
+    while (std::getline(lines, line)) code += "    " + line + "\n";
+    // An unwritable directory only costs the cache
+    code += "    try:\n";
+    code += "        os.makedirs(os.path.dirname(_satan_cache), exist_ok=True)\n";
+    code += "        pd.to_pickle((_satan_key, " + pyVar + "), _satan_cache)\n";
+    code += "    except Exception:\n";
+    code += "        pass\n";
+    code += "_satan_hit = None\n";
+    return code;
+}
+
 std::string PythonBridge::genLoadCSV(const std::string& pyVar, const std::string& filepath) {
+    ResidentFrame current;
+    residentFrames.erase(pyVar);
+    if (statFrame(filepath, current)) pendingFrames.push_back({pyVar, current});
     return pyVar + " = pd.read_csv('" + filepath + "')\n"
          + "print(f'Loaded {" + pyVar + ".shape[0]} rows x {" + pyVar + ".shape[1]} columns')\n"
          + "print(f'Columns: {list(" + pyVar + ".columns)}')\n";
@@ -811,35 +1132,28 @@ std::string PythonBridge::genLearningCurve(const std::string& modelVar, const st
 // ============================================================
 // Feature 4: Data Preprocessing
 // ============================================================
-std::string PythonBridge::genFillMissing(const std::string& dataVar, const std::string& src) {
+std::string PythonBridge::genFillMissing() {
     std::string code;
-    code += "_df = pd.read_csv('" + src + "')\n";
     code += "for _col in _df.select_dtypes(include='number').columns:\n";
     code += "    _df[_col] = _df[_col].fillna(_df[_col].median())\n";
     code += "for _col in _df.select_dtypes(include='object').columns:\n";
     code += "    _df[_col] = _df[_col].fillna(_df[_col].mode()[0])\n";
     code += "_filled = _df.isnull().sum().sum()\n";
     code += "print(f'  Missing values filled. Remaining nulls: {_filled}')\n";
-    code += dataVar + " = _df\n";
-    code += "print('__SATAN_RESULT__:done')\n";
     return code;
 }
 
-std::string PythonBridge::genDropNulls(const std::string& dataVar, const std::string& src) {
+std::string PythonBridge::genDropNulls() {
     std::string code;
-    code += "_df = pd.read_csv('" + src + "')\n";
     code += "_before = len(_df)\n";
     code += "_df = _df.dropna()\n";
     code += "_after = len(_df)\n";
     code += "print(f'  Dropped {_before-_after} rows with nulls. Remaining: {_after} rows.')\n";
-    code += dataVar + " = _df\n";
-    code += "print('__SATAN_RESULT__:' + str(_after))\n";
     return code;
 }
 
-std::string PythonBridge::genEncodeText(const std::string& dataVar, const std::string& src) {
+std::string PythonBridge::genEncodeText() {
     std::string code;
-    code += "_df = pd.read_csv('" + src + "')\n";
     code += "from sklearn.preprocessing import LabelEncoder as _LE\n";
     code += "_le = _LE()\n";
     code += "_encoded_cols = []\n";
@@ -847,23 +1161,26 @@ std::string PythonBridge::genEncodeText(const std::string& dataVar, const std::s
     code += "    _df[_col] = _le.fit_transform(_df[_col].astype(str))\n";
     code += "    _encoded_cols.append(_col)\n";
     code += "print(f'  Encoded {len(_encoded_cols)} text columns: {_encoded_cols}')\n";
-    code += dataVar + " = _df\n";
-    code += "print('__SATAN_RESULT__:done')\n";
     return code;
 }
 
-std::string PythonBridge::genNormalize(const std::string& dataVar, const std::string& src) {
+std::string PythonBridge::genNormalize() {
     std::string code;
-    code += "_df = pd.read_csv('" + src + "')\n";
     code += "from sklearn.preprocessing import MinMaxScaler as _MMS\n";
     code += "_num_cols = _df.select_dtypes(include='number').columns[:-1]\n";
     code += "_df[_num_cols] = _MMS().fit_transform(_df[_num_cols])\n";
     code += "print(f'  Normalized {len(_num_cols)} feature columns to [0,1] range.')\n";
-    code += dataVar + " = _df\n";
-    code += "print('__SATAN_RESULT__:done')\n";
     return code;
 }
 
+std::string PythonBridge::genPreprocessStep(const std::string& step) {
+    if (step == "fill_missing") return genFillMissing();
+    if (step == "drop_nulls") return genDropNulls();
+    if (step == "encode") return genEncodeText();
+    if (step == "normalize") return genNormalize();
+    throw std::runtime_error("Unknown preprocessing step: " + step);
+}
+
 // ============================================================
 // Feature 5: Model Save / Load
 // ============================================================
@@ -63,14 +63,14 @@ void Repl::run() {
             auto tokens = lexer.scanTokens();
 
             Parser parser(tokens);
-            auto statements = parser.parse();
+            Program program = parser.parse();
 
-            if (statements.empty()) {
+            if (program.empty()) {
                 std::cerr << "[error] Could not parse input." << std::endl;
                 continue;
             }
 
-            interpreter.interpret(statements);
+            interpreter.interpret(program);
 
         } catch (const std::runtime_error& e) {
             std::cerr << "\033[31m[error]\033[0m " << e.what() << std::endl;
@@ -0,0 +1,188 @@
+#include "../include/resolver.h"
+
+void Resolver::resolve(const std::vector<Stmt*>& statements) {
+    for (const auto& stmt : statements) stmt->resolve(*this);
+}
+
+// =================== Scopes ===================
+
+void Resolver::beginScope() {
+    scopes.emplace_back();
+}
+
+ScopeInfo Resolver::endScope() {
+    ScopeInfo info{scopes.back().numSlots, scopes.back().captured};
+    scopes.pop_back();
+    return info;
+}
+
+int Resolver::declare(Symbol name) {
+    if (scopes.empty()) return -1;
+    Scope& scope = scopes.back();
+    // A redeclaration gets a fresh slot so earlier closures keep the old binding
+    uint32_t slot = scope.numSlots++;
+    scope.names.insert_or_assign(name, slot);
+    return static_cast<int>(slot);
+}
+
+void Resolver::resolveName(Symbol name, int& depth, uint32_t& slot) const {
+    for (size_t i = scopes.size(); i-- > 0;) {
+        auto it = scopes[i].names.find(name);
+        if (it != scopes[i].names.end()) {
+            depth = static_cast<int>(scopes.size() - 1 - i);
+            slot = it->second;
+            return;
+        }
+    }
+    depth = -1;
+}
+
+void Resolver::captureScopes() {
+    for (auto& scope : scopes) scope.captured = true;
+}
+
+// =================== Expressions ===================
+
+void LiteralExpr::resolve(Resolver&) {}
+
+void VariableExpr::resolve(Resolver& r) { r.resolveName(name.symbol, depth, slot); }
+
+void BinaryExpr::resolve(Resolver& r) {
+    left->resolve(r);
+    right->resolve(r);
+}
+
+void CallExpr::resolve(Resolver& r) {
+    callee->resolve(r);
+    for (const auto& arg : arguments) arg->resolve(r);
+}
+
+void LogicalExpr::resolve(Resolver& r) {
+    left->resolve(r);
+    right->resolve(r);
+}
+
+void UnaryExpr::resolve(Resolver& r) { right->resolve(r); }
+
+void ArrayExpr::resolve(Resolver& r) {
+    for (const auto& elem : elements) elem->resolve(r);
+}
+
+void MemberAccessExpr::resolve(Resolver& r) { object->resolve(r); }
+
+void MethodCallExpr::resolve(Resolver& r) {
+    object->resolve(r);
+    for (const auto& arg : arguments) arg->resolve(r);
+}
+
+void IndexExpr::resolve(Resolver& r) {
+    object->resolve(r);
+    index->resolve(r);
+}
+
+void AssignExpr::resolve(Resolver& r) {
+    value->resolve(r);
+    r.resolveName(name.symbol, depth, slot);
+}
+
+void IndexAssignExpr::resolve(Resolver& r) {
+    object->resolve(r);
+    index->resolve(r);
+    value->resolve(r);
+}
+
+void MemberAssignExpr::resolve(Resolver& r) {
+    object->resolve(r);
+    value->resolve(r);
+}
+
+void NamedArgExpr::resolve(Resolver& r) { value->resolve(r); }
+
+void DictExpr::resolve(Resolver& r) {
+    for (const auto& entry : entries) {
+        entry.first->resolve(r);
+        entry.second->resolve(r);
+    }
+}
+
+// =================== Statements ===================
+
+void VarDecl::resolve(Resolver& r) {
+    // The initializer still sees an outer variable of the same name
+    if (initializer) initializer->resolve(r);
+    slot = r.declare(name.symbol);
+}
+
+void AssembleStmt::resolve(Resolver& r) { expr->resolve(r); }
+
+void PrintStmt::resolve(Resolver& r) { expr->resolve(r); }
+
+void SummonStmt::resolve(Resolver& r) { message->resolve(r); }
+
+void ExprStmt::resolve(Resolver& r) { expr->resolve(r); }
+
+void IfStmt::resolve(Resolver& r) {
+    condition->resolve(r);
+    thenBranch->resolve(r);
+    if (elseBranch) elseBranch->resolve(r);
+}
+
+void BlockStmt::resolve(Resolver& r) {
+    r.beginScope();
+    for (const auto& stmt : statements) stmt->resolve(r);
+    scope = r.endScope();
+}
+
+void FunDecl::resolve(Resolver& r) {
+    // Declared before the body so the function can call itself
+    slot = r.declare(name.symbol);
+    r.captureScopes();
+    // Parameters and the body's locals share one frame: slots 0..n-1 are the parameters
+    r.beginScope();
+    for (const auto& param : params) r.declare(param.symbol);
+    for (const auto& stmt : body->statements) stmt->resolve(r);
+    body->scope = r.endScope();
+}
+
+void ReturnStmt::resolve(Resolver& r) {
+    if (value) value->resolve(r);
+}
+
+void WhileStmt::resolve(Resolver& r) {
+    condition->resolve(r);
+    body->resolve(r);
+}
+
+void ForStmt::resolve(Resolver& r) {
+    // The initializer belongs to the enclosing scope, as in ForStmt::execute
+    if (initializer) initializer->resolve(r);
+    if (condition) condition->resolve(r);
+    if (increment) increment->resolve(r);
+    body->resolve(r);
+}
+
+void BreakStmt::resolve(Resolver&) {}
+void ContinueStmt::resolve(Resolver&) {}
+
+void TryCatchStmt::resolve(Resolver& r) {
+    tryBlock->resolve(r);
+    r.beginScope();
+    if (hasCatchVar) r.declare(catchVar.symbol);
+    catchBlock->resolve(r);
+    catchScope = r.endScope();
+}
+
+// Imported files are resolved on their own when the import runs
+void ImportStmt::resolve(Resolver&) {}
+
+void ForInStmt::resolve(Resolver& r) {
+    iterable->resolve(r);
+    r.beginScope();
+    r.declare(varName.symbol);
+    body->resolve(r);
+    scope = r.endScope();
+}
+
+void AssertStmt::resolve(Resolver& r) { condition->resolve(r); }
+
+void TestStmt::resolve(Resolver& r) { body->resolve(r); }
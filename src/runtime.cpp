@@ -0,0 +1,481 @@
+#include "../include/runtime.h"
+#include "../include/array_math.h"
+#include "../include/interpreter.h"
+#include "../include/stdlib_ml.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static SatanValue callValue(const SatanValue& fn, std::vector<SatanValue> args, const FunctionInvoker& invoke) {
+    if (fn.isNativeFn()) return (*fn.nativeFn())(std::move(args));
+    return invoke(fn, std::move(args));
+}
+
+SatanValue binaryOp(TokenType op, const SatanValue& l, const SatanValue& r) {
+    if ((l.isArray() || r.isArray()) && (l.isArray() || l.isNumber()) && (r.isArray() || r.isNumber()) &&
+        isElementwise(op)) {
+        return elementwise(op, l, r);
+    }
+    switch (op) {
+        case TokenType::PLUS:
+            if (l.isNumber() && r.isNumber()) return SatanValue(l.number + r.number);
+            return SatanValue(l.toString() + r.toString());
+        case TokenType::MINUS: return SatanValue(l.asNumber() - r.asNumber());
+        case TokenType::STAR:  return SatanValue(l.asNumber() * r.asNumber());
+        case TokenType::SLASH:
+            if (r.asNumber() == 0) throw std::runtime_error("Division by zero.");
+            return SatanValue(l.asNumber() / r.asNumber());
+        case TokenType::PERCENT:
+            if (r.asNumber() == 0) throw std::runtime_error("Modulo by zero.");
+            return SatanValue(std::fmod(l.asNumber(), r.asNumber()));
+        case TokenType::GREATER:       return SatanValue(l.asNumber() > r.asNumber());
+        case TokenType::GREATER_EQUAL: return SatanValue(l.asNumber() >= r.asNumber());
+        case TokenType::LESS:          return SatanValue(l.asNumber() < r.asNumber());
+        case TokenType::LESS_EQUAL:    return SatanValue(l.asNumber() <= r.asNumber());
+        case TokenType::EQUAL_EQUAL:
+            if (l.type != r.type) return SatanValue(false);
+            if (l.isNumber()) return SatanValue(l.number == r.number);
+            if (l.isString()) return SatanValue(l.str() == r.str());
+            if (l.isBoolean()) return SatanValue(l.boolean == r.boolean);
+            return SatanValue(false);
+        case TokenType::BANG_EQUAL:
+            if (l.type != r.type) return SatanValue(true);
+            if (l.isNumber()) return SatanValue(l.number != r.number);
+            if (l.isString()) return SatanValue(l.str() != r.str());
+            if (l.isBoolean()) return SatanValue(l.boolean != r.boolean);
+            return SatanValue(true);
+        default:
+            throw std::runtime_error("Unknown binary operator.");
+    }
+}
+
+SatanValue getMember(const SatanValue& obj, Symbol name) {
+    // For ML objects, use the property handler
+    if (obj.isObject()) {
+        if (obj.object()->find(SYM_TYPE) && Interpreter::current) {
+            return handlePropertyAccess(obj, symbolName(name), Interpreter::current->getBridge());
+        }
+        return obj.getProperty(name);
+    }
+    if (obj.isArray() && name == SYM_LENGTH) {
+        return SatanValue(static_cast<double>(obj.array()->size()));
+    }
+    if (obj.isString() && name == SYM_LENGTH) {
+        return SatanValue(static_cast<double>(obj.str().size()));
+    }
+    return obj.getProperty(name);
+}
+
+SatanValue getIndex(const SatanValue& obj, const SatanValue& idx) {
+    if (obj.isArray() && idx.isNumber()) {
+        int i = static_cast<int>(idx.number);
+        const SatanArray& arr = *obj.array();
+        if (i < 0 || i >= (int)arr.size())
+            throw std::runtime_error("Array index out of bounds: " + std::to_string(i));
+        return arr.get(i);
+    }
+    if (obj.isString() && idx.isNumber()) {
+        int i = static_cast<int>(idx.number);
+        if (i < 0 || i >= (int)obj.str().size())
+            throw std::runtime_error("String index out of bounds: " + std::to_string(i));
+        return SatanValue(std::string(1, obj.str()[i]));
+    }
+    if (obj.isObject() && idx.isString()) {
+        return obj.getProperty(idx.str());
+    }
+    throw std::runtime_error("Cannot index " + obj.toString());
+}
+
+void compoundAssign(TokenType op, SatanValue& target, const SatanValue& value) {
+    if (target.isNumber() && value.isNumber()) {
+        switch (op) {
+            case TokenType::PLUS: target.number += value.number; return;
+            case TokenType::MINUS: target.number -= value.number; return;
+            case TokenType::STAR: target.number *= value.number; return;
+            case TokenType::SLASH:
+                if (value.number == 0) break;   // binaryOp reports it
+                target.number /= value.number;
+                return;
+            default: break;
+        }
+    }
+    target = binaryOp(op, target, value);
+}
+
+static void store(TokenType op, SatanValue& target, const SatanValue& value) {
+    if (op == TokenType::EQUAL) target = value;
+    else compoundAssign(op, target, value);
+}
+
+// A compound assignment to a missing key starts from 0, or from "" when
+// += adds a string, so `counts[w] += 1` counts; if it fails the key is not
+// left behind
+template <typename Key>
+static SatanValue storeEntry(ObjectMap& entries, Key key, TokenType op, const SatanValue& value) {
+    bool added;
+    SatanValue& entry = entries.emplace(key, added);
+    try {
+        if (added && op != TokenType::EQUAL) {
+            entry = op == TokenType::PLUS && value.isString() ? SatanValue(std::string()) : SatanValue(0.0);
+        }
+        store(op, entry, value);
+    } catch (...) {
+        if (added) entries.erase(key);
+        throw;
+    }
+    return entry;
+}
+
+SatanValue setIndex(const SatanValue& obj, const SatanValue& idx, TokenType op, const SatanValue& value) {
+    if (obj.isArray() && idx.isNumber()) {
+        int i = static_cast<int>(idx.number);
+        SatanArray& arr = *obj.array();
+        if (i < 0 || i >= (int)arr.size())
+            throw std::runtime_error("Array index out of bounds: " + std::to_string(i));
+        if ((arr.isPacked() || arr.isRange()) && value.isNumber()) {
+            // Stays packed unless the operator produces something else
+            SatanValue element = arr.get(i);
+            store(op, element, value);
+            arr.set(i, element);
+            return element;
+        }
+        SatanValue& element = arr.values()[i];
+        store(op, element, value);
+        return element;
+    }
+    if (obj.isObject() && idx.isString()) {
+        return storeEntry(*obj.object(), std::string_view(idx.str()), op, value);
+    }
+    if (obj.isString()) throw std::runtime_error("Cannot assign to an index of a string.");
+    throw std::runtime_error("Cannot index " + obj.toString());
+}
+
+SatanValue setMember(const SatanValue& obj, Symbol name, TokenType op, const SatanValue& value) {
+    if (!obj.isObject())
+        throw std::runtime_error("Cannot set property '" + symbolName(name) + "' on " + obj.toString());
+    return storeEntry(*obj.object(), name, op, value);
+}
+
+// What callMethod reports when no built-in or ML method applies
+static std::runtime_error noSuchMethod(const SatanValue& obj, Symbol method) {
+    return std::runtime_error("Cannot call method '" + symbolName(method) + "' on " + obj.toString());
+}
+
+// Array and string methods compare elements by number or string value only
+static bool sameElement(const SatanValue& a, const SatanValue& b) {
+    if (a.type != b.type) return false;
+    return (a.isNumber() && a.number == b.number) || (a.isString() && a.str() == b.str());
+}
+
+namespace {
+
+// =================== Array methods ===================
+
+SatanValue arrayPush(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    obj.array()->push(args[0]);
+    return SatanValue();
+}
+
+SatanValue arrayPop(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    if (obj.array()->empty()) throw noSuchMethod(obj, SYM_POP);
+    return obj.array()->pop();
+}
+
+SatanValue arraySize(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    return SatanValue(static_cast<double>(obj.array()->size()));
+}
+
+// The callbacks below may change the array, so it is walked by index
+SatanValue arrayMap(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker& invoke) {
+    if (!args[0].isCallable()) throw noSuchMethod(obj, SYM_MAP);
+    const SatanArray& arr = *obj.array();
+    std::vector<SatanValue> result;
+    result.reserve(arr.size());
+    for (size_t i = 0; i < arr.size(); i++) {
+        result.push_back(callValue(args[0], {arr.get(i)}, invoke));
+    }
+    return SatanValue::makeArray(std::move(result));
+}
+
+SatanValue arrayFilter(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker& invoke) {
+    if (!args[0].isCallable()) throw noSuchMethod(obj, SYM_FILTER);
+    const SatanArray& arr = *obj.array();
+    std::vector<SatanValue> result;
+    for (size_t i = 0; i < arr.size(); i++) {
+        SatanValue elem = arr.get(i);
+        if (callValue(args[0], {elem}, invoke).isTruthy()) result.push_back(std::move(elem));
+    }
+    return SatanValue::makeArray(std::move(result));
+}
+
+SatanValue arrayForEach(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker& invoke) {
+    if (!args[0].isCallable()) throw noSuchMethod(obj, SYM_FOR_EACH);
+    const SatanArray& arr = *obj.array();
+    for (size_t i = 0; i < arr.size(); i++) {
+        callValue(args[0], {arr.get(i)}, invoke);
+    }
+    return SatanValue();
+}
+
+SatanValue arrayJoin(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    std::string delim = args.empty() ? ", " : args[0].toString();
+    std::string result;
+    bool first = true;
+    obj.array()->forEach([&](const SatanValue& elem) {
+        if (!first) result += delim;
+        first = false;
+        result += elem.toString();
+    });
+    return SatanValue(result);
+}
+
+SatanValue arrayIndexOf(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    const SatanArray& arr = *obj.array();
+    if (arr.isRange()) {
+        // The element would be at (x - start) / step, if that is a whole index
+        if (!args[0].isNumber() || arr.empty()) return SatanValue(-1.0);
+        const NumberRange& range = arr.range();
+        double i = (args[0].number - range.start) / range.step;
+        bool found = i >= 0 && i < static_cast<double>(range.count) && i == std::floor(i);
+        return SatanValue(found ? static_cast<double>(static_cast<size_t>(i)) : -1.0);
+    }
+    if (arr.isPacked()) {
+        if (!args[0].isNumber()) return SatanValue(-1.0);
+        const std::vector<double>& nums = arr.packedNumbers();
+        auto it = std::find(nums.begin(), nums.end(), args[0].number);
+        return SatanValue(it == nums.end() ? -1.0 : static_cast<double>(it - nums.begin()));
+    }
+    for (size_t i = 0; i < arr.size(); i++) {
+        if (sameElement(arr.get(i), args[0])) return SatanValue(static_cast<double>(i));
+    }
+    return SatanValue(-1.0);
+}
+
+SatanValue arrayContains(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker& invoke) {
+    return SatanValue(arrayIndexOf(obj, args, invoke).number >= 0);
+}
+
+// reverse, slice and sort of a range are ranges too
+NumberRange reversed(const NumberRange& range) {
+    if (range.count == 0) return range;
+    return {range.at(range.count - 1), -range.step, range.count};
+}
+
+SatanValue arrayReverse(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    SatanArray& arr = *obj.array();
+    if (arr.isRange()) return SatanValue::makeRange(reversed(arr.range()));
+    if (arr.isPacked()) {
+        const std::vector<double>& nums = arr.packedNumbers();
+        return SatanValue::makeArray(std::vector<double>(nums.rbegin(), nums.rend()));
+    }
+    const std::vector<SatanValue>& elems = arr.values();
+    return SatanValue::makeArray(std::vector<SatanValue>(elems.rbegin(), elems.rend()));
+}
+
+SatanValue arraySlice(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    SatanArray& arr = *obj.array();
+    int start = args.size() > 0 ? (int)args[0].asNumber() : 0;
+    int end = args.size() > 1 ? (int)args[1].asNumber() : (int)arr.size();
+    if (start < 0) start = 0;
+    if (end > (int)arr.size()) end = (int)arr.size();
+    if (end < start) end = start;
+    if (arr.isRange()) {
+        const NumberRange& range = arr.range();
+        return SatanValue::makeRange({range.at(start), range.step, static_cast<size_t>(end - start)});
+    }
+    if (arr.isPacked()) {
+        const std::vector<double>& nums = arr.packedNumbers();
+        return SatanValue::makeArray(std::vector<double>(nums.begin() + start, nums.begin() + end));
+    }
+    const std::vector<SatanValue>& elems = arr.values();
+    return SatanValue::makeArray(std::vector<SatanValue>(elems.begin() + start, elems.begin() + end));
+}
+
+SatanValue arraySort(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    SatanArray& arr = *obj.array();
+    if (arr.isRange()) {
+        const NumberRange& range = arr.range();
+        return SatanValue::makeRange(range.step < 0 ? reversed(range) : range);
+    }
+    if (arr.isPacked()) {
+        std::vector<double> sorted = arr.packedNumbers();
+        std::sort(sorted.begin(), sorted.end());
+        return SatanValue::makeArray(std::move(sorted));
+    }
+    std::vector<SatanValue> sorted = arr.values();
+    std::sort(sorted.begin(), sorted.end(), [](const SatanValue& a, const SatanValue& b) {
+        if (a.isNumber() && b.isNumber()) return a.number < b.number;
+        return a.toString() < b.toString();
+    });
+    return SatanValue::makeArray(std::move(sorted));
+}
+
+// =================== String methods ===================
+
+SatanValue stringUpper(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    std::string s = obj.str();
+    for (auto& c : s) c = toupper(c);
+    return SatanValue(s);
+}
+
+SatanValue stringLower(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    std::string s = obj.str();
+    for (auto& c : s) c = tolower(c);
+    return SatanValue(s);
+}
+
+SatanValue stringSplit(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    std::string delim = args.empty() ? " " : args[0].toString();
+    std::vector<SatanValue> parts;
+    size_t pos = 0; std::string s = obj.str();
+    while ((pos = s.find(delim)) != std::string::npos) {
+        parts.push_back(SatanValue(s.substr(0, pos)));
+        s.erase(0, pos + delim.length());
+    }
+    parts.push_back(SatanValue(s));
+    return SatanValue::makeArray(std::move(parts));
+}
+
+SatanValue stringTrim(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    std::string s = obj.str();
+    s.erase(0, s.find_first_not_of(" \t\n\r"));
+    s.erase(s.find_last_not_of(" \t\n\r") + 1);
+    return SatanValue(s);
+}
+
+SatanValue stringReplace(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    if (args.size() < 2) throw std::runtime_error("replace() requires 2 arguments.");
+    std::string s = obj.str();
+    std::string from = args[0].toString(), to = args[1].toString();
+    size_t pos = 0;
+    while ((pos = s.find(from, pos)) != std::string::npos) {
+        s.replace(pos, from.length(), to);
+        pos += to.length();
+    }
+    return SatanValue(s);
+}
+
+SatanValue stringStartsWith(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    return SatanValue(obj.str().substr(0, args[0].str().size()) == args[0].str());
+}
+
+SatanValue stringEndsWith(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    if (args[0].str().size() > obj.str().size()) return SatanValue(false);
+    return SatanValue(obj.str().substr(obj.str().size() - args[0].str().size()) == args[0].str());
+}
+
+SatanValue stringCharAt(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    int idx = (int)args[0].asNumber();
+    if (idx >= 0 && idx < (int)obj.str().size()) return SatanValue(std::string(1, obj.str()[idx]));
+    return SatanValue(std::string(""));
+}
+
+SatanValue stringIncludes(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    return SatanValue(obj.str().find(args[0].toString()) != std::string::npos);
+}
+
+SatanValue stringSubstring(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    int start = args.size() > 0 ? (int)args[0].asNumber() : 0;
+    int len = args.size() > 1 ? (int)args[1].asNumber() : (int)obj.str().size() - start;
+    return SatanValue(obj.str().substr(start, len));
+}
+
+SatanValue stringRepeat(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    int count = args.size() > 0 ? (int)args[0].asNumber() : 1;
+    std::string result;
+    for (int i = 0; i < count; i++) result += obj.str();
+    return SatanValue(result);
+}
+
+// =================== Object/Dictionary methods ===================
+
+SatanValue objectKeys(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    std::vector<SatanValue> keys;
+    obj.object()->forEach([&](const std::string& name, const SatanValue&) {
+        if (!isInternalName(name)) keys.push_back(SatanValue(name));
+    });
+    return SatanValue::makeArray(std::move(keys));
+}
+
+SatanValue objectValues(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    std::vector<SatanValue> vals;
+    obj.object()->forEach([&](const std::string& name, const SatanValue& value) {
+        if (!isInternalName(name)) vals.push_back(value);
+    });
+    return SatanValue::makeArray(std::move(vals));
+}
+
+SatanValue objectHas(const SatanValue& obj, std::vector<SatanValue>& args, const FunctionInvoker&) {
+    std::string key = args[0].toString();
+    return SatanValue(obj.object()->find(std::string_view(key)) != nullptr);
+}
+
+SatanValue objectSize(const SatanValue& obj, std::vector<SatanValue>&, const FunctionInvoker&) {
+    int count = 0;
+    obj.object()->forEach([&](const std::string& name, const SatanValue&) {
+        if (!isInternalName(name)) count++;
+    });
+    return SatanValue(static_cast<double>(count));
+}
+
+}
+
+MethodHandler findMethod(ValueType type, Symbol method, size_t argc) {
+    if (type == ValueType::ARRAY) {
+        switch (method) {
+            case SYM_PUSH: return argc == 1 ? arrayPush : nullptr;
+            case SYM_POP: return arrayPop;
+            case SYM_SIZE:
+            case SYM_LENGTH: return arraySize;
+            case SYM_MAP: return argc == 1 ? arrayMap : nullptr;
+            case SYM_FILTER: return argc == 1 ? arrayFilter : nullptr;
+            case SYM_FOR_EACH: return argc == 1 ? arrayForEach : nullptr;
+            case SYM_JOIN: return arrayJoin;
+            case SYM_INDEX_OF: return argc == 1 ? arrayIndexOf : nullptr;
+            case SYM_CONTAINS: return argc == 1 ? arrayContains : nullptr;
+            case SYM_REVERSE: return arrayReverse;
+            case SYM_SLICE: return arraySlice;
+            case SYM_SORT: return arraySort;
+            default: return nullptr;
+        }
+    }
+    if (type == ValueType::STRING) {
+        switch (method) {
+            case SYM_UPPER: return stringUpper;
+            case SYM_LOWER: return stringLower;
+            case SYM_SPLIT: return stringSplit;
+            case SYM_TRIM: return stringTrim;
+            case SYM_REPLACE: return stringReplace;
+            case SYM_STARTS_WITH: return argc == 1 ? stringStartsWith : nullptr;
+            case SYM_ENDS_WITH: return argc == 1 ? stringEndsWith : nullptr;
+            case SYM_CHAR_AT: return argc == 1 ? stringCharAt : nullptr;
+            case SYM_INCLUDES:
+            case SYM_CONTAINS: return stringIncludes;
+            case SYM_SUBSTRING: return stringSubstring;
+            case SYM_REPEAT: return stringRepeat;
+            default: return nullptr;
+        }
+    }
+    if (type == ValueType::OBJECT) {
+        switch (method) {
+            case SYM_KEYS: return objectKeys;
+            case SYM_VALUES: return objectValues;
+            case SYM_HAS: return argc == 1 ? objectHas : nullptr;
+            case SYM_SIZE: return objectSize;
+            default: return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+SatanValue callMethod(const SatanValue& obj, Symbol method,
+                      std::vector<SatanValue>& args, const FunctionInvoker& invoke) {
+    if (MethodHandler handler = findMethod(obj.type, method, args.size())) return handler(obj, args, invoke);
+
+    // For ML objects, delegate to the ML handler
+    if (obj.isObject() && Interpreter::current) {
+        return handleMethodCall(obj, symbolName(method), args, Interpreter::current->getBridge());
+    }
+
+    throw noSuchMethod(obj, method);
+}
@@ -13,7 +13,7 @@ void printVersion() {
  |____/_/   \_\_/_/   \_\_| \_|
     )" << std::endl;
     std::cout << "\033[0m";
-    std::cout << "\033[1;36m Satan Programming Language v2.0.0\033[0m" << std::endl;
+    std::cout << "\033[1;36m Satan Programming Language v" << SATAN_VERSION << "\033[0m" << std::endl;
     std::cout << "\033[90m Built for AI/ML/DL/NLP/Data Science\033[0m" << std::endl;
     std::cout << std::endl;
     std::cout << " Modules:" << std::endl;
@@ -1,5 +1,6 @@
 #include "../include/stdlib_ml.h"
 #include "../include/interpreter.h"
+#include "../include/dataframe.h"
 #include <iostream>
 #include <algorithm>
 
@@ -7,10 +8,9 @@
 static std::string getNamedArg(const std::vector<SatanValue>& args, const std::string& name, const std::string& defaultVal) {
     for (const auto& arg : args) {
         if (arg.isObject()) {
-            auto nameIt = arg.object->find("__named_key__");
-            if (nameIt != arg.object->end() && nameIt->second.str == name) {
-                auto valIt = arg.object->find("__named_value__");
-                if (valIt != arg.object->end()) return valIt->second.toString();
+            const SatanValue* key = arg.object()->find(SYM_NAMED_KEY);
+            if (key && key->str() == name) {
+                if (const SatanValue* value = arg.object()->find(SYM_NAMED_VALUE)) return value->toString();
             }
         }
     }
@@ -29,6 +29,48 @@ static double getNamedArgDouble(const std::vector<SatanValue>& args, const std::
     try { return std::stod(val); } catch (...) { return defaultVal; }
 }
 
+// Prints "Shape: (rows, cols)" like pandas and returns [rows, cols]
+static SatanValue nativeShape(const DataFrame& frame) {
+    std::cout << "Shape: (" << frame.rowCount() << ", " << frame.columnCount() << ")" << std::endl;
+    return SatanValue::makeArray(std::vector<double>{(double)frame.rowCount(), (double)frame.columnCount()});
+}
+
+// .shape or .columns of a frame with pending steps: runs `code`, which
+// prints a JSON list after the result marker, echoes the rest of its output
+// and returns the list as an array, as the native path does
+static SatanValue frameListQuery(PythonBridge& bridge, const std::string& code) {
+    std::string out = bridge.executeImmediate(code);
+    std::cout << bridge.withoutResult(out);
+    return bridge.parseListResult(out);
+}
+
+// The integers from start towards end (exclusive), step apart; step is not 0.
+// Kept lazy, so range(10000000) costs no more than range(10).
+static NumberRange integerRange(int start, int end, int step) {
+    long long span = step > 0 ? (long long)end - start : (long long)start - end;
+    long long stride = step > 0 ? step : -(long long)step;
+    size_t count = span > 0 ? static_cast<size_t>((span + stride - 1) / stride) : 0;
+    return {static_cast<double>(start), static_cast<double>(step), count};
+}
+
+// min(array) / max(array): the smallest or largest element as a number
+static SatanValue arrayExtreme(const SatanArray& arr, bool largest) {
+    if (arr.empty()) throw std::runtime_error(std::string(largest ? "max" : "min") + "() of an empty array.");
+    if (arr.isRange()) {
+        const NumberRange& range = arr.range();
+        bool ascending = range.step > 0;
+        return SatanValue(range.at(largest == ascending ? range.count - 1 : 0));
+    }
+    if (arr.isPacked()) {
+        const std::vector<double>& nums = arr.packedNumbers();
+        return SatanValue(largest ? *std::max_element(nums.begin(), nums.end())
+                                  : *std::min_element(nums.begin(), nums.end()));
+    }
+    double m = arr.get(0).asNumber();
+    arr.forEach([&](const SatanValue& v) { m = largest ? std::max(m, v.asNumber()) : std::min(m, v.asNumber()); });
+    return SatanValue(m);
+}
+
 void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
     // =================== Data Science ===================
 
@@ -37,20 +79,18 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
         if (args.empty() || !args[0].isString())
             throw std::runtime_error("load_csv() expects a string filepath argument.");
 
-        if (!bridge.checkPython())
-            throw std::runtime_error("Python not found! Run 'satan --setup-ml' to configure.");
-
-        std::string filepath = args[0].str;
+        // Parsed natively; pandas only loads the file once an operation needs it
+        std::string filepath = args[0].str();
         std::string pyVar = bridge.newPyVar();
-        std::string code = bridge.genLoadCSV(pyVar, filepath);
-        std::string output = bridge.executeImmediate(code);
-        std::cout << output;
+        auto frame = bridge.frames().open(filepath);
+        std::cout << "Loaded " << frame->rowCount() << " rows x " << frame->columnCount() << " columns" << std::endl;
+        std::cout << "Columns: " << frame->formatColumnList() << std::endl;
 
         // Create ML object
         SatanValue obj = SatanValue::makeObject();
-        obj.setProperty("__type__", SatanValue(std::string("DataFrame")));
-        obj.setProperty("__pyvar__", SatanValue(pyVar));
-        obj.setProperty("__source__", SatanValue(filepath));
+        obj.setProperty(SYM_TYPE, SatanValue(std::string("DataFrame")));
+        obj.setProperty(SYM_PYVAR, SatanValue(pyVar));
+        obj.setProperty(SYM_SOURCE, SatanValue(filepath));
         return obj;
     }));
 
@@ -73,13 +113,13 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
             }
 
             SatanValue obj = SatanValue::makeObject();
-            obj.setProperty("__type__", SatanValue(modelType));
-            obj.setProperty("__pyvar__", SatanValue(pyVar));
-            obj.setProperty("__kwargs__", SatanValue(std::string("")));
-            obj.setProperty("__fitted__", SatanValue(false));
+            obj.setProperty(SYM_TYPE, SatanValue(modelType));
+            obj.setProperty(SYM_PYVAR, SatanValue(pyVar));
+            obj.setProperty(SYM_KWARGS, SatanValue(std::string("")));
+            obj.setProperty(SYM_FITTED, SatanValue(false));
 
             std::string code = bridge.genCreateModel(pyVar, modelType, kwargs);
-            obj.setProperty("__create_code__", SatanValue(code));
+            obj.setProperty(SYM_CREATE_CODE, SatanValue(code));
 
             std::cout << "Created " << modelType << " model" << std::endl;
             return obj;
@@ -104,9 +144,9 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
     env.define("NeuralNet", SatanValue::makeNativeFn([&bridge](std::vector<SatanValue> args) -> SatanValue {
         std::vector<int> layers;
         if (!args.empty() && args[0].isArray()) {
-            for (const auto& elem : *args[0].array) {
+            args[0].array()->forEach([&](const SatanValue& elem) {
                 layers.push_back(static_cast<int>(elem.asNumber()));
-            }
+            });
         } else {
             // Default network
             layers = {784, 128, 64, 10};
@@ -114,9 +154,9 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
 
         std::string pyVar = bridge.newPyVar();
         SatanValue obj = SatanValue::makeObject();
-        obj.setProperty("__type__", SatanValue(std::string("NeuralNet")));
-        obj.setProperty("__pyvar__", SatanValue(pyVar));
-        obj.setProperty("__fitted__", SatanValue(false));
+        obj.setProperty(SYM_TYPE, SatanValue(std::string("NeuralNet")));
+        obj.setProperty(SYM_PYVAR, SatanValue(pyVar));
+        obj.setProperty(SYM_FITTED, SatanValue(false));
 
         std::string layerStr = "[";
         for (size_t i = 0; i < layers.size(); i++) {
@@ -124,10 +164,10 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
             layerStr += std::to_string(layers[i]);
         }
         layerStr += "]";
-        obj.setProperty("__layers__", SatanValue(layerStr));
+        obj.setProperty(SYM_LAYERS, SatanValue(layerStr));
 
         std::string code = bridge.genNeuralNet(pyVar, layers);
-        obj.setProperty("__create_code__", SatanValue(code));
+        obj.setProperty(SYM_CREATE_CODE, SatanValue(code));
 
         std::cout << "Created NeuralNet " << layerStr << std::endl;
         return obj;
@@ -204,8 +244,8 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
     // len(array_or_string)
     env.define("len", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.empty()) return SatanValue(0.0);
-        if (args[0].isArray()) return SatanValue(static_cast<double>(args[0].array->size()));
-        if (args[0].isString()) return SatanValue(static_cast<double>(args[0].str.size()));
+        if (args[0].isArray()) return SatanValue(static_cast<double>(args[0].array()->size()));
+        if (args[0].isString()) return SatanValue(static_cast<double>(args[0].str().size()));
         return SatanValue(0.0);
     }));
 
@@ -219,8 +259,8 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
             case ValueType::BOOLEAN: return SatanValue(std::string("boolean"));
             case ValueType::ARRAY: return SatanValue(std::string("array"));
             case ValueType::OBJECT: {
-                auto prop = args[0].getProperty("__type__");
-                if (!prop.isNil()) return SatanValue(prop.str);
+                auto prop = args[0].getProperty(SYM_TYPE);
+                if (!prop.isNil()) return SatanValue(prop.str());
                 return SatanValue(std::string("object"));
             }
             case ValueType::NATIVE_FN: return SatanValue(std::string("function"));
@@ -234,9 +274,7 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
         int start = 0, end = 0;
         if (args.size() == 1) { end = (int)args[0].asNumber(); }
         else if (args.size() >= 2) { start = (int)args[0].asNumber(); end = (int)args[1].asNumber(); }
-        std::vector<SatanValue> result;
-        for (int i = start; i < end; i++) result.push_back(SatanValue((double)i));
-        return SatanValue::makeArray(std::move(result));
+        return SatanValue::makeRange(integerRange(start, end, 1));
     }));
 
     // abs, sqrt, pow, round, min, max
@@ -254,20 +292,12 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
     }));
     env.define("min", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.size() >= 2) return SatanValue(std::min(args[0].asNumber(), args[1].asNumber()));
-        if (args[0].isArray()) {
-            double m = (*args[0].array)[0].asNumber();
-            for (auto& v : *args[0].array) m = std::min(m, v.asNumber());
-            return SatanValue(m);
-        }
+        if (args[0].isArray()) return arrayExtreme(*args[0].array(), false);
         return args[0];
     }));
     env.define("max", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.size() >= 2) return SatanValue(std::max(args[0].asNumber(), args[1].asNumber()));
-        if (args[0].isArray()) {
-            double m = (*args[0].array)[0].asNumber();
-            for (auto& v : *args[0].array) m = std::max(m, v.asNumber());
-            return SatanValue(m);
-        }
+        if (args[0].isArray()) return arrayExtreme(*args[0].array(), true);
         return args[0];
     }));
 
@@ -283,37 +313,39 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
     env.define("load_model", SatanValue::makeNativeFn([&bridge](std::vector<SatanValue> args) -> SatanValue {
         if (args.empty() || !args[0].isString())
             throw std::runtime_error("load_model() expects a filepath string.");
-        std::string filepath = args[0].str;
+        std::string filepath = args[0].str();
         std::string newVar = bridge.newPyVar();
         std::string code = bridge.genLoadModel(filepath, newVar);
         std::string output = bridge.executeImmediate(code);
         std::cout << output;
         SatanValue obj = SatanValue::makeObject();
-        obj.setProperty("__type__", SatanValue(std::string("RandomForest")));
-        obj.setProperty("__pyvar__", SatanValue(newVar));
-        obj.setProperty("__create_code__", SatanValue(std::string("")));
-        obj.setProperty("__fitted__", SatanValue(true));
+        obj.setProperty(SYM_TYPE, SatanValue(std::string("RandomForest")));
+        obj.setProperty(SYM_PYVAR, SatanValue(newVar));
+        obj.setProperty(SYM_CREATE_CODE, SatanValue(std::string("")));
+        obj.setProperty(SYM_FITTED, SatanValue(true));
         return obj;
     }));
 
     // =================== Feature 6: AutoML ===================
     SatanValue automlObj = SatanValue::makeObject();
-    automlObj.setProperty("__type__", SatanValue(std::string("AutoML")));
-    automlObj.setProperty("__find_best__", SatanValue::makeNativeFn([&bridge](std::vector<SatanValue> args) -> SatanValue {
+    automlObj.setProperty(SYM_TYPE, SatanValue(std::string("AutoML")));
+    automlObj.setProperty(SYM_FIND_BEST, SatanValue::makeNativeFn([&bridge](std::vector<SatanValue> args) -> SatanValue {
         if (args.empty() || !args[0].isObject())
             throw std::runtime_error("AutoML.find_best() requires a DataFrame.");
-        std::string dataVar = args[0].getProperty("__pyvar__").str;
-        std::string dataSrc = args[0].getProperty("__source__").str;
+        std::string dataVar = args[0].getProperty(SYM_PYVAR).str();
+        std::string dataSrc = args[0].getProperty(SYM_SOURCE).str();
+        std::string dataSteps = args[0].getProperty(SYM_STEPS).str();
         std::string winnerVar = bridge.newPyVar();
-        std::string loadCode = bridge.genLoadCSV(dataVar, dataSrc);
+        PythonBridge::FrameStage stage(bridge);
+        std::string loadCode = bridge.genUseFrame(dataVar, dataSrc, dataSteps);
         std::string autoCode = bridge.genAutoML(dataVar, winnerVar);
         std::string output = bridge.executeImmediate(loadCode + autoCode);
         std::cout << output;
         SatanValue obj = SatanValue::makeObject();
-        obj.setProperty("__type__", SatanValue(std::string("RandomForest")));
-        obj.setProperty("__pyvar__", SatanValue(winnerVar));
-        obj.setProperty("__create_code__", SatanValue(std::string("")));
-        obj.setProperty("__fitted__", SatanValue(true));
+        obj.setProperty(SYM_TYPE, SatanValue(std::string("RandomForest")));
+        obj.setProperty(SYM_PYVAR, SatanValue(winnerVar));
+        obj.setProperty(SYM_CREATE_CODE, SatanValue(std::string("")));
+        obj.setProperty(SYM_FITTED, SatanValue(true));
         return obj;
     }));
     env.define("AutoML", automlObj);
@@ -321,16 +353,16 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
     // =================== Phase 1: Native File I/O ===================
     env.define("read_file", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.empty() || !args[0].isString()) throw std::runtime_error("read_file() expects a file path.");
-        std::ifstream file(args[0].str);
-        if (!file.is_open()) throw std::runtime_error("Cannot open file: " + args[0].str);
+        std::ifstream file(args[0].str());
+        if (!file.is_open()) throw std::runtime_error("Cannot open file: " + args[0].str());
         std::stringstream buf; buf << file.rdbuf();
         return SatanValue(buf.str());
     }));
 
     env.define("write_file", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.size() < 2) throw std::runtime_error("write_file(path, content) requires 2 arguments.");
-        std::ofstream file(args[0].str);
-        if (!file.is_open()) throw std::runtime_error("Cannot write to file: " + args[0].str);
+        std::ofstream file(args[0].str());
+        if (!file.is_open()) throw std::runtime_error("Cannot write to file: " + args[0].str());
         file << args[1].toString();
         file.close();
         return SatanValue(true);
@@ -338,8 +370,8 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
 
     env.define("append_file", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.size() < 2) throw std::runtime_error("append_file(path, content) requires 2 arguments.");
-        std::ofstream file(args[0].str, std::ios::app);
-        if (!file.is_open()) throw std::runtime_error("Cannot append to file: " + args[0].str);
+        std::ofstream file(args[0].str(), std::ios::app);
+        if (!file.is_open()) throw std::runtime_error("Cannot append to file: " + args[0].str());
         file << args[1].toString();
         file.close();
         return SatanValue(true);
@@ -347,16 +379,17 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
 
     env.define("file_exists", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.empty()) return SatanValue(false);
-        std::ifstream file(args[0].str);
+        std::ifstream file(args[0].str());
         return SatanValue(file.good());
     }));
 
     // =================== Phase 1: JSON Parse / Stringify ===================
     // Simple recursive JSON parser (handles objects, arrays, strings, numbers, booleans, null)
-    std::function<SatanValue(const std::string&, size_t&)> parseJsonValue;
-    auto skipWs = [](const std::string& s, size_t& i) { while (i < s.size() && isspace(s[i])) i++; };
+    // Static: the natives below call these long after this function returns
+    static std::function<SatanValue(const std::string&, size_t&)> parseJsonValue;
+    static auto skipWs = [](const std::string& s, size_t& i) { while (i < s.size() && isspace(s[i])) i++; };
 
-    parseJsonValue = [&parseJsonValue, &skipWs](const std::string& s, size_t& i) -> SatanValue {
+    parseJsonValue = [](const std::string& s, size_t& i) -> SatanValue {
         skipWs(s, i);
         if (i >= s.size()) return SatanValue();
 
@@ -394,7 +427,7 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
             i++;
             std::vector<SatanValue> arr;
             skipWs(s, i);
-            if (i < s.size() && s[i] == ']') { i++; return SatanValue::makeArray({}); }
+            if (i < s.size() && s[i] == ']') { i++; return SatanValue::makeArray(std::vector<SatanValue>{}); }
             while (i < s.size()) {
                 arr.push_back(parseJsonValue(s, i));
                 skipWs(s, i);
@@ -415,42 +448,53 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
         throw std::runtime_error("Invalid JSON at position " + std::to_string(i));
     };
 
-    env.define("json_parse", SatanValue::makeNativeFn([parseJsonValue](std::vector<SatanValue> args) mutable -> SatanValue {
+    env.define("json_parse", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.empty()) throw std::runtime_error("json_parse() expects a JSON string.");
         size_t i = 0;
         return parseJsonValue(args[0].toString(), i);
     }));
 
     // JSON stringify
-    std::function<std::string(const SatanValue&)> jsonStringify;
-    jsonStringify = [&jsonStringify](const SatanValue& val) -> std::string {
+    static std::function<std::string(const SatanValue&)> jsonStringify;
+    jsonStringify = [](const SatanValue& val) -> std::string {
         if (val.isNil()) return "null";
         if (val.isBoolean()) return val.boolean ? "true" : "false";
         if (val.isNumber()) { std::ostringstream o; o << val.number; return o.str(); }
-        if (val.isString()) return "\"" + val.str + "\"";
-        if (val.isArray() && val.array) {
+        if (val.isString()) return "\"" + val.str() + "\"";
+        if (val.isArray() && val.array()) {
+            const SatanArray& arr = *val.array();
             std::string r = "[";
-            for (size_t i = 0; i < val.array->size(); i++) {
+            if (arr.isPacked()) {
+                // Numbers only: format them in one stream, no per-element recursion
+                std::ostringstream o;
+                const std::vector<double>& nums = arr.packedNumbers();
+                for (size_t i = 0; i < nums.size(); i++) {
+                    if (i > 0) o << ",";
+                    o << nums[i];
+                }
+                return r + o.str() + "]";
+            }
+            for (size_t i = 0; i < arr.size(); i++) {
                 if (i > 0) r += ",";
-                r += jsonStringify((*val.array)[i]);
+                r += jsonStringify(arr.get(i));
             }
             return r + "]";
         }
-        if (val.isObject() && val.object) {
+        if (val.isObject() && val.object()) {
             std::string r = "{";
             bool first = true;
-            for (const auto& p : *val.object) {
-                if (p.first.size() >= 2 && p.first[0] == '_' && p.first[1] == '_') continue;
+            val.object()->forEach([&](const std::string& name, const SatanValue& value) {
+                if (isInternalName(name)) return;
                 if (!first) r += ",";
-                r += "\"" + p.first + "\":" + jsonStringify(p.second);
+                r += "\"" + name + "\":" + jsonStringify(value);
                 first = false;
-            }
+            });
             return r + "}";
         }
         return "null";
     };
 
-    env.define("json_stringify", SatanValue::makeNativeFn([jsonStringify](std::vector<SatanValue> args) -> SatanValue {
+    env.define("json_stringify", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.empty()) return SatanValue(std::string("null"));
         return SatanValue(jsonStringify(args[0]));
     }));
@@ -473,8 +517,8 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
 
     env.define("len", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
         if (args.empty()) return SatanValue(0.0);
-        if (args[0].isString()) return SatanValue(static_cast<double>(args[0].str.size()));
-        if (args[0].isArray()) return SatanValue(static_cast<double>(args[0].array ? args[0].array->size() : 0));
+        if (args[0].isString()) return SatanValue(static_cast<double>(args[0].str().size()));
+        if (args[0].isArray()) return SatanValue(static_cast<double>(args[0].array()->size()));
         return SatanValue(0.0);
     }));
 
@@ -483,10 +527,7 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
         if (args.size() == 1) { end = (int)args[0].asNumber(); }
         else if (args.size() >= 2) { start = (int)args[0].asNumber(); end = (int)args[1].asNumber(); }
         if (args.size() >= 3) { step = (int)args[2].asNumber(); if (step == 0) step = 1; }
-        std::vector<SatanValue> result;
-        if (step > 0) { for (int i = start; i < end; i += step) result.push_back(SatanValue(static_cast<double>(i))); }
-        else { for (int i = start; i > end; i += step) result.push_back(SatanValue(static_cast<double>(i))); }
-        return SatanValue::makeArray(std::move(result));
+        return SatanValue::makeRange(integerRange(start, end, step));
     }));
 
     // Math functions
@@ -510,10 +551,12 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
         return SatanValue(std::pow(args[0].asNumber(), args[1].asNumber()));
     }));
     env.define("max", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
+        if (args.size() == 1 && args[0].isArray()) return arrayExtreme(*args[0].array(), true);
         if (args.size() < 2) return args.empty() ? SatanValue(0.0) : args[0];
         return SatanValue(std::max(args[0].asNumber(), args[1].asNumber()));
     }));
     env.define("min", SatanValue::makeNativeFn([](std::vector<SatanValue> args) -> SatanValue {
+        if (args.size() == 1 && args[0].isArray()) return arrayExtreme(*args[0].array(), false);
         if (args.size() < 2) return args.empty() ? SatanValue(0.0) : args[0];
         return SatanValue(std::min(args[0].asNumber(), args[1].asNumber()));
     }));
@@ -529,10 +572,12 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
     // to_csv for DataFrames
     env.define("to_csv", SatanValue::makeNativeFn([&bridge](std::vector<SatanValue> args) -> SatanValue {
         if (args.size() < 2) throw std::runtime_error("to_csv(dataframe, path) requires 2 arguments.");
-        std::string pyVar = args[0].getProperty("__pyvar__").str;
-        std::string src = args[0].getProperty("__source__").str;
-        std::string outPath = args[1].str;
-        std::string code = bridge.genLoadCSV(pyVar, src);
+        std::string pyVar = args[0].getProperty(SYM_PYVAR).str();
+        std::string src = args[0].getProperty(SYM_SOURCE).str();
+        std::string steps = args[0].getProperty(SYM_STEPS).str();
+        std::string outPath = args[1].str();
+        PythonBridge::FrameStage stage(bridge);
+        std::string code = bridge.genUseFrame(pyVar, src, steps);
         code += pyVar + ".to_csv('" + outPath + "', index=False)\n";
         code += "print('__SATAN_RESULT__:done')\n";
         std::string output = bridge.executeImmediate(code);
@@ -545,35 +590,45 @@ void registerMLBuiltins(Environment& env, PythonBridge& bridge) {
 
 SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
                             const std::vector<SatanValue>& args, PythonBridge& bridge) {
-    std::string objType = object.getProperty("__type__").str;
-    std::string pyVar = object.getProperty("__pyvar__").str;
+    PythonBridge::FrameStage stage(bridge);
+    std::string objType = object.getProperty(SYM_TYPE).str();
+    std::string pyVar = object.getProperty(SYM_PYVAR).str();
 
     // DataFrame methods
     if (objType == "DataFrame") {
-        std::string src = object.getProperty("__source__").str;
+        std::string src = object.getProperty(SYM_SOURCE).str();
+        std::string steps = object.getProperty(SYM_STEPS).str();
+
+        // Cheap queries on an unmodified frame are answered by the native reader
+        if (steps.empty() && (method == "head" || method == "describe" || method == "shape")) {
+            auto frame = bridge.frames().open(src);
+            if (method == "shape") return nativeShape(*frame);
+            std::string out = method == "head"
+                ? frame->formatHead(args.empty() ? 5 : (size_t)std::max(0.0, args[0].asNumber()))
+                : frame->formatDescribe();
+            std::cout << out;
+            return SatanValue(out);
+        }
 
         if (method == "head") {
             int n = args.empty() ? 5 : (int)args[0].asNumber();
-            std::string code = bridge.genLoadCSV(pyVar, src) + bridge.genHead(pyVar, n);
+            std::string code = bridge.genUseFrame(pyVar, src, steps) + bridge.genHead(pyVar, n);
             std::string out = bridge.executeImmediate(code);
             std::cout << out;
             return SatanValue(out);
         }
         if (method == "describe") {
-            std::string code = bridge.genLoadCSV(pyVar, src) + bridge.genDescribe(pyVar);
+            std::string code = bridge.genUseFrame(pyVar, src, steps) + bridge.genDescribe(pyVar);
             std::string out = bridge.executeImmediate(code);
             std::cout << out;
             return SatanValue(out);
         }
         if (method == "shape") {
-            std::string code = bridge.genLoadCSV(pyVar, src) + bridge.genShape(pyVar);
-            std::string out = bridge.executeImmediate(code);
-            std::cout << out;
-            return bridge.parseResult(out);
+            return frameListQuery(bridge, bridge.genUseFrame(pyVar, src, steps) + bridge.genShape(pyVar));
         }
         if (method == "corr") {
             std::string plotPath = bridge.nextPlotPath();
-            std::string code = bridge.genLoadCSV(pyVar, src) + bridge.genCorrelation(pyVar, plotPath);
+            std::string code = bridge.genUseFrame(pyVar, src, steps) + bridge.genCorrelation(pyVar, plotPath);
             bridge.executeImmediate(code);
             std::cout << "\033[32m📊 Correlation heatmap saved to: " << plotPath << "\033[0m" << std::endl;
             #ifdef _WIN32
@@ -583,7 +638,7 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
         }
         if (method == "plot") {
             std::string plotPath = bridge.nextPlotPath();
-            std::string code = bridge.genLoadCSV(pyVar, src) + bridge.genPlotData(pyVar, plotPath);
+            std::string code = bridge.genUseFrame(pyVar, src, steps) + bridge.genPlotData(pyVar, plotPath);
             bridge.executeImmediate(code);
             std::cout << "\033[32m📊 Data plot saved to: " << plotPath << "\033[0m" << std::endl;
             #ifdef _WIN32
@@ -591,42 +646,17 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
             #endif
             return SatanValue(plotPath);
         }
-        // Feature 4: Data Preprocessing
-        if (method == "fill_missing") {
-            std::string code = bridge.genFillMissing(pyVar, src);
-            std::string out = bridge.executeImmediate(code);
-            std::cout << out;
-            SatanValue newDf = SatanValue::makeObject();
-            newDf.setProperty("__type__", SatanValue(std::string("DataFrame")));
-            newDf.setProperty("__pyvar__", SatanValue(pyVar));
-            newDf.setProperty("__source__", SatanValue(src));
-            return newDf;
-        }
-        if (method == "drop_nulls") {
-            std::string code = bridge.genDropNulls(pyVar, src);
-            std::string out = bridge.executeImmediate(code);
-            std::cout << out;
-            return bridge.parseResult(out);
-        }
-        if (method == "encode") {
-            std::string code = bridge.genEncodeText(pyVar, src);
-            std::string out = bridge.executeImmediate(code);
-            std::cout << out;
-            SatanValue newDf = SatanValue::makeObject();
-            newDf.setProperty("__type__", SatanValue(std::string("DataFrame")));
-            newDf.setProperty("__pyvar__", SatanValue(pyVar));
-            newDf.setProperty("__source__", SatanValue(src));
-            return newDf;
-        }
-        if (method == "normalize") {
-            std::string code = bridge.genNormalize(pyVar, src);
-            std::string out = bridge.executeImmediate(code);
-            std::cout << out;
-            SatanValue newDf = SatanValue::makeObject();
-            newDf.setProperty("__type__", SatanValue(std::string("DataFrame")));
-            newDf.setProperty("__pyvar__", SatanValue(pyVar));
-            newDf.setProperty("__source__", SatanValue(src));
-            return newDf;
+        // Feature 4: Data Preprocessing. Each step returns a new DataFrame that
+        // records it after the receiver's steps, leaving the receiver as it
+        // was; the steps are fused into a single pass by the next operation
+        // that needs the data.
+        if (method == "fill_missing" || method == "drop_nulls" ||
+            method == "encode" || method == "normalize") {
+            SatanValue df = SatanValue::makeObject();
+            *df.object() = *object.object();
+            df.setProperty(SYM_PYVAR, SatanValue(bridge.newPyVar()));
+            df.setProperty(SYM_STEPS, SatanValue(steps.empty() ? method : steps + "," + method));
+            return df;
         }
     }
 
@@ -642,14 +672,16 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
             // First arg should be a DataFrame
             std::string dataVar = "";
             std::string dataSrc = "";
+            std::string dataSteps = "";
             if (args[0].isObject()) {
-                dataVar = args[0].getProperty("__pyvar__").str;
-                dataSrc = args[0].getProperty("__source__").str;
+                dataVar = args[0].getProperty(SYM_PYVAR).str();
+                dataSrc = args[0].getProperty(SYM_SOURCE).str();
+                dataSteps = args[0].getProperty(SYM_STEPS).str();
             }
             if (dataSrc.empty()) throw std::runtime_error(objType + ".fit() requires a DataFrame.");
 
-            std::string createCode = object.getProperty("__create_code__").str;
-            std::string loadCode = bridge.genLoadCSV(dataVar, dataSrc);
+            std::string createCode = object.getProperty(SYM_CREATE_CODE).str();
+            std::string loadCode = bridge.genUseFrame(dataVar, dataSrc, dataSteps);
             std::string fitCode = bridge.genFitModel(pyVar, dataVar);
             std::string fullCode = loadCode + createCode + fitCode;
             std::string output = bridge.executeImmediate(fullCode);
@@ -685,10 +717,11 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
         // Feature 1: Hyperparameter Tuning
         if (method == "tune") {
             if (args.empty()) throw std::runtime_error(objType + ".tune() requires data argument.");
-            std::string dataVar = args[0].getProperty("__pyvar__").str;
-            std::string dataSrc = args[0].getProperty("__source__").str;
-            std::string createCode = object.getProperty("__create_code__").str;
-            std::string loadCode = bridge.genLoadCSV(dataVar, dataSrc);
+            std::string dataVar = args[0].getProperty(SYM_PYVAR).str();
+            std::string dataSrc = args[0].getProperty(SYM_SOURCE).str();
+            std::string dataSteps = args[0].getProperty(SYM_STEPS).str();
+            std::string createCode = object.getProperty(SYM_CREATE_CODE).str();
+            std::string loadCode = bridge.genUseFrame(dataVar, dataSrc, dataSteps);
             std::string tuneCode = bridge.genTuneModel(pyVar, dataVar);
             std::string output = bridge.executeImmediate(loadCode + createCode + tuneCode);
             std::cout << output;
@@ -727,7 +760,7 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
         }
         // Feature 5: Save
         if (method == "save") {
-            std::string filepath = args.empty() ? "model.smodel" : args[0].str;
+            std::string filepath = args.empty() ? "model.smodel" : args[0].str();
             // normalize path separators
             std::replace(filepath.begin(), filepath.end(), '\\', '/');
             std::string code = bridge.genSaveModel(pyVar, filepath);
@@ -743,8 +776,9 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
             if (args.empty() || !args[0].isObject())
                 throw std::runtime_error("NeuralNet.train() requires a DataFrame.");
 
-            std::string dataVar = args[0].getProperty("__pyvar__").str;
-            std::string dataSrc = args[0].getProperty("__source__").str;
+            std::string dataVar = args[0].getProperty(SYM_PYVAR).str();
+            std::string dataSrc = args[0].getProperty(SYM_SOURCE).str();
+            std::string dataSteps = args[0].getProperty(SYM_STEPS).str();
             int epochs = 100;
             double lr = 0.01;
 
@@ -758,8 +792,8 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
             epochs = getNamedArgInt(args, "epochs", epochs);
             lr = getNamedArgDouble(args, "lr", lr);
 
-            std::string createCode = object.getProperty("__create_code__").str;
-            std::string loadCode = bridge.genLoadCSV(dataVar, dataSrc);
+            std::string createCode = object.getProperty(SYM_CREATE_CODE).str();
+            std::string loadCode = bridge.genUseFrame(dataVar, dataSrc, dataSteps);
             std::string trainCode = bridge.genTrainNN(pyVar, dataVar, epochs, lr);
             std::string fullCode = loadCode + createCode + trainCode;
             std::string output = bridge.executeImmediate(fullCode);
@@ -784,18 +818,19 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
         if (method == "find_best") {
             if (args.empty() || !args[0].isObject())
                 throw std::runtime_error("AutoML.find_best() requires a DataFrame.");
-            std::string dataVar = args[0].getProperty("__pyvar__").str;
-            std::string dataSrc = args[0].getProperty("__source__").str;
+            std::string dataVar = args[0].getProperty(SYM_PYVAR).str();
+            std::string dataSrc = args[0].getProperty(SYM_SOURCE).str();
+            std::string dataSteps = args[0].getProperty(SYM_STEPS).str();
             std::string winnerVar = bridge.newPyVar();
-            std::string loadCode = bridge.genLoadCSV(dataVar, dataSrc);
+            std::string loadCode = bridge.genUseFrame(dataVar, dataSrc, dataSteps);
             std::string autoCode = bridge.genAutoML(dataVar, winnerVar);
             std::string output = bridge.executeImmediate(loadCode + autoCode);
             std::cout << output;
             SatanValue obj = SatanValue::makeObject();
-            obj.setProperty("__type__", SatanValue(std::string("RandomForest")));
-            obj.setProperty("__pyvar__", SatanValue(winnerVar));
-            obj.setProperty("__create_code__", SatanValue(std::string("")));
-            obj.setProperty("__fitted__", SatanValue(true));
+            obj.setProperty(SYM_TYPE, SatanValue(std::string("RandomForest")));
+            obj.setProperty(SYM_PYVAR, SatanValue(winnerVar));
+            obj.setProperty(SYM_CREATE_CODE, SatanValue(std::string("")));
+            obj.setProperty(SYM_FITTED, SatanValue(true));
             return obj;
         }
     }
@@ -807,34 +842,46 @@ SatanValue handleMethodCall(const SatanValue& object, const std::string& method,
 
 SatanValue handlePropertyAccess(const SatanValue& object, const std::string& property,
                                 PythonBridge& bridge) {
-    std::string objType = object.getProperty("__type__").str;
+    PythonBridge::FrameStage stage(bridge);
+    std::string objType = object.getProperty(SYM_TYPE).str();
 
     // DataFrame property shortcuts
     if (objType == "DataFrame") {
         if (property == "X" || property == "features") {
             // Return a reference marker that fit() can use
             SatanValue ref = SatanValue::makeObject();
-            ref.setProperty("__type__", SatanValue(std::string("DataRef")));
-            ref.setProperty("__parent__", SatanValue(object.getProperty("__source__").str));
-            ref.setProperty("__column__", SatanValue(std::string("X")));
+            ref.setProperty(SYM_TYPE, SatanValue(std::string("DataRef")));
+            ref.setProperty(SYM_PARENT, SatanValue(object.getProperty(SYM_SOURCE).str()));
+            ref.setProperty(SYM_COLUMN, SatanValue(std::string("X")));
             return ref;
         }
         if (property == "y" || property == "target") {
             SatanValue ref = SatanValue::makeObject();
-            ref.setProperty("__type__", SatanValue(std::string("DataRef")));
-            ref.setProperty("__parent__", SatanValue(object.getProperty("__source__").str));
-            ref.setProperty("__column__", SatanValue(std::string("y")));
+            ref.setProperty(SYM_TYPE, SatanValue(std::string("DataRef")));
+            ref.setProperty(SYM_PARENT, SatanValue(object.getProperty(SYM_SOURCE).str()));
+            ref.setProperty(SYM_COLUMN, SatanValue(std::string("y")));
             return ref;
         }
         if (property == "columns" || property == "shape") {
-            std::string src = object.getProperty("__source__").str;
-            std::string pyVar = object.getProperty("__pyvar__").str;
-            std::string code = bridge.genLoadCSV(pyVar, src);
-            if (property == "columns") code += "print(list(" + pyVar + ".columns))\n";
-            else code += bridge.genShape(pyVar);
-            std::string out = bridge.executeImmediate(code);
-            std::cout << out;
-            return bridge.parseResult(out);
+            std::string src = object.getProperty(SYM_SOURCE).str();
+            std::string pyVar = object.getProperty(SYM_PYVAR).str();
+            std::string steps = object.getProperty(SYM_STEPS).str();
+            if (steps.empty()) {
+                auto frame = bridge.frames().open(src);
+                if (property == "shape") return nativeShape(*frame);
+                std::cout << frame->formatColumnList() << std::endl;
+                SatanValue names = SatanValue::makeArray(std::vector<SatanValue>{});
+                for (const auto& col : frame->getColumns()) names.array()->push(SatanValue(col.name));
+                return names;
+            }
+            std::string code = bridge.genUseFrame(pyVar, src, steps);
+            if (property == "columns") {
+                code += "import json\nprint(list(" + pyVar + ".columns))\n"
+                      + "print('__SATAN_RESULT__:' + json.dumps([str(c) for c in " + pyVar + ".columns]))\n";
+            } else {
+                code += bridge.genShape(pyVar);
+            }
+            return frameListQuery(bridge, code);
         }
     }
 
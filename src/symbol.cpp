@@ -0,0 +1,104 @@
+#include "../include/symbol.h"
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace {
+
+// Identifiers are short, so hash them a word at a time
+uint64_t hashName(std::string_view name) {
+    const uint64_t mul = 0xff51afd7ed558ccdULL;
+    uint64_t h = name.size() * 0x9e3779b97f4a7c15ULL;
+    size_t i = 0;
+    for (; i + 8 <= name.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, name.data() + i, 8);
+        h = (h ^ word) * mul;
+        h ^= h >> 32;
+    }
+    if (i < name.size()) {
+        uint64_t word = 0;
+        std::memcpy(&word, name.data() + i, name.size() - i);
+        h = (h ^ word) * mul;
+        h ^= h >> 32;
+    }
+    return h ^ (h >> 29);
+}
+
+// Open-addressed table of ids, probed linearly; names live in a deque so
+// the strings never move once interned.
+struct SymbolTable {
+    struct Entry {
+        uint64_t hash = 0;
+        Symbol symbol = NO_SYMBOL;
+    };
+
+    std::deque<std::string> names;
+    std::vector<Entry> entries = std::vector<Entry>(1024);
+
+    SymbolTable() {
+#define SATAN_SYMBOL_NAME(id, text) intern(text);
+        SATAN_PREDEFINED_SYMBOLS(SATAN_SYMBOL_NAME)
+#undef SATAN_SYMBOL_NAME
+    }
+
+    // Slot holding `name`, or the empty slot where it belongs
+    Entry& find(std::string_view name, uint64_t hash) {
+        size_t mask = entries.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            Entry& e = entries[i];
+            if (e.symbol == NO_SYMBOL || (e.hash == hash && names[e.symbol] == name)) return e;
+        }
+    }
+
+    Symbol intern(std::string_view name) {
+        uint64_t hash = hashName(name);
+        Entry& e = find(name, hash);
+        if (e.symbol != NO_SYMBOL) return e.symbol;
+        Symbol symbol = static_cast<Symbol>(names.size());
+        names.emplace_back(name);
+        e = {hash, symbol};
+        // Keep the load factor at or below one half
+        if (names.size() * 2 > entries.size()) grow();
+        return symbol;
+    }
+
+    void grow() {
+        std::vector<Entry> old(entries.size() * 2);
+        old.swap(entries);
+        size_t mask = entries.size() - 1;
+        for (const Entry& e : old) {
+            if (e.symbol == NO_SYMBOL) continue;
+            size_t i = e.hash & mask;
+            while (entries[i].symbol != NO_SYMBOL) i = (i + 1) & mask;
+            entries[i] = e;
+        }
+    }
+};
+
+SymbolTable& table() {
+    static SymbolTable symbols;
+    return symbols;
+}
+
+}
+
+Symbol intern(std::string_view name) {
+    return table().intern(name);
+}
+
+bool lookupSymbol(std::string_view name, Symbol& symbol) {
+    SymbolTable& symbols = table();
+    const SymbolTable::Entry& e = symbols.find(name, hashName(name));
+    if (e.symbol == NO_SYMBOL) return false;
+    symbol = e.symbol;
+    return true;
+}
+
+const std::string& symbolName(Symbol symbol) {
+    return table().names[symbol];
+}
+
+bool isInternalName(std::string_view name) {
+    return name.size() >= 2 && name[0] == '_' && name[1] == '_';
+}
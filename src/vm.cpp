@@ -0,0 +1,517 @@
+#include "../include/vm.h"
+#include "../include/compiler.h"
+#include "../include/module_registry.h"
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+VM::VM(Environment& builtins, ModuleRegistry& modules) : builtins(builtins), modules(modules) {
+    stack.reserve(1024);
+    frames.reserve(64);
+    invoker = [this](const SatanValue& fn, std::vector<SatanValue> args) {
+        return callFunction(fn, std::move(args));
+    };
+}
+
+void VM::runScript(const std::shared_ptr<FunctionProto>& script) {
+    FunctionObject func;
+    func.proto = script;
+    SatanValue callee = SatanValue::makeFunction(std::move(func));
+    size_t entry = frames.size();
+    stack.push_back(callee);
+    pushFrame(callee, stack.size());
+    run(entry);
+}
+
+void VM::pushFrame(const SatanValue& callee, size_t base) {
+    if (frames.size() >= MAX_CALL_DEPTH)
+        throw std::runtime_error("Maximum call depth exceeded.");
+    FunctionObject* closure = callee.function();
+    const FunctionProto* proto = closure->proto.get();
+    stack.resize(base + proto->numSlots);
+    frames.push_back({proto, closure, 0, base});
+}
+
+// Calls a closure from native code (map/filter/forEach callbacks). Like the
+// tree-walker, extra arguments are dropped and missing ones are nil.
+SatanValue VM::callFunction(const SatanValue& fn, std::vector<SatanValue> args) {
+    if (!fn.isFunction() || !fn.function() || !fn.function()->proto)
+        throw std::runtime_error("Can only call functions.");
+    args.resize(fn.function()->proto->arity);
+    size_t entry = frames.size();
+    stack.push_back(fn);
+    size_t base = stack.size();
+    for (auto& arg : args) stack.push_back(std::move(arg));
+    pushFrame(stack[base - 1], base);
+    return run(entry);
+}
+
+SatanValue VM::run(size_t entryFrames) {
+    while (true) {
+        try {
+            return execute(entryFrames);
+        } catch (const std::exception& e) {
+            if (handlers.empty() || handlers.back().frameCount <= entryFrames) {
+                unwind(entryFrames);
+                throw;
+            }
+            // Resume at the innermost try/catch of this run with the message on the stack
+            Handler h = handlers.back();
+            handlers.pop_back();
+            closeUpvalues(h.firstSlot);
+            frames.resize(h.frameCount);
+            stack.resize(h.stackSize);
+            stack.push_back(SatanValue(std::string(e.what())));
+            frames.back().ip = h.target;
+        }
+    }
+}
+
+// Drops everything this run pushed so the VM stays usable after an error
+void VM::unwind(size_t entryFrames) {
+    if (frames.size() <= entryFrames) return;
+    size_t stackSize = frames[entryFrames].base - 1;
+    closeUpvalues(stackSize);
+    while (!handlers.empty() && handlers.back().frameCount > entryFrames) handlers.pop_back();
+    frames.resize(entryFrames);
+    stack.resize(stackSize);
+}
+
+inline const SatanValue* VM::fusedOperand(const FusedOperand& operand, const Frame& frame) {
+    switch (operand.kind) {
+        case FusedOperand::VALUE: return &operand.value;
+        case FusedOperand::LOCAL: return &stack[frame.base + operand.index];
+        case FusedOperand::UPVALUE: {
+            Upvalue& upvalue = *frame.closure->upvalues[operand.index];
+            return upvalue.open ? &stack[upvalue.slot] : &upvalue.closed;
+        }
+        case FusedOperand::GLOBAL:
+            return globals.defined[operand.index] ? &globals.values[operand.index] : nullptr;
+    }
+    return nullptr;
+}
+
+// Pushes the chain's value if its operands are all numbers or arrays.
+// Anything else takes the plain code, as does an undefined global so that
+// the usual error is raised where it always was.
+bool VM::runFused(const FusedSite& site, const Frame& frame) {
+    double numbers[MAX_FUSED_OPERANDS];
+    bool arrays = false;
+    for (size_t i = 0; i < site.operands.size(); i++) {
+        const SatanValue* value = fusedOperand(site.operands[i], frame);
+        if (!value) return false;
+        if (value->isNumber()) numbers[i] = value->number;
+        else if (value->isArray()) arrays = true;
+        else return false;
+    }
+    if (!arrays) {
+        stack.push_back(evaluateNumbers(site.plan, numbers));
+        return true;
+    }
+    SatanValue operands[MAX_FUSED_OPERANDS];
+    for (size_t i = 0; i < site.operands.size(); i++) operands[i] = *fusedOperand(site.operands[i], frame);
+    stack.push_back(evaluateFused(site.plan, operands));
+    return true;
+}
+
+void VM::resolveGlobal(uint32_t id) {
+    Symbol name = globals.names[id];
+    if (!builtins.exists(name)) throw std::runtime_error("Undefined variable: " + symbolName(name));
+    globals.values[id] = builtins.get(name);
+    globals.defined[id] = 1;
+}
+
+std::shared_ptr<Upvalue> VM::captureUpvalue(size_t slot) {
+    auto it = openUpvalues.end();
+    while (it != openUpvalues.begin() && (*(it - 1))->slot >= slot) {
+        --it;
+        if ((*it)->slot == slot) return *it;
+    }
+    auto upvalue = std::make_shared<Upvalue>();
+    upvalue->slot = slot;
+    openUpvalues.insert(it, upvalue);
+    return upvalue;
+}
+
+void VM::closeUpvalues(size_t fromSlot) {
+    while (!openUpvalues.empty() && openUpvalues.back()->slot >= fromSlot) {
+        Upvalue& upvalue = *openUpvalues.back();
+        upvalue.closed = stack[upvalue.slot];
+        upvalue.open = false;
+        openUpvalues.pop_back();
+    }
+}
+
+void VM::importFile(const std::string& path) {
+    // A module's definitions are globals, so importing it again binds nothing new
+    if (modules.find(path)) return;
+    ModuleRegistry::Module& module = modules.load(path);
+    Compiler compiler(globals);
+    runScript(compiler.compileScript(module.program.statements));
+}
+
+SatanValue VM::execute(size_t entryFrames) {
+    Frame* frame = &frames.back();
+    const uint32_t* code = frame->proto->code.data();
+    size_t ip = frame->ip;
+    size_t base = frame->base;
+
+// Re-read the current frame after anything that may push frames or re-enter the VM
+#define RELOAD_FRAME() do { \
+        frame = &frames.back(); \
+        code = frame->proto->code.data(); \
+        ip = frame->ip; \
+        base = frame->base; \
+    } while (0)
+#define READ() (code[ip++])
+#define TOP() (stack.back())
+#define SECOND() (stack[stack.size() - 2])
+#define NUMBER_OP(tokenType, expr) { \
+        SatanValue& l = SECOND(); \
+        const SatanValue& r = TOP(); \
+        if (l.type == ValueType::NUMBER && r.type == ValueType::NUMBER) { \
+            l.number = (expr); \
+        } else { \
+            l = binaryOp(tokenType, l, r); \
+        } \
+        stack.pop_back(); \
+        break; \
+    }
+#define COMPARE_OP(tokenType, expr) { \
+        SatanValue& l = SECOND(); \
+        const SatanValue& r = TOP(); \
+        if (l.type == ValueType::NUMBER && r.type == ValueType::NUMBER) { \
+            l = SatanValue(static_cast<bool>(expr)); \
+        } else { \
+            l = binaryOp(tokenType, l, r); \
+        } \
+        stack.pop_back(); \
+        break; \
+    }
+
+    while (true) {
+        switch (static_cast<OpCode>(READ())) {
+            case OpCode::CONSTANT:
+                stack.push_back(frame->proto->constants[READ()]);
+                break;
+            case OpCode::NIL: stack.emplace_back(); break;
+            case OpCode::TRUE: stack.push_back(SatanValue(true)); break;
+            case OpCode::FALSE: stack.push_back(SatanValue(false)); break;
+            case OpCode::POP: stack.pop_back(); break;
+
+            case OpCode::GET_LOCAL:
+                stack.push_back(stack[base + READ()]);
+                break;
+            case OpCode::SET_LOCAL:
+                stack[base + READ()] = TOP();
+                break;
+            case OpCode::DEFINE_LOCAL:
+                stack[base + READ()] = std::move(TOP());
+                stack.pop_back();
+                break;
+            case OpCode::GET_UPVALUE: {
+                Upvalue& upvalue = *frame->closure->upvalues[READ()];
+                stack.push_back(upvalue.open ? stack[upvalue.slot] : upvalue.closed);
+                break;
+            }
+            case OpCode::SET_UPVALUE: {
+                Upvalue& upvalue = *frame->closure->upvalues[READ()];
+                (upvalue.open ? stack[upvalue.slot] : upvalue.closed) = TOP();
+                break;
+            }
+            case OpCode::GET_GLOBAL: {
+                uint32_t id = READ();
+                if (!globals.defined[id]) resolveGlobal(id);
+                stack.push_back(globals.values[id]);
+                break;
+            }
+            case OpCode::SET_GLOBAL: {
+                uint32_t id = READ();
+                if (!globals.defined[id]) resolveGlobal(id);
+                globals.values[id] = TOP();
+                break;
+            }
+            case OpCode::DEFINE_GLOBAL: {
+                uint32_t id = READ();
+                globals.values[id] = std::move(TOP());
+                globals.defined[id] = 1;
+                stack.pop_back();
+                break;
+            }
+            case OpCode::UPDATE_LOCAL: {
+                SatanValue& target = stack[base + READ()];
+                compoundAssign(static_cast<TokenType>(READ()), target, TOP());
+                TOP() = target;
+                break;
+            }
+            case OpCode::UPDATE_UPVALUE: {
+                Upvalue& upvalue = *frame->closure->upvalues[READ()];
+                SatanValue& target = upvalue.open ? stack[upvalue.slot] : upvalue.closed;
+                compoundAssign(static_cast<TokenType>(READ()), target, TOP());
+                TOP() = target;
+                break;
+            }
+            case OpCode::UPDATE_GLOBAL: {
+                uint32_t id = READ();
+                if (!globals.defined[id]) resolveGlobal(id);
+                compoundAssign(static_cast<TokenType>(READ()), globals.values[id], TOP());
+                TOP() = globals.values[id];
+                break;
+            }
+
+            case OpCode::ADD: NUMBER_OP(TokenType::PLUS, l.number + r.number)
+            case OpCode::SUBTRACT: NUMBER_OP(TokenType::MINUS, l.number - r.number)
+            case OpCode::MULTIPLY: NUMBER_OP(TokenType::STAR, l.number * r.number)
+            case OpCode::DIVIDE: {
+                // binaryOp owns the division/modulo by zero errors
+                SatanValue& l = SECOND();
+                l = binaryOp(TokenType::SLASH, l, TOP());
+                stack.pop_back();
+                break;
+            }
+            case OpCode::MODULO: {
+                SatanValue& l = SECOND();
+                l = binaryOp(TokenType::PERCENT, l, TOP());
+                stack.pop_back();
+                break;
+            }
+            case OpCode::GREATER: COMPARE_OP(TokenType::GREATER, l.number > r.number)
+            case OpCode::GREATER_EQUAL: COMPARE_OP(TokenType::GREATER_EQUAL, l.number >= r.number)
+            case OpCode::LESS: COMPARE_OP(TokenType::LESS, l.number < r.number)
+            case OpCode::LESS_EQUAL: COMPARE_OP(TokenType::LESS_EQUAL, l.number <= r.number)
+            case OpCode::EQUAL: COMPARE_OP(TokenType::EQUAL_EQUAL, l.number == r.number)
+            case OpCode::NOT_EQUAL: COMPARE_OP(TokenType::BANG_EQUAL, l.number != r.number)
+            case OpCode::NEGATE: {
+                SatanValue& v = TOP();
+                if (v.type == ValueType::NUMBER) v.number = -v.number;
+                else v = SatanValue(-v.asNumber());
+                break;
+            }
+            case OpCode::FUSED: {
+                const FusedSite& site = frame->proto->fusedSites[READ()];
+                uint32_t skip = READ();
+                if (runFused(site, *frame)) ip = skip;
+                break;
+            }
+            case OpCode::NOT: TOP() = SatanValue(!TOP().isTruthy()); break;
+            case OpCode::TO_BOOL: TOP() = SatanValue(TOP().isTruthy()); break;
+
+            case OpCode::JUMP:
+                ip = code[ip];
+                break;
+            case OpCode::JUMP_IF_FALSE: {
+                uint32_t target = READ();
+                bool truthy = TOP().isTruthy();
+                stack.pop_back();
+                if (!truthy) ip = target;
+                break;
+            }
+            case OpCode::JUMP_IF_TRUE: {
+                uint32_t target = READ();
+                bool truthy = TOP().isTruthy();
+                stack.pop_back();
+                if (truthy) ip = target;
+                break;
+            }
+            case OpCode::LOOP_GUARD: {
+                double& count = stack[base + READ()].number;
+                uint32_t message = READ();
+                if (++count > MAX_LOOP_ITERATIONS)
+                    throw std::runtime_error(frame->proto->names[message]);
+                break;
+            }
+
+            case OpCode::CALL: {
+                uint32_t argc = READ();
+                frame->ip = ip;
+                size_t calleeIndex = stack.size() - argc - 1;
+                const SatanValue& callee = stack[calleeIndex];
+                if (callee.isFunction() && callee.function() && callee.function()->proto) {
+                    uint32_t arity = callee.function()->proto->arity;
+                    if (argc != arity) {
+                        throw std::runtime_error("Expected " + std::to_string(arity) +
+                                                 " arguments but got " + std::to_string(argc) + ".");
+                    }
+                    pushFrame(callee, calleeIndex + 1);
+                    RELOAD_FRAME();
+                    break;
+                }
+                if (callee.isNativeFn() && callee.nativeFn()) {
+                    SatanValue native = callee;   // keeps the function alive past the resize
+                    std::vector<SatanValue> args(std::make_move_iterator(stack.end() - argc),
+                                                 std::make_move_iterator(stack.end()));
+                    stack.resize(calleeIndex);
+                    stack.push_back((*native.nativeFn())(std::move(args)));
+                    break;
+                }
+                throw std::runtime_error("Can only call functions.");
+            }
+            case OpCode::INVOKE: {
+                Symbol method = READ();
+                uint32_t argc = READ();
+                MethodCache& cache = frame->proto->methodCaches[READ()];
+                frame->ip = ip;
+                size_t objectIndex = stack.size() - argc - 1;
+                std::vector<SatanValue> args(std::make_move_iterator(stack.end() - argc),
+                                             std::make_move_iterator(stack.end()));
+                SatanValue object = std::move(stack[objectIndex]);
+                stack.resize(objectIndex);
+                MethodHandler handler = object.type == cache.type ? cache.handler : nullptr;
+                if (!handler && (handler = findMethod(object.type, method, argc))) cache = {object.type, handler};
+                SatanValue result = handler ? handler(object, args, invoker) : callMethod(object, method, args, invoker);
+                stack.push_back(std::move(result));
+                RELOAD_FRAME();
+                break;
+            }
+            case OpCode::GET_MEMBER: {
+                TOP() = getMember(TOP(), READ());
+                break;
+            }
+            case OpCode::GET_INDEX: {
+                SatanValue& object = SECOND();
+                object = getIndex(object, TOP());
+                stack.pop_back();
+                break;
+            }
+            case OpCode::SET_INDEX: {
+                TokenType op = static_cast<TokenType>(READ());
+                size_t objectIndex = stack.size() - 3;
+                SatanValue stored = setIndex(stack[objectIndex], stack[objectIndex + 1], op, TOP());
+                stack.resize(objectIndex);
+                stack.push_back(std::move(stored));
+                break;
+            }
+            case OpCode::SET_MEMBER: {
+                Symbol name = READ();
+                TokenType op = static_cast<TokenType>(READ());
+                SatanValue stored = setMember(SECOND(), name, op, TOP());
+                stack.pop_back();
+                TOP() = std::move(stored);
+                break;
+            }
+            case OpCode::BUILD_ARRAY: {
+                uint32_t count = READ();
+                std::vector<SatanValue> elements(std::make_move_iterator(stack.end() - count),
+                                                 std::make_move_iterator(stack.end()));
+                stack.resize(stack.size() - count);
+                stack.push_back(SatanValue::makeArray(std::move(elements)));
+                break;
+            }
+            case OpCode::BUILD_DICT: {
+                uint32_t count = READ();
+                size_t first = stack.size() - 2 * count;
+                SatanValue dict = SatanValue::makeObject();
+                for (size_t i = first; i < stack.size(); i += 2)
+                    dict.setProperty(stack[i].toString(), std::move(stack[i + 1]));
+                stack.resize(first);
+                stack.push_back(std::move(dict));
+                break;
+            }
+            case OpCode::CLOSURE: {
+                const auto& proto = frame->proto->functions[READ()];
+                FunctionObject func;
+                func.proto = proto;
+                func.upvalues.reserve(proto->upvalues.size());
+                for (const auto& desc : proto->upvalues) {
+                    if (desc.isLocal) func.upvalues.push_back(captureUpvalue(base + desc.index));
+                    else func.upvalues.push_back(frame->closure->upvalues[desc.index]);
+                }
+                stack.push_back(SatanValue::makeFunction(std::move(func)));
+                break;
+            }
+            case OpCode::CLOSE_UPVALUES:
+                closeUpvalues(base + READ());
+                break;
+            case OpCode::RETURN: {
+                SatanValue result = std::move(TOP());
+                closeUpvalues(base);
+                while (!handlers.empty() && handlers.back().frameCount >= frames.size()) handlers.pop_back();
+                stack.resize(base - 1);
+                frames.pop_back();
+                if (frames.size() == entryFrames) return result;
+                stack.push_back(std::move(result));
+                RELOAD_FRAME();
+                break;
+            }
+
+            case OpCode::PRINT:
+                std::cout << TOP().toString() << std::endl;
+                stack.pop_back();
+                break;
+            case OpCode::ITER_PREP: {
+                uint32_t slot = READ();
+                SatanValue iterable = std::move(TOP());
+                stack.pop_back();
+                if (iterable.isObject() && iterable.object()) {
+                    // Iterate over a snapshot of the visible keys
+                    std::vector<SatanValue> keys;
+                    iterable.object()->forEach([&](const std::string& name, const SatanValue&) {
+                        if (!isInternalName(name)) keys.push_back(SatanValue(name));
+                    });
+                    iterable = SatanValue::makeArray(std::move(keys));
+                } else if (!(iterable.isArray() && iterable.array()) && !iterable.isString()) {
+                    throw std::runtime_error("Cannot iterate over " + iterable.toString());
+                }
+                stack[base + slot] = std::move(iterable);
+                stack[base + slot + 1] = SatanValue(0.0);
+                break;
+            }
+            case OpCode::ITER_NEXT: {
+                uint32_t slot = READ();
+                uint32_t var = READ();
+                const SatanValue& iterable = stack[base + slot];
+                double& cursor = stack[base + slot + 1].number;
+                size_t i = static_cast<size_t>(cursor);
+                size_t size = iterable.isString() ? iterable.str().size() : iterable.array()->size();
+                if (i >= size) break;
+                if (i >= static_cast<size_t>(MAX_LOOP_ITERATIONS))
+                    throw std::runtime_error("For..in loop exceeded max iterations");
+                if (iterable.isString()) stack[base + var] = SatanValue(std::string(1, iterable.str()[i]));
+                else stack[base + var] = iterable.array()->get(i);
+                cursor += 1;
+                ip += 2; // skip the exit jump
+                break;
+            }
+            case OpCode::TRY_BEGIN: {
+                uint32_t target = READ();
+                uint32_t slot = READ();
+                handlers.push_back({frames.size(), stack.size(), target, base + slot});
+                break;
+            }
+            case OpCode::TRY_END:
+                handlers.pop_back();
+                break;
+            case OpCode::ASSERT: {
+                const std::string& message = frame->proto->names[READ()];
+                bool truthy = TOP().isTruthy();
+                stack.pop_back();
+                if (!truthy) throw std::runtime_error("Assertion failed: " + message);
+                break;
+            }
+            case OpCode::TEST_BEGIN:
+                std::cout << "\033[36m  TEST: " << frame->proto->names[READ()] << "...\033[0m ";
+                break;
+            case OpCode::TEST_PASS:
+                std::cout << "\033[32mPASSED\033[0m" << std::endl;
+                break;
+            case OpCode::TEST_FAIL:
+                std::cout << "\033[31mFAILED: " << TOP().str() << "\033[0m" << std::endl;
+                stack.pop_back();
+                break;
+            case OpCode::IMPORT:
+                frame->ip = ip + 1;
+                importFile(frame->proto->names[code[ip]]);
+                RELOAD_FRAME();
+                break;
+            case OpCode::FAIL:
+                throw std::runtime_error(frame->proto->names[READ()]);
+        }
+    }
+
+#undef RELOAD_FRAME
+#undef READ
+#undef TOP
+#undef SECOND
+#undef NUMBER_OP
+#undef COMPARE_OP
+}
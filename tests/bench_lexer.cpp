@@ -0,0 +1,61 @@
+#include "../include/lexer.h"
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+
+// Lexer throughput benchmark.
+//   bench_lexer              lex a generated ~64 MB script
+//   bench_lexer <file>       lex the given file instead
+// Tokens are drained in batches as the parser would, so the number reflects
+// the scanner rather than the cost of holding every token at once. Build it
+// optimized (the CMake target forces -O2); an unoptimized build measures
+// little more than function-call overhead.
+
+static std::string generateScript(size_t targetBytes) {
+    std::string src;
+    src.reserve(targetBytes + 4096);
+    for (size_t i = 0; src.size() < targetBytes; i++) {
+        std::string n = std::to_string(i);
+        src += "// helper " + n + ": scales the input and labels anything too large\n";
+        src += "func transform_" + n + "(value, offset) {\n";
+        src += "    let scaled_value = value * " + n + ".25 + offset;\n";
+        src += "    /* values above the threshold are reported\n       instead of being returned */\n";
+        src += "    if (scaled_value > 1000) {\n";
+        src += "        print(\"transform_" + n + " overflow: value was too large\");\n";
+        src += "        return nil;\n";
+        src += "    }\n";
+        src += "    return scaled_value;\n";
+        src += "}\n\n";
+    }
+    return src;
+}
+
+int main(int argc, char* argv[]) {
+    std::string_view source = argc > 1 ? loadSource(argv[1]) : retainSource(generateScript(64 * 1024 * 1024));
+
+    // Best of several passes over the same text, so a noisy machine reports
+    // what the scanner can do rather than what the scheduler allowed
+    const int passes = 5;
+    double best = 0;
+    size_t tokenCount = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        Lexer lexer = Lexer::fromRetained(source);
+        std::deque<Token> window;
+        tokenCount = 0;
+        auto begin = std::chrono::steady_clock::now();
+        while (!lexer.done()) {
+            lexer.scanInto(window, 4096);
+            tokenCount += window.size();
+            window.clear();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (pass == 0 || seconds < best) best = seconds;
+    }
+
+    std::cout << "bytes:      " << source.size() << "\n";
+    std::cout << "tokens:     " << tokenCount << "\n";
+    std::cout << "time:       " << best << " s (best of " << passes << ")\n";
+    std::cout << "throughput: " << (source.size() / best) / (1024 * 1024) << " MB/s\n";
+    return 0;
+}
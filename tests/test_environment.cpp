@@ -8,19 +8,19 @@
 #include "../include/parser.h"
 
 // --------------- Stmt stubs ---------------
-void BlockStmt::execute(Environment&) const {}
-void VarDecl::execute(Environment&) const {}
-void AssembleStmt::execute(Environment&) const {}
-void PrintStmt::execute(Environment&) const {}
-void IfStmt::execute(Environment&) const {}
-void ExprStmt::execute(Environment&) const {}
-void SummonStmt::execute(Environment&) const {}
-void FunDecl::execute(Environment&) const {}
-void ReturnStmt::execute(Environment&) const {}
-void WhileStmt::execute(Environment&) const {}
-void ForStmt::execute(Environment&) const {}
-void BreakStmt::execute(Environment&) const {}
-void ContinueStmt::execute(Environment&) const {}
+ExecStatus BlockStmt::execute(Environment&) const { return {}; }
+ExecStatus VarDecl::execute(Environment&) const { return {}; }
+ExecStatus AssembleStmt::execute(Environment&) const { return {}; }
+ExecStatus PrintStmt::execute(Environment&) const { return {}; }
+ExecStatus IfStmt::execute(Environment&) const { return {}; }
+ExecStatus ExprStmt::execute(Environment&) const { return {}; }
+ExecStatus SummonStmt::execute(Environment&) const { return {}; }
+ExecStatus FunDecl::execute(Environment&) const { return {}; }
+ExecStatus ReturnStmt::execute(Environment&) const { return {}; }
+ExecStatus WhileStmt::execute(Environment&) const { return {}; }
+ExecStatus ForStmt::execute(Environment&) const { return {}; }
+ExecStatus BreakStmt::execute(Environment&) const { return {}; }
+ExecStatus ContinueStmt::execute(Environment&) const { return {}; }
 
 // --------------- Expr stubs ---------------
 void LiteralExpr::print() const {}
@@ -93,7 +93,7 @@ TEST_CASE("Environment defines and retrieves a function", "[environment][functio
 
     FunctionObject func;
     func.params = {"a", "b"};
-    func.body = std::make_shared<BlockStmt>(std::vector<std::unique_ptr<Stmt>>{});
+    func.body = std::make_shared<BlockStmt>(std::vector<Stmt*>{});
 
     env.defineFunction("add", func);
 
@@ -110,7 +110,7 @@ TEST_CASE("Environment defines a zero-parameter function", "[environment][functi
 
     FunctionObject func;
     func.params = {};
-    func.body = std::make_shared<BlockStmt>(std::vector<std::unique_ptr<Stmt>>{});
+    func.body = std::make_shared<BlockStmt>(std::vector<Stmt*>{});
 
     env.defineFunction("noop", func);
 
@@ -130,7 +130,7 @@ TEST_CASE("Environment getNumber throws when name is a function", "[environment]
 
     FunctionObject func;
     func.params = {"x"};
-    func.body = std::make_shared<BlockStmt>(std::vector<std::unique_ptr<Stmt>>{});
+    func.body = std::make_shared<BlockStmt>(std::vector<Stmt*>{});
 
     env.defineFunction("myFunc", func);
 
@@ -215,7 +215,7 @@ TEST_CASE("Nested scope function lookup walks ancestor chain", "[environment][ne
 
     FunctionObject func;
     func.params = {"n"};
-    func.body = std::make_shared<BlockStmt>(std::vector<std::unique_ptr<Stmt>>{});
+    func.body = std::make_shared<BlockStmt>(std::vector<Stmt*>{});
 
     grandparent.defineFunction("factorial", func);
 
@@ -234,14 +234,14 @@ TEST_CASE("Nested scope shadows function from ancestor", "[environment][nested]"
 
     FunctionObject origFunc;
     origFunc.params = {"a"};
-    origFunc.body = std::make_shared<BlockStmt>(std::vector<std::unique_ptr<Stmt>>{});
+    origFunc.body = std::make_shared<BlockStmt>(std::vector<Stmt*>{});
     grandparent.defineFunction("compute", origFunc);
 
     Environment child(&grandparent);
 
     FunctionObject newFunc;
     newFunc.params = {"a", "b", "c"};
-    newFunc.body = std::make_shared<BlockStmt>(std::vector<std::unique_ptr<Stmt>>{});
+    newFunc.body = std::make_shared<BlockStmt>(std::vector<Stmt*>{});
     child.defineFunction("compute", newFunc);
 
     REQUIRE(child.getFunction("compute").params.size() == 3);
@@ -264,7 +264,7 @@ TEST_CASE("Mixed variables and functions in nested scopes", "[environment][neste
 
     FunctionObject areaFunc;
     areaFunc.params = {"r"};
-    areaFunc.body = std::make_shared<BlockStmt>(std::vector<std::unique_ptr<Stmt>>{});
+    areaFunc.body = std::make_shared<BlockStmt>(std::vector<Stmt*>{});
     global.defineFunction("circleArea", areaFunc);
 
     Environment local(&global);
@@ -24,10 +24,10 @@ int main() {
 }
 
     Parser parser(tokens);
-    auto statements = parser.parse();
+    Program program = parser.parse();
 
     Environment env;
-    for (const auto& stmt : statements) {
+    for (Stmt* stmt : program.statements) {
         stmt->execute(env);
     }
 